@@ -0,0 +1,96 @@
+#pragma once
+
+#include "Ast.h"
+#include "Value.h"
+
+// Typing rules shared by the optimiser and the runtime. They are constexpr so
+// the kernel tables can be specialised per type pair at compile time.
+constexpr VALUE_TYPE arithmeticType(VALUE_TYPE type) {
+    return type == VALUE_BOOL || type == VALUE_CHAR ? VALUE_I32 : type;
+}
+
+constexpr bool isNumeric(VALUE_TYPE type) { return type != VALUE_STRINGA; }
+
+constexpr VALUE_TYPE commonType(VALUE_TYPE lhs, VALUE_TYPE rhs) {
+    lhs = arithmeticType(lhs);
+    rhs = arithmeticType(rhs);
+    if (isFloating(lhs) || isFloating(rhs)) {
+        return lhs == VALUE_F64 || rhs == VALUE_F64 ? VALUE_F64 : VALUE_F32;
+    }
+    return integerBits(lhs) >= integerBits(rhs) ? lhs : rhs;
+}
+
+// `operand` receives the type both sides are converted to before the
+// operation is applied.
+constexpr bool binaryResultType(OPERATOR op, VALUE_TYPE lhs, VALUE_TYPE rhs,
+                                VALUE_TYPE &result, VALUE_TYPE &operand) {
+    bool strings = lhs == VALUE_STRINGA && rhs == VALUE_STRINGA;
+    switch (op) {
+        case OP_OR:
+        case OP_AND:
+            if (!isNumeric(lhs) || !isNumeric(rhs)) return false;
+            result = operand = VALUE_BOOL;
+            return true;
+        case OP_BIT_OR:
+        case OP_BIT_XOR:
+        case OP_BIT_AND:
+            if (lhs == VALUE_BOOL && rhs == VALUE_BOOL) {
+                result = operand = VALUE_BOOL;
+                return true;
+            }
+            operand = commonType(lhs, rhs);
+            if (!isNumeric(lhs) || !isNumeric(rhs) || isFloating(operand)) return false;
+            result = operand;
+            return true;
+        case OP_EQ:
+        case OP_NE:
+        case OP_LT:
+        case OP_GT:
+        case OP_LE:
+        case OP_GE:
+            result = VALUE_BOOL;
+            if (strings || (lhs == rhs && (lhs == VALUE_CHAR || lhs == VALUE_BOOL))) {
+                operand = lhs;
+                return true;
+            }
+            if (!isNumeric(lhs) || !isNumeric(rhs)) return false;
+            operand = commonType(lhs, rhs);
+            return true;
+        case OP_SHL:
+        case OP_SHR:
+            operand = arithmeticType(lhs);
+            if (!isNumeric(lhs) || isFloating(operand) || !isSignedInteger(arithmeticType(rhs))) {
+                return false;
+            }
+            result = operand;
+            return true;
+        case OP_ADD:
+            if (strings) {
+                result = operand = VALUE_STRINGA;
+                return true;
+            }
+            [[fallthrough]];
+        case OP_SUB:
+        case OP_MUL:
+        case OP_DIV:
+        case OP_MOD:
+            if (!isNumeric(lhs) || !isNumeric(rhs)) return false;
+            result = operand = commonType(lhs, rhs);
+            return true;
+        default: return false;
+    }
+}
+
+constexpr bool unaryResultType(OPERATOR op, VALUE_TYPE operand, VALUE_TYPE &result) {
+    if (!isNumeric(operand)) return false;
+    switch (op) {
+        case OP_PLUS:
+        case OP_NEG: result = arithmeticType(operand); return true;
+        case OP_NOT: result = VALUE_BOOL; return true;
+        default: return false;
+    }
+}
+
+// Return false when the operation is ill-typed or undefined (division by zero).
+bool evalBinary(OPERATOR op, const Value &lhs, const Value &rhs, Value &out);
+bool evalUnary(OPERATOR op, const Value &operand, Value &out);
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "Module.h"
+
+// Element-wise kernels over inline arrays, specialised per element type
+// (i8/i16/i32/i64/f32/f64) and operator. `broadcast` is 0 for array-array
+// operations, 1 when the lhs is a single scalar and 2 when the rhs is.
+// Returns nullptr for unsupported combinations.
+ArrayKernel findArrayKernel(OPERATOR op, VALUE_TYPE element, uint8_t broadcast);
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "Module.h"
+#include "Profiler.h"
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Traversal counts of arrow transfers: counts[arrow][transfer].
+using EdgeCounts = std::vector<std::vector<uint64_t>>;
+
+void collectEdgeCounts(const Module &module, const Profiler &profiler, EdgeCounts &counts);
+
+// One "<block> <transfer> <from> <to> <count>" line per traversed transfer.
+// Reading skips lines that no longer match the module, so a profile taken
+// before an edit only loses the edges that changed.
+void writeEdgeCounts(const Module &module, const EdgeCounts &counts, std::ostream &out);
+bool readEdgeCounts(const Module &module, std::istream &in, EdgeCounts &counts,
+                    std::string &error);
+
+// Fuses every chain of repr nodes joined by single-successor transfers taken
+// at least `minTraversals` times: the chain's first node runs the others
+// straight after itself, passing results on as arguments, and continues from
+// the last one. Nodes inside a chain keep their transfers for other callers.
+// Returns the number of chains.
+size_t fuseArrowChains(Module &module, const EdgeCounts &counts, uint64_t minTraversals = 1);
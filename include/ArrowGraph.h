@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Ast.h"
+#include "Value.h"
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Compressed-sparse-row form of one `#name` block. Node 0 is `start`, node 1
+// is `end`, the rest are repr names in order of first appearance. The
+// successors of node n are targets[offsets[n], offsets[n + 1]) in declaration
+// order; the payload of edge e is payloads[payloadOffsets[e], payloadOffsets[e + 1]).
+struct ArrowGraph {
+    static const uint32_t START = 0;
+    static const uint32_t END = 1;
+
+    std::string name;
+    std::vector<std::string> names;
+    std::vector<uint32_t> symbols;  // interned name per node
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> targets;
+    std::vector<uint32_t> declaration;  // CSR edge -> index in ArrowBlock::edges
+    std::vector<uint32_t> payloadOffsets;
+    std::vector<Value> payloads;
+
+    uint32_t nodeCount() const { return static_cast<uint32_t>(names.size()); }
+    uint32_t edgeCount() const { return static_cast<uint32_t>(targets.size()); }
+    uint32_t outDegree(uint32_t node) const { return offsets[node + 1] - offsets[node]; }
+};
+
+struct ArrowAnalysis {
+    std::vector<uint8_t> reachable;   // from `start`
+    std::vector<uint8_t> reachesEnd;  // some path leads to `end`
+    std::vector<uint32_t> unreachable;
+    std::vector<uint32_t> deadEnds;  // reachable, but cannot reach `end`
+    std::vector<uint32_t> component;  // strongly connected component per node
+    uint32_t componentCount = 0;
+    std::vector<uint8_t> cyclic;  // node lies on a cycle
+    std::vector<uint32_t> order;  // topological order of the nodes on no cycle
+};
+
+// Both run in O(nodes + edges) and never recurse.
+void buildArrowGraph(const ArrowBlock &block, ArrowGraph &graph);
+void analyseArrowGraph(const ArrowGraph &graph, ArrowAnalysis &analysis);
+
+// The `pfru check` summary of every arrow block in the program.
+void writeArrowReport(const Program &program, std::ostream &out);
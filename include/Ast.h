@@ -0,0 +1,149 @@
+#pragma once
+
+#include "Interner.h"
+#include "Token.h"
+#include "Value.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+struct TypeRef {
+    VALUE_TYPE element = VALUE_I32;
+    uint32_t arraySize = 0;  // 0 for scalars, N for `T[N]`
+};
+
+enum EXPR_KIND {
+    EXPR_LITERAL,
+    EXPR_NAME,
+    EXPR_UNARY,
+    EXPR_BINARY,
+    EXPR_CALL,
+    EXPR_ARRAY,
+    EXPR_TUPLE
+};
+
+enum OPERATOR {
+    OP_PLUS,
+    OP_NEG,
+    OP_NOT,
+
+    OP_OR,
+    OP_AND,
+    OP_BIT_OR,
+    OP_BIT_XOR,
+    OP_BIT_AND,
+    OP_EQ,
+    OP_NE,
+    OP_LT,
+    OP_GT,
+    OP_LE,
+    OP_GE,
+    OP_SHL,
+    OP_SHR,
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_MOD
+};
+
+struct Expr;
+using ExprPtr = std::unique_ptr<Expr>;
+
+struct Expr {
+    EXPR_KIND kind = EXPR_LITERAL;
+    uint32_t row = 0, column = 0;
+    OPERATOR op = OP_ADD;              // EXPR_UNARY, EXPR_BINARY
+    Value value;                       // EXPR_LITERAL
+    std::string name;                  // EXPR_NAME, EXPR_CALL
+    uint32_t symbol = Interner::NONE;  // interned `name`
+    std::vector<ExprPtr> operands;     // sub-expressions / call arguments
+};
+
+enum STMT_KIND {
+    STMT_VAR_DECL,
+    STMT_ASSIGN,
+    STMT_EXPR,
+    STMT_IF,
+    STMT_WHILE,
+    STMT_DO_WHILE,
+    STMT_FOR,
+    STMT_RETURN,
+    STMT_BLOCK
+};
+
+struct Stmt;
+using StmtPtr = std::unique_ptr<Stmt>;
+using Block = std::vector<StmtPtr>;
+
+// Layout of `exprs`/`blocks` per kind:
+//   VAR_DECL   exprs = {init?}                blocks = {}
+//   ASSIGN     exprs = {value}                blocks = {}
+//   EXPR       exprs = {expr}                 blocks = {}
+//   IF         exprs = {cond, elif-cond...}   blocks = {body, elif-body...}
+//   WHILE      exprs = {cond}                 blocks = {body}
+//   DO_WHILE   exprs = {cond}                 blocks = {body}
+//   FOR        exprs = {start, step?, end}    blocks = {body}
+//   RETURN     exprs = {value}                blocks = {}
+//   BLOCK      exprs = {}                     blocks = {body}
+// Optional slots hold nullptr.
+struct Stmt {
+    STMT_KIND kind = STMT_EXPR;
+    uint32_t row = 0, column = 0;
+    std::string name;  // declared/assigned variable, loop variable
+    uint32_t symbol = Interner::NONE;
+    bool hasType = false;
+    TypeRef type;
+    std::vector<ExprPtr> exprs;
+    std::vector<Block> blocks;
+};
+
+struct Param {
+    std::string name;
+    uint32_t symbol = Interner::NONE;
+    TypeRef type;
+};
+
+struct ReprFunc {
+    std::string name;
+    uint32_t symbol = Interner::NONE;
+    uint32_t row = 0, column = 0;
+    std::vector<Param> params;
+    std::vector<TypeRef> returnTypes;
+    Block body;
+};
+
+struct ArrowEdge {
+    std::string from, to;  // "start", "end" or a repr name
+    uint32_t fromSymbol = Interner::NONE, toSymbol = Interner::NONE;
+    uint32_t row = 0, column = 0;
+    bool hasPayload = false;
+    std::vector<Value> payload;  // `-(literal_list)>`
+};
+
+struct ArrowBlock {
+    std::string name;
+    uint32_t row = 0, column = 0;
+    std::vector<ArrowEdge> edges;
+};
+
+struct Program {
+    std::vector<ReprFunc> functions;
+    std::vector<ArrowBlock> arrows;
+    Interner symbols;  // ids used by every `symbol` field above
+};
+
+// Rebuilds the syntax tree from the post-order token stream produced by
+// Lexer::parseProgram(). Scratch memory comes from the tokens' resource, while
+// `program` keeps its own. Returns false and fills `error` on malformed input.
+bool buildProgram(const std::pmr::vector<Token> &tokens, const Interner &symbols,
+                  Program &program, std::string &error);
+
+bool isBinaryOperator(OPERATOR op);
+const char *operatorSymbol(OPERATOR op);
+std::string typeRefName(const TypeRef &type);
+
+size_t countNodes(const Expr &expr);
+size_t countNodes(const Block &block);
+size_t countNodes(const ReprFunc &func);
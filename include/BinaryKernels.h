@@ -0,0 +1,12 @@
+#pragma once
+
+#include "Module.h"
+
+// Scalar kernels, one per (operator, lhs type, rhs type), instantiated at
+// compile time. Each kernel takes both operands in their own slot encoding,
+// promotes them to the common operand type and wraps the result to its type,
+// so i8/i16 arithmetic wraps at 8/16 bits. A kernel returns false for integer
+// division by zero. stringa operands only have comparison kernels; their
+// concatenation allocates and is a NODE_CONCAT. Returns nullptr for ill-typed
+// combinations.
+BinaryKernel findBinaryKernel(OPERATOR op, VALUE_TYPE lhs, VALUE_TYPE rhs);
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <string>
+
+// pfru build <dir>: parses every .pfru file below `root` on a thread pool,
+// indexes repr definitions and references across files, then folds and
+// compiles each file as soon as the files it refers to are done. Calls and
+// arrow nodes may name reprs from other files; those are linked into the
+// referring file's module. Prints per-file timings and overall throughput
+// and returns false if any file failed.
+bool buildDirectory(const std::string &root, unsigned threads = 0);
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "ArrowGraph.h"
+#include "Ast.h"
+#include "Module.h"
+#include "SymbolTable.h"
+
+#include <deque>
+#include <string>
+#include <vector>
+
+// Lowers the syntax tree of every repr into frame-slot addressed nodes.
+// Functions without `-> types` take their result types from their first
+// return statement.
+class Compiler {
+ public:
+    explicit Compiler(const Program &program);
+    bool compile(Module &module);
+    const std::string &error() const;
+
+ private:
+    enum STATE { STATE_PENDING, STATE_ACTIVE, STATE_DONE };
+
+    struct Local {
+        uint32_t slot;
+        TypeRef type;
+    };
+
+    struct Context {
+        Function *fn = nullptr;
+        int32_t index = -1;
+        SymbolTable<Local> *scopes = nullptr;
+        uint32_t nextSlot = 0;
+    };
+
+    bool compileFunction(int32_t index);
+    bool compileArrow(const ArrowBlock &src, Arrow &arrow);
+    bool transferArgs(const ArrowGraph &graph, uint32_t edge, const Arrow &arrow,
+                      Transfer &transfer, std::vector<ArrowArg> &args);
+    bool fail(uint32_t row, uint32_t column, const std::string &message);
+
+    int32_t add(const Node &node);
+    int32_t addList(const std::vector<int32_t> &items, Node &node);
+    Node &node(int32_t index);
+    TypeRef typeOf(int32_t index);
+    uint32_t allocate(const TypeRef &type);
+    const Local *lookup(uint32_t symbol) const;
+    void setResults(const std::vector<TypeRef> &types);
+
+    int32_t block(const Block &body, uint32_t loopVariable = Interner::NONE,
+                  VALUE_TYPE loopType = VALUE_I32, uint32_t *loopSlot = nullptr);
+    int32_t statement(const Stmt &stmt);
+    int32_t store(const Local &local, int32_t value, uint32_t row, uint32_t column);
+    int32_t returnStmt(const Stmt &stmt);
+
+    int32_t expr(const Expr &expr, const TypeRef *expected = nullptr);
+    int32_t value(const Expr &expr, const TypeRef *expected = nullptr);
+    int32_t condition(const Expr &expr);
+    int32_t convert(int32_t index, const TypeRef &target, const Expr &where);
+    int32_t convert(int32_t index, const TypeRef &target, uint32_t row, uint32_t column);
+    int32_t unary(const Expr &expr);
+    int32_t binary(const Expr &expr);
+    int32_t arrayBinary(const Expr &expr, OPERATOR op, int32_t lhs, int32_t rhs);
+    int32_t call(const Expr &expr);
+    int32_t arrayLiteral(const Expr &expr, const TypeRef *expected);
+
+    const Program &program_;
+    Module *module_ = nullptr;
+    std::vector<STATE> states_;
+    std::vector<bool> resultsKnown_;
+    std::vector<int32_t> reprs_;  // interned name -> function index
+    // One table per nesting level of compileFunction, reused across functions.
+    std::deque<SymbolTable<Local>> scopeTables_;
+    uint32_t depth_ = 0;
+    Context *ctx_ = nullptr;
+    std::string error_;
+};
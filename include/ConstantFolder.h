@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Ast.h"
+#include "SymbolTable.h"
+
+#include <vector>
+
+struct FoldStats {
+    size_t nodesBefore = 0;
+    size_t nodesAfter = 0;
+    size_t foldedExpressions = 0;
+    size_t propagatedConstants = 0;
+    size_t removedBranches = 0;
+    size_t removedLoops = 0;
+    size_t removedStatements = 0;
+
+    size_t eliminated() const { return nodesBefore - nodesAfter; }
+};
+
+// Folds constant expressions on every operator level, drops unreachable
+// if/elif arms, dead loops and code after `return`, and propagates locals that
+// are declared once with a constant initialiser and never reassigned.
+class ConstantFolder {
+ public:
+    explicit ConstantFolder(Program &program);
+    FoldStats run();
+
+ private:
+    struct Binding {
+        bool constant = false;
+        Value value;
+    };
+
+    struct Uses {
+        int declarations = 0;
+        int writes = 0;
+        int reads = 0;
+    };
+
+    void foldFunction(ReprFunc &func);
+    void countWrites(const Block &block);
+    void countReads(const Expr &expr);
+    void countReads(const Block &block);
+    void foldBlock(Block &block);
+    void foldStmt(StmtPtr &stmt, Block &out);
+    void foldExpr(ExprPtr &expr);
+    void foldScopedBlock(Block &block, uint32_t shadowed = Interner::NONE);
+    void dropDeadDeclarations(Block &block);
+    Uses &uses(uint32_t symbol);
+    void declare(uint32_t symbol, const Expr *init, const Stmt &decl);
+    void replaceWithLiteral(ExprPtr &expr, const Value &value);
+
+    Program &program_;
+    FoldStats stats_;
+    bool changed_ = false;
+    std::vector<Uses> uses_;        // per interned name, for the current repr
+    std::vector<uint32_t> touched_;  // names with non-zero uses_, for resetting
+    SymbolTable<Binding> scopes_;
+};
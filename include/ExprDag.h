@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Ast.h"
+
+#include <cstdint>
+#include <vector>
+
+// Hash-consed form of a program's expressions: structurally identical
+// subtrees are stored once and referred to by id. Ids are handed out bottom-up,
+// so a node's operands always have smaller ids than the node. Source positions
+// are not part of the structure and are not kept.
+class ExprDag {
+ public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    struct Node {
+        EXPR_KIND kind;
+        OPERATOR op;            // EXPR_UNARY, EXPR_BINARY
+        uint32_t symbol;        // EXPR_NAME, EXPR_CALL: the program's interned name
+        uint32_t literal;       // EXPR_LITERAL: index into literals()
+        uint32_t first, count;  // operands: operands()[first, first + count)
+        uint32_t uses;          // references from other nodes and from roots
+    };
+
+    ExprDag();
+    // Id of the structure of `expr`, adding whatever is not stored yet.
+    uint32_t add(const Expr &expr);
+    // Adds every statement expression of `program`; roots() lists their ids in
+    // program order, NONE for an absent optional expression.
+    void add(const Program &program);
+
+    const std::vector<Node> &nodes() const { return nodes_; }
+    const std::vector<uint32_t> &operands() const { return operands_; }
+    const std::vector<Value> &literals() const { return literals_; }
+    const std::vector<uint32_t> &roots() const { return roots_; }
+    size_t bytes() const;
+
+ private:
+    uint32_t literal(const Value &value);
+    void addBlock(const Block &block);
+    static void grow(std::vector<uint32_t> &table, const std::vector<uint64_t> &hashes);
+
+    std::vector<Node> nodes_;
+    std::vector<uint64_t> hashes_;
+    std::vector<uint32_t> table_;  // open addressing over nodes_, NONE marks a free slot
+    std::vector<uint32_t> operands_;
+    std::vector<Value> literals_;
+    std::vector<uint64_t> literalHashes_;
+    std::vector<uint32_t> literalTable_;
+    std::vector<uint32_t> roots_;
+};
+
+// Node count and bytes held by the expression trees of `program`, for
+// comparison with the DAG.
+void measureExpressionTrees(const Program &program, size_t &nodes, size_t &bytes);
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Gives every distinct identifier a dense 32-bit id in order of first
+// appearance. `start` and `end` are interned up front as ids 0 and 1.
+// Names and tables come from `resource`; copies use the default resource, so
+// a copy outlives the resource of the original.
+class Interner {
+ public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+    static constexpr uint32_t START = 0;
+    static constexpr uint32_t END = 1;
+
+    explicit Interner(std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+    void clear();  // back to just `start` and `end`, keeping the storage
+    uint32_t intern(std::string_view text);
+    uint32_t find(std::string_view text) const;
+    std::string_view name(uint32_t id) const;
+    uint32_t size() const;
+
+ private:
+    uint32_t probe(std::string_view text, uint64_t hash) const;
+    void grow();
+
+    std::pmr::vector<std::pmr::string> names_;
+    std::pmr::vector<uint64_t> hashes_;
+    std::pmr::vector<uint32_t> table_;  // open addressing, NONE marks a free slot
+};
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "MemoCache.h"
+#include "Module.h"
+#include "Profiler.h"
+#include "Tracer.h"
+#include "Value.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Column-oriented scalar tuples: columns[c][r] is value c of row r, typed
+// types[c].
+struct Batch {
+    size_t rows = 0;
+    std::vector<VALUE_TYPE> types;
+    std::vector<std::vector<Slot>> columns;
+};
+
+// Executes a compiled Module. Frames, including inline arrays, live on one
+// preallocated slot stack, so calls do not allocate. Functions marked
+// `memoise` get a result cache of up to `memoEntries` entries; 0 disables caching.
+// Loops listed in Function::parallelLoops run their iterations in chunks on
+// worker interpreters, each with its own stack. stringa values built while
+// running, including those in Batch outputs, stay valid until the next call,
+// run or runBatch. Arrow transfers and the tail calls of the outermost repr
+// of call or run reclaim the strings no value carries any more, so a cycle
+// or tail-call loop that builds strings also runs in constant memory.
+class Interpreter {
+ public:
+    explicit Interpreter(const Module &module, size_t stackSlots = 1 << 20,
+                         uint32_t memoEntries = 4096);
+
+    bool call(const std::string &name, const std::vector<Value> &args,
+              std::vector<Value> &results);
+    bool call(int32_t function, const std::vector<Value> &args,
+              std::vector<Value> &results);
+    // Runs an arrow block from `start` until a transfer reaches `end`. Every
+    // transfer reuses one frame, so cyclic graphs run in constant memory.
+    bool run(const std::string &arrow, const std::vector<Value> &inputs,
+             std::vector<Value> &outputs);
+    bool run(int32_t arrow, const std::vector<Value> &inputs, std::vector<Value> &outputs);
+    // Runs an arrow block over every row of `inputs`. Rows travel through the
+    // graph together: each repr runs once per group of pending rows, and
+    // straight-line reprs are evaluated a column at a time.
+    bool runBatch(const std::string &arrow, const Batch &inputs, Batch &outputs);
+    bool runBatch(int32_t arrow, const Batch &inputs, Batch &outputs);
+    const std::string &error() const;
+    const MemoCache &memo(int32_t function) const;
+    // Empties the memo caches, the loop workers' included. A cached result
+    // skips the calls that computed it, so whether a deep recursion reaches
+    // the call depth limit depends on what the caches hold.
+    void clearMemo();
+    // Records calls and arrow transfers into `profiler` until reset to null.
+    void setProfiler(Profiler *profiler);
+    // Parallel loops use at most `threads` threads, the caller's included;
+    // 1 runs every loop sequentially. Defaults to the hardware threads.
+    void setLoopThreads(unsigned threads);
+    // Records entries, exits and transfers into the ring of the calling
+    // thread, so one tracer can serve interpreters on several threads.
+    void setTracer(Tracer *tracer);
+
+ private:
+    enum FLOW { FLOW_NORMAL, FLOW_RETURN, FLOW_TAIL, FLOW_ERROR };
+
+    // Rows waiting at one arrow node; args are indexed by parameter slot.
+    struct Pending {
+        std::vector<uint32_t> rows;
+        std::vector<std::vector<Slot>> args;
+    };
+
+    bool invoke(const Function &fn, Slot *frame);
+    void stageArguments(const Function &fn, const Node &node, Slot *frame, Slot *calleeFrame);
+    bool callNode(const Function &fn, const Node &node, Slot *frame);
+    FLOW exec(const Function &fn, int32_t index, Slot *frame);
+    Slot eval(const Function &fn, int32_t index, Slot *frame);
+    const void *evalArray(const Function &fn, int32_t index, Slot *frame);
+    Slot unary(const Node &node, Slot operand);
+    const Transfer *select(const Arrow &arrow, const ArrowNode &node, int64_t selector);
+    bool enterNode(const Arrow &arrow, const Transfer &transfer, size_t base, Slot *frame);
+    void trace(int32_t index, const Arrow &arrow, const Transfer &transfer);
+    void collect(const Arrow &arrow, const Transfer &transfer, std::vector<Value> &outputs);
+    bool deliver(const Arrow &arrow, const Transfer &transfer, uint32_t row,
+                 std::vector<Pending> &pending, Batch &outputs);
+    bool runStage(const Function &fn, const Pending &work, size_t begin, size_t count,
+                  std::vector<std::vector<Slot>> &results);
+    bool runFused(const Arrow &arrow, const ArrowNode &head, size_t count, Pending &stage,
+                  std::vector<std::vector<Slot>> &results);
+    bool columnar(const Function &fn);
+    bool columnarExpr(const Function &fn, int32_t index, bool guarded) const;
+    bool runColumns(const Function &fn, const Pending &work, size_t begin, size_t count,
+                    std::vector<std::vector<Slot>> &results);
+    bool evalColumn(const Function &fn, int32_t index, size_t count,
+                    const std::vector<Slot> &frame, std::vector<Slot> &out);
+    void resetStrings();
+    void reclaimStrings(const Function &fn);
+    void reclaimStrings(const Arrow &arrow, std::vector<Pending> &pending, Batch &outputs);
+    void reclaimArguments(const Function &fn, Slot *frame);
+    void nextGeneration();
+    bool fail(const Node &node, const std::string &message);
+    bool runParallel(const Function &fn, const Node &loop, const ParallelLoop &plan, Slot *frame,
+                     int64_t start, int64_t step, uint64_t trips);
+    bool runChunk(const Function &fn, const Node &loop, const ParallelLoop &plan,
+                  const Slot *source, size_t depth, int64_t start, int64_t step, uint64_t begin,
+                  uint64_t end, Slot *partials);
+
+    const Module &module_;
+    std::vector<Slot> stack_;
+    size_t top_ = 0;
+    size_t depth_ = 0;
+    std::vector<Slot> results_;
+    bool failed_ = false;
+    std::string error_;
+    const Function *current_ = nullptr;
+    int32_t tailCallee_ = -1;
+    std::vector<int8_t> columnar_;  // per function: -1 unknown, 0 no, 1 yes
+    bool outputsTyped_ = false;
+    std::vector<Slot> forwarded_;
+    std::vector<VALUE_TYPE> forwardedTypes_;
+    std::vector<Slot> columnFrame_;
+    std::vector<MemoCache> memo_;
+    std::vector<Slot> memoKeys_;  // arguments of the memoised calls in progress
+    StringHeap strings_;
+    StringHeap spare_;  // the next generation of strings_, empty between reclaims
+    size_t reclaimAt_ = 0;  // footprint of strings_ that triggers a reclaim
+    size_t reclaimDepth_ = 0;  // call depth whose tail calls may reclaim; 0 for none
+    Profiler *profiler_ = nullptr;
+    Tracer *tracer_ = nullptr;
+    TraceRing *ring_ = nullptr;  // tracer_'s ring for the thread running now
+    uint32_t memoEntries_;
+    unsigned loopThreads_;
+    bool loopWorker_ = false;  // runs chunks of a parallel loop; nested loops stay sequential
+    const Interpreter *owner_ = nullptr;  // a loop worker's owner, whose memo caches it reads
+    std::vector<std::unique_ptr<Interpreter>> loopWorkers_;
+};
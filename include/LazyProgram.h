@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Ast.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Loads a source one top-level declaration at a time. index() only matches
+// braces to find where each repr and arrow block starts and ends, noting the
+// names a body may call; load() then fully parses just the declarations a
+// run can reach. Parsed declarations are kept, so later loads only add to
+// program().
+class LazyProgram {
+ public:
+    explicit LazyProgram(const std::string &source);
+
+    // False if the source is not a plain sequence of declarations, in which
+    // case a full parse is needed to say what is wrong.
+    bool index();
+    // Parses the named reprs and arrow blocks and every repr they may call,
+    // except those already loaded. Unknown names are skipped, so that the
+    // compiler or interpreter can report them.
+    bool load(const std::vector<std::string> &reprs, const std::vector<std::string> &arrows);
+
+    Program &program();
+    const std::string &error() const;  // "row:column: message" after a failed load
+    size_t declarationCount() const;
+    size_t loadedCount() const;
+
+ private:
+    struct Declaration {
+        bool arrow;
+        std::string name;
+        size_t begin, end;  // source bytes
+        uint32_t row, column;
+        std::vector<std::string> references;  // reprs a body may call or an arrow block names
+        bool loaded = false;
+    };
+
+    bool scanBody(size_t &index, Declaration &decl);
+    void skipWhitespace(size_t &index);
+    bool identifier(size_t &index, std::string &out) const;
+    size_t identifierChar(size_t index) const;
+
+    std::string source_;
+    std::vector<Declaration> declarations_;
+    std::unordered_map<std::string, std::vector<uint32_t>> reprs_, arrows_;
+    uint32_t row_ = 1;
+    int64_t lastNewLineIndex_ = -1;
+    Program program_;
+    std::string error_;
+    size_t loaded_ = 0;
+};
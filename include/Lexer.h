@@ -1,14 +1,32 @@
 #pragma once
 
+#include "Interner.h"
+#include "ParseOptions.h"
 #include "Token.h"
+#include <cstdint>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <vector>
 
 class Lexer {
  public:
-    Lexer(const std::string &program);
+    // The copy of the source, the tokens and the symbols are allocated from
+    // `resource`, which must outlive the Lexer.
+    Lexer(const std::string &program,
+          std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+    // Token lexemes point into the Lexer's own copy of the source, so it is
+    // neither copied nor moved.
+    Lexer(const Lexer &) = delete;
+    Lexer &operator=(const Lexer &) = delete;
+    void setOptions(const ParseOptions &options);
     bool parseProgram();
-    const std::vector<Token> &tokens() const;
+    const std::pmr::vector<Token> &tokens() const;
+    const Interner &symbols() const;
+    PARSE_STATUS status() const;
+    const std::string &error() const;  // "row:column: message" after a failed parse
+    // Rules entered by the last parse, attempts that backtracked included.
+    uint64_t ruleCalls() const;
 
  private:
     struct Utf8Char {
@@ -16,6 +34,15 @@ class Lexer {
         size_t length{};
     };
 
+    // Counts one rule call for the limits while it is in progress.
+    struct Rule {
+        Lexer &lexer;
+        bool entered;
+
+        explicit Rule(Lexer &owner) : lexer(owner), entered(owner.enterRule()) {}
+        ~Rule() { --lexer.depth_; }
+    };
+
     bool decodeUtf8(size_t index, Utf8Char &out) const;
     void reset();
     void skipWhitespace();
@@ -25,21 +52,25 @@ class Lexer {
     bool isIdentifierChar(size_t index, size_t &advance);
     void emitToken(TOKEN_TYPE type, int startIndex, int startRow, int startCol,
                    int endIndex = -1);
+    void dropTokensFrom(int index);
+    bool enterRule();
+    bool stop(PARSE_STATUS status, const std::string &message);
 
     bool peek(const std::string &symbols);
 
     char get();
+    std::string_view peekWord();
+    char peekAfter(size_t index) const;
+    bool startsExpr();
 
     bool next();
 
     bool letter();
     bool ruLetter();
-    bool digit();
     bool any();
     bool identifier();
 
-    bool integerLiteral();
-    bool floatLiteral();
+    bool numberLiteral(bool allowFloat);
     bool charLiteral();
     bool stringLiteral();
     bool boolLiteral();
@@ -97,7 +128,15 @@ class Lexer {
     bool arrowOp();
     bool literalList();
 
-    std::string program_;
-    std::vector<Token> tokens_;
+    std::pmr::string program_;
+    std::pmr::vector<Token> tokens_;
+    Interner symbols_;
     int symbolIndex_, row_, lastNewLineIndex_;
+    // Where a comma_expr operand after "," last failed to parse.
+    int failedOperand_ = -1;
+    ParseOptions options_;
+    PARSE_STATUS status_ = PARSE_OK;
+    std::string error_;
+    uint64_t ruleCalls_ = 0;
+    uint32_t depth_ = 0;
 };
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "Ast.h"
+
+// Copies syntax trees from other programs into one unit, re-interning every
+// symbol on the way.
+class Linker {
+ public:
+    explicit Linker(Program &unit) : unit_(unit) {}
+
+    void add(const Program &from, const ReprFunc &func);
+    void add(const Program &from, const ArrowBlock &block);
+
+ private:
+    uint32_t symbol(const Program &from, uint32_t id);
+    ExprPtr clone(const Program &from, const Expr &expr);
+    Block clone(const Program &from, const Block &block);
+
+    Program &unit_;
+};
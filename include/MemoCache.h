@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Module.h"
+
+#include <cstdint>
+#include <vector>
+
+// Bounded result cache of one pure function, keyed by the raw slots of its
+// parameters. Entries live in fixed arrays indexed through an open-addressing
+// table; once full, the CLOCK hand picks the first entry not used since its
+// last pass. Nothing is allocated before the first insert, and the arrays
+// double from there up to the capacity, so a function called with few
+// distinct arguments keeps a small cache.
+class MemoCache {
+ public:
+    MemoCache() = default;
+    MemoCache(uint32_t keySlots, uint32_t valueSlots, uint32_t capacity);
+
+    bool enabled() const { return capacity_ != 0; }
+    // Counts a hit or a miss; the result stays valid until the next insert.
+    const Slot *find(const Slot *key);
+    // Neither counts nor marks the entry, so any number of threads may peek
+    // into a cache that no one inserts into meanwhile.
+    const Slot *peek(const Slot *key) const;
+    void insert(const Slot *key, const Slot *value);
+    // Drops every entry and the storage, and zeroes the counters.
+    void clear();
+
+    uint64_t hits() const { return hits_; }
+    uint64_t misses() const { return misses_; }
+    uint64_t evictions() const { return evictions_; }
+    uint32_t size() const { return size_; }
+    uint32_t capacity() const { return capacity_; }
+
+ private:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    uint64_t hash(const Slot *key) const;
+    uint32_t probe(const Slot *key, uint64_t hash) const;
+    void erase(uint32_t entry);
+    void grow();
+
+    uint32_t keySlots_ = 0, valueSlots_ = 0, capacity_ = 0, size_ = 0, hand_ = 0;
+    uint32_t allocated_ = 0;  // entries the arrays hold now
+    std::vector<Slot> keys_, values_;
+    std::vector<uint64_t> hashes_;
+    std::vector<uint8_t> referenced_;
+    std::vector<uint32_t> table_;  // entry per bucket, NONE when free
+    uint64_t hits_ = 0, misses_ = 0, evictions_ = 0;
+};
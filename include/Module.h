@@ -0,0 +1,180 @@
+#pragma once
+
+#include "Ast.h"
+#include "Strings.h"
+#include "Value.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using BinaryKernel = bool (*)(Slot lhs, Slot rhs, Slot &out);
+using ArrayKernel = bool (*)(void *dst, const void *lhs, const void *rhs, size_t n);
+
+enum NODE_KIND {
+    NODE_CONST,
+    NODE_LOAD,
+    NODE_CONVERT,
+    NODE_UNARY,
+    NODE_BINARY,
+    NODE_AND,
+    NODE_OR,
+    NODE_CALL,
+    NODE_CONCAT,
+
+    NODE_ARRAY_LOAD,
+    NODE_ARRAY_LITERAL,
+    NODE_ARRAY_BINARY,
+    NODE_ARRAY_CONVERT,
+    NODE_ARRAY_CALL,
+
+    NODE_STORE,
+    NODE_ARRAY_STORE,
+    NODE_EVAL,
+    NODE_IF,
+    NODE_WHILE,
+    NODE_DO_WHILE,
+    NODE_FOR,
+    NODE_RETURN,
+    NODE_BLOCK
+};
+
+// Lowered expression or statement. Children are indices into Function::nodes,
+// variable-length operand lists live in Function::lists[first, first + count).
+//   NODE_BINARY        a, b operands in their own types, `binary` kernel
+//   NODE_CONCAT        a + b on stringa operands
+//   NODE_ARRAY_BINARY  a, b operands; broadcast 1/2 marks a scalar lhs/rhs
+//   NODE_IF            lists = cond0, body0, cond1, body1, ...
+//   NODE_WHILE         a = cond, b = body (NODE_DO_WHILE likewise)
+//   NODE_FOR           a = start, b = step (or -1), c = end, d = body,
+//                      slot = loop variable of type `from`
+//   NODE_CALL          callee, lists = argument per parameter
+//   NODE_RETURN        lists = one value per result, staged at `slot`;
+//                      or c = tail call whose results are forwarded unchanged
+//   NODE_BLOCK         lists = statements
+struct Node {
+    NODE_KIND kind = NODE_CONST;
+    VALUE_TYPE type = VALUE_I32;  // result type, element type for arrays
+    VALUE_TYPE from = VALUE_I32;  // operand type of conversions and operators
+    OPERATOR op = OP_ADD;
+    uint32_t length = 0;  // array length, 0 for scalars
+    uint8_t broadcast = 0;
+    int32_t a = -1, b = -1, c = -1, d = -1;
+    int32_t slot = -1;  // frame slot of a local, a temporary or a destination
+    int32_t callee = -1;
+    uint32_t first = 0, count = 0;
+    Slot constant{};
+    BinaryKernel binary = nullptr;
+    ArrayKernel kernel = nullptr;
+    uint32_t row = 0, column = 0;
+};
+
+// An outer scalar that a parallel loop only updates as `slot = slot op x`.
+// Every chunk starts it at `identity`; the chunk results are folded into
+// the caller's value with `combine` in chunk order.
+struct Reduction {
+    uint32_t slot = 0;
+    VALUE_TYPE type = VALUE_I64;
+    OPERATOR op = OP_ADD;
+    Slot identity{};
+    BinaryKernel combine = nullptr;
+};
+
+// A NODE_FOR whose iterations are independent, see analyseParallelLoops().
+struct ParallelLoop {
+    int32_t node = -1;
+    std::vector<Reduction> reductions;
+};
+
+// Frame layout: [params][locals and temporaries]. Results are handed back
+// through the interpreter's result buffer at `resultSlots` offsets.
+struct Function {
+    std::string name;
+    std::vector<TypeRef> params;
+    std::vector<uint32_t> paramSlots;
+    std::vector<TypeRef> results;
+    std::vector<uint32_t> resultSlots;
+    uint32_t resultSize = 0;
+    uint32_t paramSize = 0;
+    uint32_t frameSlots = 0;
+    int32_t body = -1;
+    bool pure = false;     // see analysePurity()
+    bool memoise = false;  // results are cached by argument tuple
+    std::vector<Node> nodes;
+    std::vector<int32_t> lists;
+    std::vector<ParallelLoop> parallelLoops;
+};
+
+// One value handed over by an arrow transfer: a forwarded result of the
+// source node (`source` >= 0) or a payload literal (`source` == -1). Results
+// arrive as `from` and are converted to `type`, the target parameter type.
+struct ArrowArg {
+    int32_t source = -1;
+    VALUE_TYPE from = VALUE_I32;
+    uint32_t sourceSlot = 0;  // offset in the result buffer
+    TypeRef type;
+    uint32_t slot = 0;  // parameter slot of the target
+    Slot constant{};  // payload in the target parameter type, as written for `end`
+    Value value;      // payload as written, used for transfers to `end`
+};
+
+// `from -> to` with its arguments in Arrow::args[first, first + count).
+// Payload literals fill the trailing parameters of the target; transfers out
+// of `start` list only their payload, the host inputs fill the rest.
+struct Transfer {
+    int32_t from = -1, to = -1;
+    uint32_t first = 0, count = 0;
+    uint32_t row = 0, column = 0;
+};
+
+// A graph node: a repr, `start` or `end`. Outgoing transfers are stored
+// contiguously in declaration order at Arrow::transfers[first, first + count).
+// `fused` lists the transfers of a chain that runs straight after this node,
+// see fuseArrowChains; execution then continues from the chain's last node.
+struct ArrowNode {
+    std::string name;
+    int32_t function = -1;
+    uint32_t first = 0, count = 0;
+    std::vector<uint32_t> fused;
+};
+
+// Compiled `#name { ... }` block. A node with several successors picks the
+// transfer by its first result and forwards the rest.
+struct Arrow {
+    std::string name;
+    int32_t start = -1, end = -1;
+    std::vector<ArrowNode> nodes;
+    std::vector<Transfer> transfers;
+    std::vector<ArrowArg> args;
+};
+
+struct Module {
+    std::vector<Function> functions;
+    std::unordered_map<std::string, int32_t> functionIndex;
+    std::vector<Arrow> arrows;
+    StringPool strings;  // stringa literals, see Strings.h
+
+    int32_t find(const std::string &name) const {
+        auto it = functionIndex.find(name);
+        return it == functionIndex.end() ? -1 : it->second;
+    }
+
+    int32_t findArrow(const std::string &name) const {
+        for (size_t i = 0; i < arrows.size(); ++i) {
+            if (arrows[i].name == name) return static_cast<int32_t>(i);
+        }
+        return -1;
+    }
+};
+
+uint32_t elementSize(VALUE_TYPE type);
+uint32_t slotCount(const TypeRef &type);
+
+Slot loadElement(const void *base, VALUE_TYPE type, size_t index);
+void storeElement(void *base, VALUE_TYPE type, size_t index, Slot value);
+
+Slot convertSlot(VALUE_TYPE from, VALUE_TYPE to, Slot value);
+// Numbers only; stringa values need storage, see Strings.h.
+Slot slotFromValue(const Value &value);
+Value valueFromSlot(VALUE_TYPE type, Slot slot);
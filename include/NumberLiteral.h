@@ -0,0 +1,19 @@
+#pragma once
+
+#include "Token.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// An integer_literal or float_literal recognised and decoded in one pass.
+struct NumberLiteral {
+    TOKEN_TYPE type = INTEGER_LITERAL;  // or FLOAT_LITERAL
+    size_t length = 0;                  // bytes consumed, 0 if `text` starts with no digit
+    bool inRange = true;                // false if the value does not fit an i64 or f64
+    int64_t integer = 0;
+    double real = 0.0;
+};
+
+// Scans digit { digit } [ "." digit { digit } ] at the start of `text`.
+NumberLiteral scanNumber(std::string_view text);
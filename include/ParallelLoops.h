@@ -0,0 +1,17 @@
+#pragma once
+
+#include "Module.h"
+
+// Fills Function::parallelLoops with the integer for-range loops whose
+// iterations may run in any order. A loop qualifies when its body
+//   - does not return,
+//   - reads every local declared in the body only after writing it in the
+//     same iteration, and
+//   - writes no outer variable except integer scalars updated as
+//     `acc = acc + x` or `acc = acc * x` and read nowhere else in the body.
+// Float accumulators are left out: chunks regroup the sum, which changes its
+// rounding with the thread count.
+// Arrays are written only whole, so an outer array written in the body is a
+// dependence like any other outer write. Calls qualify: every repr reads and
+// writes only its own frame (see analysePurity).
+void analyseParallelLoops(Module &module);
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Searches for the sources on which Lexer::parseProgram enters the most rules
+// per byte. Mutations are made of the grammar's own terminals and fragments,
+// so most candidates get deep into the rules instead of failing on the first
+// token. Whether a candidate parses does not matter: a failing parse can
+// backtrack as much as a passing one.
+struct FuzzOptions {
+    uint64_t iterations = 20000;
+    size_t maxBytes = 256;
+    size_t population = 64;
+    uint64_t seed = 1;
+    // Rule calls one parse may make. A candidate that reaches it is reported
+    // with this count rather than left to run.
+    uint64_t maxRuleCalls = 1 << 24;
+};
+
+struct FuzzCase {
+    std::string text;
+    uint64_t ruleCalls = 0;
+
+    double perByte() const;
+};
+
+// Rules entered by one parse of `text`, at most `limit` (0: no limit).
+uint64_t measureRuleCalls(const std::string &text, uint64_t limit = 0);
+
+// Grows the population from `seeds` and a few built-in programs and returns
+// it with the most calls per byte first.
+std::vector<FuzzCase> fuzzParser(const std::vector<std::string> &seeds,
+                                 const FuzzOptions &options);
+
+// Removes every piece of the text whose removal does not lower its calls per
+// byte, so what remains is the construct that costs the work.
+FuzzCase minimiseCase(const FuzzCase &input, uint64_t limit = 0);
+
+// The .pfru files of a corpus directory, sorted by path.
+bool readCorpus(const std::string &dir, std::vector<std::string> &paths,
+                std::vector<std::string> &texts, std::string &error);
+// Saves `text` as <dir>/<hash of text>.pfru unless it is there already.
+// Returns the path.
+std::string saveCorpusCase(const std::string &dir, const std::string &text);
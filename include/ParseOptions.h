@@ -0,0 +1,34 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+enum PARSE_STATUS {
+    PARSE_OK,
+    PARSE_SYNTAX_ERROR,
+    PARSE_RULE_LIMIT,
+    PARSE_DEPTH_LIMIT,
+    PARSE_TOKEN_LIMIT,
+    PARSE_CANCELLED,
+};
+
+const uint32_t DEFAULT_MAX_PARSE_DEPTH = 4096;
+// Rules a parser enters between two looks at ParseOptions::cancel.
+const uint64_t CANCEL_CHECK_INTERVAL = 1024;
+
+// Bounds on the work of one parse of a source that cannot be trusted. The
+// parser stops at the first limit it reaches, reports it as its status and
+// gives the position it had got to in its error. 0 lifts a limit.
+struct ParseOptions {
+    // Rules entered. The Lexer counts every attempt it backtracks out of;
+    // TableParser expands each rule once.
+    uint64_t maxRuleCalls = 0;
+    // TableParser counts open brackets and the operators chained inside each
+    // (see TableParser). The Lexer counts the rules in progress instead, as
+    // each holds a native stack frame.
+    uint32_t maxDepth = DEFAULT_MAX_PARSE_DEPTH;
+    // Tokens held at once.
+    uint64_t maxTokens = 0;
+    // Set from another thread to stop the parse.
+    const std::atomic<bool> *cancel = nullptr;
+};
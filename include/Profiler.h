@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Module.h"
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+// Call and arrow-edge statistics gathered by an Interpreter it is attached
+// to. Calls are counted per calling context, so per-repr totals and folded
+// stacks come from the same tree. A tail call replaces its caller's frame and
+// shows up as a sibling of it.
+class Profiler {
+ public:
+    explicit Profiler(const Module &module);
+
+    static uint64_t now() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                         std::chrono::steady_clock::now().time_since_epoch())
+                                         .count());
+    }
+
+    void enter(int32_t function);
+    // `calls` > 1 when one frame ran the function over a column of rows.
+    void leave(uint64_t calls = 1);
+    // A tail call: leaves the current frame and enters `function` in its place.
+    void replace(int32_t function);
+    // One traversal of arrows[arrow].transfers[transfer]: `moveNs` is spent
+    // passing values along the edge, `targetNs` running the repr it leads to.
+    void traverse(int32_t arrow, uint32_t transfer, uint64_t moveNs, uint64_t targetNs);
+    uint64_t traversals(int32_t arrow, uint32_t transfer) const {
+        return edges_[arrow][transfer].traversals;
+    }
+
+    void writeReport(std::ostream &out) const;
+    // One "caller;callee <microseconds>" line per calling context, the input
+    // format of flamegraph.pl and speedscope.
+    void writeFoldedStacks(std::ostream &out) const;
+
+ private:
+    struct Totals {
+        uint64_t calls = 0;
+        uint64_t inclusiveNs = 0;  // outermost activations only, so recursion counts once
+        uint64_t exclusiveNs = 0;
+    };
+
+    struct Context {
+        int32_t function;
+        uint32_t parent;
+        uint64_t calls = 0;
+        uint64_t selfNs = 0;
+        int32_t lastFunction = -1;  // the child entered last, found without hashing
+        uint32_t lastChild = 0;
+    };
+
+    struct Frame {
+        uint32_t context;
+        uint64_t start;
+        uint64_t childNs = 0;
+    };
+
+    struct Edge {
+        uint64_t traversals = 0;
+        uint64_t moveNs = 0;
+        uint64_t targetNs = 0;
+    };
+
+    uint32_t context(uint32_t parent, int32_t function);
+    uint64_t close(uint64_t at, uint64_t calls);
+
+    const Module &module_;
+    std::vector<Totals> totals_;
+    std::vector<uint32_t> active_;      // per function: frames on the stack
+    std::vector<Context> contexts_;     // contexts_[0] is the root
+    std::unordered_map<uint64_t, uint32_t> children_;  // parent << 32 | function -> context
+    std::vector<Frame> stack_;
+    std::vector<std::vector<Edge>> edges_;  // per arrow block, per transfer
+};
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "Module.h"
+
+// Marks every function whose result depends only on its arguments
+// (Function::pure) and, among those, the ones worth caching
+// (Function::memoise). Impurity spreads from effectful nodes to all
+// transitive callers; the pass is linear in the size of the module.
+void analysePurity(Module &module);
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// pfru serve <socket>: a daemon answering parse, check, run and flow requests
+// on a Unix-domain socket. Each file is parsed, folded and compiled once and
+// stays resident, keyed by path and content hash, so a request on an
+// unchanged file costs a file read and a hash before it runs.
+//
+// Every message is a frame: a 32-bit little-endian length, then that many
+// bytes. A request is its command-line words separated by NUL bytes, e.g.
+// "run\0/abs/path.pfru\0sum\0001\0002". A reply is a status byte, 0 for
+// success and 1 for failure, followed by the text the command would print.
+// Connections stay open for any number of requests. The server reads them
+// without blocking and runs each complete request as one task on a thread
+// pool, so clients that stall hold no worker; one that leaves a request
+// unfinished for 5 seconds is dropped. At most 64 files stay resident, the
+// least recently requested leaving first. "stats" reports cache counters and
+// "stop" shuts the server down.
+bool serve(const std::string &socketPath, unsigned threads = 0);
+
+// Sends one request and prints the reply to stdout, or stderr on failure.
+// File arguments are made absolute first so they name the server's cache key.
+bool sendRequest(const std::string &socketPath, const std::vector<std::string> &words);
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "Module.h"
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+enum SSA_KIND {
+    SSA_PARAM,
+    SSA_CONST,
+    SSA_PHI,
+    SSA_COPY,
+    SSA_CONVERT,
+    SSA_UNARY,
+    SSA_BINARY,
+    SSA_RANGE,
+    SSA_CALL,
+    SSA_ARRAY,
+    SSA_ARRAY_BINARY,
+    SSA_CHECK_STEP,
+
+    SSA_JUMP,
+    SSA_BRANCH,
+    SSA_RETURN
+};
+
+// One instruction; its id is its index in SsaFunction::insts and doubles as
+// the id of the value it defines. Types are the ones the compiler inferred,
+// element types for arrays.
+//   SSA_PARAM         index = parameter
+//   SSA_PHI           one operand per predecessor, in SsaBlock::preds order
+//   SSA_COPY          a store to the frame slot `slot`
+//   SSA_CONVERT       operand of type `from`, also for arrays
+//   SSA_BINARY        operands in their own types, `binary` kernel; none for
+//                     stringa concatenation
+//   SSA_RANGE         step > 0 ? a < end : a > end, for range loops whose
+//                     step is not a constant; operands = a, step, end
+//   SSA_CALL          operands = arguments
+//   SSA_ARRAY         operands = elements, none for a zero array
+//   SSA_ARRAY_BINARY  broadcast 1/2 marks a scalar lhs/rhs, `kernel`
+//   SSA_CHECK_STEP    fails on a zero range step
+//   SSA_BRANCH        operand = condition, taken to succs[0], else succs[1]
+//   SSA_RETURN        operands = results; `forward` returns every result of
+//                     the call that is its only operand
+// Instructions with no block (NONE) have been removed by a pass.
+struct SsaInst {
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    SSA_KIND kind = SSA_CONST;
+    VALUE_TYPE type = VALUE_I32;
+    VALUE_TYPE from = VALUE_I32;
+    OPERATOR op = OP_ADD;
+    uint32_t length = 0;  // array length, 0 for scalars
+    uint8_t broadcast = 0;
+    bool forward = false;
+    int32_t callee = -1;
+    int32_t slot = -1;
+    uint32_t index = 0;
+    Slot constant{};
+    BinaryKernel binary = nullptr;
+    ArrayKernel kernel = nullptr;
+    uint32_t block = NONE;
+    std::vector<uint32_t> operands;
+    uint32_t row = 0, column = 0;
+};
+
+struct SsaBlock {
+    std::vector<uint32_t> insts;  // phis first, one terminator last
+    std::vector<uint32_t> preds, succs;
+};
+
+// Control-flow graph of one repr in SSA form. blocks[0] is the entry.
+struct SsaFunction {
+    std::string name;
+    int32_t function = -1;
+    std::vector<SsaBlock> blocks;
+    std::vector<SsaInst> insts;
+};
+
+// Lowers a compiled function. Frame slots become SSA values: every store is a
+// copy and phis join the slots' values where control flow meets, so the
+// result still contains copies and redundant phis for the passes to remove.
+// `&&` and `||` keep their short-circuit branches.
+void lowerToSsa(const Module &module, int32_t function, SsaFunction &out);
+
+void writeSsa(const Module &module, const SsaFunction &fn, std::ostream &out);
+
+// Block order in which every block comes after its dominators, and the
+// immediate dominator of each block (NONE when unreachable, the entry for
+// itself).
+std::vector<uint32_t> reversePostOrder(const SsaFunction &fn);
+std::vector<uint32_t> immediateDominators(const SsaFunction &fn,
+                                          const std::vector<uint32_t> &order);
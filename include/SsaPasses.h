@@ -0,0 +1,26 @@
+#pragma once
+
+#include "Module.h"
+#include "Ssa.h"
+
+#include <ostream>
+
+// Each pass returns how many instructions it removed or moved.
+
+// Replaces copies, and phis whose operands are all one value, by that value.
+size_t propagateCopies(SsaFunction &fn);
+// Moves operations whose operands are all defined outside a loop into the
+// block that enters the loop. Only operations that cannot fail are moved,
+// since the loop body may never run.
+size_t hoistLoopInvariants(SsaFunction &fn);
+// Dominator-scoped value numbering: an operation that repeats a dominating
+// one with the same operands is replaced by it. Calls count only if the
+// callee is pure.
+size_t eliminateCommonSubexpressions(const Module &module, SsaFunction &fn);
+// Drops unreachable blocks, then every value nothing observable depends on.
+// Calls, range checks and integer division stay, as they may fail.
+size_t eliminateDeadCode(SsaFunction &fn);
+
+// Runs the passes above in a fixed order. With `dump`, the IR is written
+// before the first pass and after each one.
+void optimiseSsa(const Module &module, SsaFunction &fn, std::ostream *dump = nullptr);
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "Value.h"
+
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// A stringa value is one Slot, so it moves through frames, results and arrow
+// transfers like any scalar. Up to kMaxInlineString bytes are stored in the
+// slot itself: the first byte holds (length << 1) | 1, the text follows and
+// the rest is zero. Longer text is a pointer to an immutable StringBuffer
+// that every copy of the value shares. The empty string is the all-zero slot,
+// so zero-initialised locals hold "". Short strings are never stored as
+// buffers, so equal short strings always have equal slots.
+static_assert(std::endian::native == std::endian::little, "inline strings use the low byte");
+
+constexpr size_t kMaxInlineString = sizeof(Slot) - 1;
+
+struct StringBuffer {
+    const char *data;
+    uint64_t size;
+};
+
+inline bool isInlineString(Slot slot) { return slot.i & 1; }
+
+// The view of an inline string points into `slot`, which must outlive it.
+inline std::string_view stringView(const Slot &slot) {
+    if (isInlineString(slot)) {
+        const char *bytes = reinterpret_cast<const char *>(&slot);
+        return std::string_view(bytes + 1, static_cast<unsigned char>(bytes[0]) >> 1);
+    }
+    if (slot.i == 0) return std::string_view();
+    const StringBuffer *buffer = reinterpret_cast<const StringBuffer *>(slot.i);
+    return std::string_view(buffer->data, buffer->size);
+}
+
+bool equalStrings(Slot lhs, Slot rhs);
+int compareStrings(Slot lhs, Slot rhs);
+
+// Bump allocator for the strings built while a program runs. Text and
+// buffers live in separate blocks, so the text of the string built last
+// always ends at the top of its block and can be extended in place: `s = s +
+// t` in a loop copies only `t`. Values stay valid until clear().
+class StringHeap {
+ public:
+    StringHeap() = default;
+    StringHeap(const StringHeap &) = delete;
+    StringHeap &operator=(const StringHeap &) = delete;
+    StringHeap(StringHeap &&) = default;
+    StringHeap &operator=(StringHeap &&) = default;
+
+    Slot make(std::string_view text);
+    Slot concat(Slot lhs, Slot rhs);
+    // A copy of `slot` owned by this heap. Inline and empty strings need no
+    // storage and come back unchanged.
+    Slot copy(Slot slot);
+    // Drops every string, keeping the largest block of each kind.
+    void clear();
+    // Bytes held in blocks, used or not.
+    size_t footprint() const;
+
+ private:
+    struct Region {
+        std::vector<std::unique_ptr<char[]>> blocks;
+        std::vector<size_t> sizes;
+        char *begin = nullptr, *top = nullptr, *limit = nullptr;
+        size_t held = 0;
+
+        // A new block also fits `room` more bytes after this allocation.
+        char *allocate(size_t size, size_t align, size_t room = 0);
+        void clear();
+    };
+
+    Slot buffer(const char *data, size_t size);
+
+    Region text_, buffers_;
+};
+
+// Interned string literals of a module. Equal literals share one value, and
+// the values stay valid for the lifetime of the pool.
+class StringPool {
+ public:
+    Slot intern(std::string_view text);
+
+ private:
+    StringHeap heap_;
+    std::unordered_map<std::string_view, Slot> index_;
+};
+
+// Inline strings need no storage; longer ones are copied into `heap`.
+Slot slotFromValue(const Value &value, StringHeap &heap);
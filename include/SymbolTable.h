@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Interner.h"
+
+#include <cstdint>
+#include <vector>
+
+enum SYMBOL_KIND { SYMBOL_REPR, SYMBOL_PARAM, SYMBOL_LOCAL, SYMBOL_ARROW_NODE };
+
+// Scoped bindings kept in flat arrays indexed by interned id. `current_`
+// holds the innermost binding of every id, so lookup is one array read;
+// leaving a scope pops its bindings and restores the ones they shadowed.
+template <typename T>
+class SymbolTable {
+ public:
+    struct Binding {
+        uint32_t symbol;
+        SYMBOL_KIND kind;
+        uint32_t shadowed;
+        T value;
+    };
+
+    explicit SymbolTable(uint32_t symbols = 0) { reset(symbols); }
+
+    void reset(uint32_t symbols) {
+        current_.assign(symbols, Interner::NONE);
+        bindings_.clear();
+        marks_.clear();
+    }
+
+    void enterScope() { marks_.push_back(static_cast<uint32_t>(bindings_.size())); }
+
+    void leaveScope() {
+        uint32_t mark = marks_.back();
+        marks_.pop_back();
+        while (bindings_.size() > mark) {
+            current_[bindings_.back().symbol] = bindings_.back().shadowed;
+            bindings_.pop_back();
+        }
+    }
+
+    // Rebinding a symbol in the same scope replaces the binding in place.
+    T &bind(uint32_t symbol, SYMBOL_KIND kind, const T &value) {
+        if (symbol >= current_.size()) current_.resize(symbol + 1, Interner::NONE);
+        uint32_t existing = current_[symbol];
+        if (existing != Interner::NONE && !marks_.empty() && existing >= marks_.back()) {
+            bindings_[existing].kind = kind;
+            return bindings_[existing].value = value;
+        }
+        current_[symbol] = static_cast<uint32_t>(bindings_.size());
+        bindings_.push_back(Binding{symbol, kind, existing, value});
+        return bindings_.back().value;
+    }
+
+    const Binding *lookup(uint32_t symbol) const {
+        if (symbol >= current_.size() || current_[symbol] == Interner::NONE) return nullptr;
+        return &bindings_[current_[symbol]];
+    }
+
+    Binding *lookup(uint32_t symbol) {
+        if (symbol >= current_.size() || current_[symbol] == Interner::NONE) return nullptr;
+        return &bindings_[current_[symbol]];
+    }
+
+ private:
+    std::vector<uint32_t> current_;
+    std::vector<Binding> bindings_;
+    std::vector<uint32_t> marks_;
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "Interner.h"
+#include "ParseOptions.h"
+#include "Token.h"
+
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+// LL(2) parser driven by the tables pfru_grammar generates from the BNF in
+// Пфру.tex. It produces the same post-order tokens as Lexer from an explicit
+// stack and without backtracking, so nesting is bounded by memory rather than
+// the native stack. The depth it limits is that of the syntax tree the later
+// passes recurse over: open brackets plus the operators chained inside each,
+// so `x + x + ... + x` is as deep as it has terms.
+class TableParser {
+ public:
+    // Deepest nesting of brackets and operator chains accepted by default.
+    static const uint32_t DEFAULT_MAX_DEPTH = DEFAULT_MAX_PARSE_DEPTH;
+
+    // The copy of the source, the tokens, the symbols and the parse stack are
+    // allocated from `resource`, which must outlive the parser.
+    explicit TableParser(std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+    explicit TableParser(const std::string &program,
+                         std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+    // Token lexemes point into the parser's own copy of the source, so it is
+    // neither copied nor moved.
+    TableParser(const TableParser &) = delete;
+    TableParser &operator=(const TableParser &) = delete;
+    void setOptions(const ParseOptions &options);
+    void setMaxDepth(uint32_t depth);  // 0 lifts the limit
+    // Positions of later parses count from row:column, for a source cut out
+    // of a larger file.
+    void setOrigin(uint32_t row, uint32_t column);
+    bool parseProgram();
+    // Parses a new source in place of the current one, reusing the source,
+    // token and stack buffers of earlier parses.
+    bool parseProgram(const std::string &program);
+    const std::pmr::vector<Token> &tokens() const;
+    const Interner &symbols() const;
+    PARSE_STATUS status() const;
+    const std::string &error() const;  // "row:column: message" after a failed parse
+    uint32_t depthReached() const;
+
+ private:
+    struct Lexeme {
+        uint16_t terminal;
+        uint32_t offset, end;
+        uint32_t row, column;
+        union {  // decoded by scan()
+            int64_t integer;
+            double real;
+        };
+    };
+
+    // A grammar symbol still to be matched, or the end of a rule whose token
+    // is emitted once everything it expanded to has been matched.
+    struct Frame {
+        uint32_t symbol;
+        uint32_t offset, row, column;
+    };
+
+    void reset();
+    void next();
+    void skipWhitespace();
+    bool isIdentifierChar(size_t index, size_t &advance) const;
+    void scan(Lexeme &out);
+    const Lexeme &lookahead(size_t k);
+    void advance();
+    void emitToken(TOKEN_TYPE type, uint32_t offset, uint32_t end, uint32_t row, uint32_t column);
+    bool fail(const Lexeme &at, const std::string &message,
+              PARSE_STATUS status = PARSE_SYNTAX_ERROR);
+    std::string describe(const Lexeme &lexeme) const;
+    std::string expected(uint16_t rule) const;
+
+    std::pmr::string program_;
+    std::pmr::vector<Token> tokens_;
+    Interner symbols_;
+    ParseOptions options_;
+    PARSE_STATUS status_;
+    std::string error_, scanError_;
+    std::pmr::vector<Frame> stack_;
+    Lexeme ahead_[2];
+    size_t buffered_;
+    size_t index_;
+    uint32_t row_;
+    int64_t lastNewLineIndex_;
+    uint32_t lastEnd_;  // end of the last matched terminal
+    uint64_t ruleCalls_;
+    // Depth before each bracket still open.
+    std::pmr::vector<uint32_t> levels_;
+    uint32_t depth_, depthReached_;
+    uint32_t originRow_, originColumn_;
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads draining one FIFO queue. Tasks may submit
+// further tasks; wait() returns once the queue is empty and no task runs.
+class ThreadPool {
+ public:
+    explicit ThreadPool(unsigned threads = 0);  // 0: one per hardware thread
+    ~ThreadPool();
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    void submit(std::function<void()> task);
+    void wait();
+    unsigned size() const;
+
+ private:
+    void work();
+
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable ready_, idle_;
+    size_t active_ = 0;
+    bool stopping_ = false;
+};
@@ -2,11 +2,11 @@
 
 #include <cstdint>
 #include <string>
+#include <string_view>
 
 enum TOKEN_TYPE {
     LETTER,
     RU_LETTER,
-    DIGIT,
     ANY,
     IDENTIFIER,
 
@@ -74,5 +74,11 @@ enum TOKEN_TYPE {
 struct Token {
     TOKEN_TYPE type;
     uint32_t row, column;
-    std::string lexeme;
+    uint32_t offset;
+    std::string_view lexeme;  // into the parser's copy of the source
+    uint32_t symbol = UINT32_MAX;  // interned id of IDENTIFIER / ARROW_NODE
+    union {                        // decoded INTEGER_LITERAL / FLOAT_LITERAL
+        int64_t integer = 0;
+        double real;
+    };
 };
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Module.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+enum TRACE_KIND : uint8_t { TRACE_ENTER, TRACE_EXIT, TRACE_TRANSFER };
+
+// Entries and exits carry a function index; a transfer carries its arrow
+// block and its index in that block's transfers, which names the source and
+// target nodes and the payload literals.
+struct TraceEvent {
+    uint64_t ticks;
+    uint32_t id;
+    uint16_t arrow;
+    TRACE_KIND kind;
+};
+
+// Fixed-size event buffer written by one thread. When full, the oldest
+// events are overwritten; the slot after the newest event may be in the
+// middle of a write, so the last `capacity` - 1 events are kept. Writing
+// takes no lock, no atomic read-modify-write and no allocation.
+class alignas(64) TraceRing {
+ public:
+    explicit TraceRing(size_t capacity);
+
+    static uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                         std::chrono::steady_clock::now().time_since_epoch())
+                                         .count());
+#endif
+    }
+
+    void record(TRACE_KIND kind, uint32_t id, uint16_t arrow = 0) {
+        events_[next_ & mask_] = TraceEvent{ticks(), id, arrow, kind};
+        head_.store(++next_, std::memory_order_release);
+    }
+
+    // Copies the retained events, oldest first. Safe while the owner keeps
+    // recording: events overwritten during the copy are dropped.
+    void snapshot(std::vector<TraceEvent> &out) const;
+
+ private:
+    std::unique_ptr<TraceEvent[]> events_;
+    uint64_t mask_;
+    uint64_t next_ = 0;  // owner's copy of head_
+    std::atomic<uint64_t> head_{0};
+};
+
+// Hands every recording thread its own TraceRing and exports all of them as
+// one Chrome trace-event file (chrome://tracing, Perfetto, speedscope).
+class Tracer {
+ public:
+    // `eventsPerThread` is rounded up to a power of two.
+    explicit Tracer(size_t eventsPerThread = 1 << 20);
+    Tracer(const Tracer &) = delete;
+    Tracer &operator=(const Tracer &) = delete;
+
+    // The calling thread's ring; the first call per thread allocates it.
+    // A thread that switches between tracers gets its own ring back.
+    TraceRing &ring();
+    void writeChromeTrace(const Module &module, std::ostream &out);
+
+ private:
+    uint64_t id_;
+    size_t capacity_;
+    uint64_t startTicks_;
+    std::chrono::steady_clock::time_point start_;
+    std::mutex mutex_;  // guards rings_ and owners_; recording never takes it
+    std::vector<std::unique_ptr<TraceRing>> rings_;
+    std::vector<std::thread::id> owners_;
+};
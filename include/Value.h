@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+enum VALUE_TYPE {
+    VALUE_I8,
+    VALUE_I16,
+    VALUE_I32,
+    VALUE_I64,
+    VALUE_F32,
+    VALUE_F64,
+    VALUE_CHAR,
+    VALUE_STRINGA,
+    VALUE_BOOL
+};
+
+// One 8-byte frame cell. Scalars occupy one slot; a fixed-size array `T[N]`
+// is stored inline as N packed elements spanning ceil(N * sizeof(T) / 8) slots.
+// A stringa slot is a handle, see Strings.h.
+union Slot {
+    int64_t i;
+    double f;
+};
+
+struct Value {
+    VALUE_TYPE type = VALUE_I32;
+    int64_t i = 0;  // integers, char code points and bools
+    double f = 0.0;
+    std::string s;
+};
+
+bool valueTypeFromName(const std::string &name, VALUE_TYPE &out);
+const char *valueTypeName(VALUE_TYPE type);
+
+constexpr bool isSignedInteger(VALUE_TYPE type) {
+    return type == VALUE_I8 || type == VALUE_I16 || type == VALUE_I32 ||
+           type == VALUE_I64;
+}
+
+constexpr bool isFloating(VALUE_TYPE type) {
+    return type == VALUE_F32 || type == VALUE_F64;
+}
+
+constexpr int integerBits(VALUE_TYPE type) {
+    switch (type) {
+        case VALUE_I8: return 8;
+        case VALUE_I16: return 16;
+        case VALUE_I32: return 32;
+        case VALUE_CHAR: return 32;
+        case VALUE_BOOL: return 1;
+        default: return 64;
+    }
+}
+
+int64_t wrapInteger(VALUE_TYPE type, int64_t value);
+
+Value makeInteger(VALUE_TYPE type, int64_t value);
+Value makeFloat(VALUE_TYPE type, double value);
+Value makeBool(bool value);
+Value makeString(const std::string &text);
+
+bool isTruthy(const Value &value);
+bool convertValue(const Value &value, VALUE_TYPE target, Value &out);
+// Whether a constant converts to `target` without changing its meaning: a
+// signed integer must not wrap, and a finite float must not become an f32
+// infinity. Other conversions are not range-checked.
+bool constantFits(const Value &value, VALUE_TYPE target);
+bool sameValue(const Value &a, const Value &b);
+std::string formatValue(const Value &value);
+// Command-line form: a stringa when the text is in double quotes, otherwise an
+// i64, or an f64 when the text has a '.', 'e' or 'E'.
+bool parseValue(const std::string &text, Value &value);
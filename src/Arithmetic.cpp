@@ -0,0 +1,55 @@
+#include "../include/Arithmetic.h"
+
+#include "../include/BinaryKernels.h"
+
+namespace {
+int64_t wrapSub(VALUE_TYPE t, int64_t a, int64_t b) {
+    return wrapInteger(t, static_cast<int64_t>(static_cast<uint64_t>(a) -
+                                               static_cast<uint64_t>(b)));
+}
+}  // namespace
+
+bool evalBinary(OPERATOR op, const Value &lhs, const Value &rhs, Value &out) {
+    VALUE_TYPE result, operand;
+    if (!binaryResultType(op, lhs.type, rhs.type, result, operand)) return false;
+
+    if (operand == VALUE_STRINGA) {
+        int cmp = lhs.s.compare(rhs.s);
+        switch (op) {
+            case OP_ADD: out = makeString(lhs.s + rhs.s); return true;
+            case OP_EQ: out = makeBool(cmp == 0); return true;
+            case OP_NE: out = makeBool(cmp != 0); return true;
+            case OP_LT: out = makeBool(cmp < 0); return true;
+            case OP_GT: out = makeBool(cmp > 0); return true;
+            case OP_LE: out = makeBool(cmp <= 0); return true;
+            case OP_GE: out = makeBool(cmp >= 0); return true;
+            default: return false;
+        }
+    }
+
+    // Numbers go through the same kernels as the runtime.
+    BinaryKernel kernel = findBinaryKernel(op, lhs.type, rhs.type);
+    Slot value;
+    if (!kernel || !kernel(slotFromValue(lhs), slotFromValue(rhs), value)) return false;
+    out = valueFromSlot(result, value);
+    return true;
+}
+
+bool evalUnary(OPERATOR op, const Value &operand, Value &out) {
+    VALUE_TYPE result;
+    if (!unaryResultType(op, operand.type, result)) return false;
+    if (op == OP_NOT) {
+        out = makeBool(!isTruthy(operand));
+        return true;
+    }
+    Value v;
+    if (!convertValue(operand, result, v)) return false;
+    if (op == OP_PLUS) {
+        out = v;
+    } else if (isFloating(result)) {
+        out = makeFloat(result, -v.f);
+    } else {
+        out = makeInteger(result, wrapSub(result, 0, v.i));
+    }
+    return true;
+}
@@ -0,0 +1,157 @@
+#include "../include/ArrayKernels.h"
+
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+
+namespace {
+const size_t kVectorBytes = 32;
+
+// Integer lanes are computed on the unsigned type so that overflow wraps.
+template <typename T, bool = std::is_integral_v<T>>
+struct LaneType {
+    using type = T;
+};
+
+template <typename T>
+struct LaneType<T, true> {
+    using type = std::make_unsigned_t<T>;
+};
+
+template <typename T>
+using Lane = typename LaneType<T>::type;
+
+template <typename T, OPERATOR OP>
+constexpr bool kVectorizable =
+    OP == OP_ADD || OP == OP_SUB || OP == OP_MUL ||
+    (std::is_floating_point_v<T> && OP == OP_DIV) ||
+    (std::is_integral_v<T> &&
+     (OP == OP_BIT_AND || OP == OP_BIT_OR || OP == OP_BIT_XOR || OP == OP_SHL ||
+      OP == OP_SHR));
+
+template <typename T, OPERATOR OP>
+bool scalarOp(T x, T y, T &out) {
+    constexpr int bits = sizeof(T) * 8;
+    if constexpr (std::is_floating_point_v<T>) {
+        if constexpr (OP == OP_ADD) out = x + y;
+        if constexpr (OP == OP_SUB) out = x - y;
+        if constexpr (OP == OP_MUL) out = x * y;
+        if constexpr (OP == OP_DIV) out = x / y;
+        if constexpr (OP == OP_MOD) out = static_cast<T>(std::fmod(x, y));
+        return true;
+    } else {
+        // Not Lane<T>: uint8_t and uint16_t would be promoted to int, where
+        // their products can overflow.
+        using U = std::common_type_t<Lane<T>, unsigned>;
+        if constexpr (OP == OP_ADD) out = static_cast<T>(static_cast<U>(x) + static_cast<U>(y));
+        if constexpr (OP == OP_SUB) out = static_cast<T>(static_cast<U>(x) - static_cast<U>(y));
+        if constexpr (OP == OP_MUL) out = static_cast<T>(static_cast<U>(x) * static_cast<U>(y));
+        if constexpr (OP == OP_BIT_AND) out = x & y;
+        if constexpr (OP == OP_BIT_OR) out = x | y;
+        if constexpr (OP == OP_BIT_XOR) out = x ^ y;
+        if constexpr (OP == OP_SHL) out = static_cast<T>(static_cast<U>(x) << (y & (bits - 1)));
+        if constexpr (OP == OP_SHR) out = static_cast<T>(x >> (y & (bits - 1)));
+        if constexpr (OP == OP_DIV || OP == OP_MOD) {
+            if (y == 0) return false;
+            if (y == -1) {
+                out = OP == OP_DIV ? static_cast<T>(U(0) - static_cast<U>(x)) : T(0);
+            } else {
+                out = OP == OP_DIV ? static_cast<T>(x / y) : static_cast<T>(x % y);
+            }
+        }
+        return true;
+    }
+}
+
+#if defined(__GNUC__)
+template <typename T, OPERATOR OP>
+void vectorLoop(T *dst, const T *a, const T *b, size_t n, size_t &i, uint8_t broadcast) {
+    using U = std::conditional_t<OP == OP_SHR, T, Lane<T>>;
+    typedef U Vec __attribute__((vector_size(kVectorBytes)));
+    constexpr size_t lanes = kVectorBytes / sizeof(T);
+    constexpr U mask = static_cast<U>(sizeof(T) * 8 - 1);
+    Vec va{}, vb{};
+    if (broadcast == 1) va = va + static_cast<U>(a[0]);
+    if (broadcast == 2) vb = vb + static_cast<U>(b[0]);
+    for (; i + lanes <= n; i += lanes) {
+        if (broadcast != 1) std::memcpy(&va, a + i, kVectorBytes);
+        if (broadcast != 2) std::memcpy(&vb, b + i, kVectorBytes);
+        Vec r;
+        if constexpr (OP == OP_ADD) r = va + vb;
+        if constexpr (OP == OP_SUB) r = va - vb;
+        if constexpr (OP == OP_MUL) r = va * vb;
+        if constexpr (OP == OP_DIV) r = va / vb;
+        if constexpr (OP == OP_BIT_AND) r = va & vb;
+        if constexpr (OP == OP_BIT_OR) r = va | vb;
+        if constexpr (OP == OP_BIT_XOR) r = va ^ vb;
+        if constexpr (OP == OP_SHL || OP == OP_SHR) {
+            Vec count = vb & mask;
+            r = OP == OP_SHL ? va << count : va >> count;
+        }
+        std::memcpy(dst + i, &r, kVectorBytes);
+    }
+}
+#endif
+
+template <typename T, OPERATOR OP, uint8_t BROADCAST>
+bool kernel(void *dstRaw, const void *lhsRaw, const void *rhsRaw, size_t n) {
+    T *dst = static_cast<T *>(dstRaw);
+    const T *a = static_cast<const T *>(lhsRaw);
+    const T *b = static_cast<const T *>(rhsRaw);
+    size_t i = 0;
+#if defined(__GNUC__)
+    if constexpr (kVectorizable<T, OP>) vectorLoop<T, OP>(dst, a, b, n, i, BROADCAST);
+#endif
+    for (; i < n; ++i) {
+        T x = BROADCAST == 1 ? a[0] : a[i];
+        T y = BROADCAST == 2 ? b[0] : b[i];
+        if (!scalarOp<T, OP>(x, y, dst[i])) return false;
+    }
+    return true;
+}
+
+template <typename T, OPERATOR OP>
+ArrayKernel select(uint8_t broadcast) {
+    if constexpr (std::is_floating_point_v<T> &&
+                  (OP == OP_BIT_AND || OP == OP_BIT_OR || OP == OP_BIT_XOR ||
+                   OP == OP_SHL || OP == OP_SHR)) {
+        return nullptr;
+    } else {
+        switch (broadcast) {
+            case 0: return &kernel<T, OP, 0>;
+            case 1: return &kernel<T, OP, 1>;
+            case 2: return &kernel<T, OP, 2>;
+        }
+        return nullptr;
+    }
+}
+
+template <typename T>
+ArrayKernel selectOp(OPERATOR op, uint8_t broadcast) {
+    switch (op) {
+        case OP_ADD: return select<T, OP_ADD>(broadcast);
+        case OP_SUB: return select<T, OP_SUB>(broadcast);
+        case OP_MUL: return select<T, OP_MUL>(broadcast);
+        case OP_DIV: return select<T, OP_DIV>(broadcast);
+        case OP_MOD: return select<T, OP_MOD>(broadcast);
+        case OP_BIT_AND: return select<T, OP_BIT_AND>(broadcast);
+        case OP_BIT_OR: return select<T, OP_BIT_OR>(broadcast);
+        case OP_BIT_XOR: return select<T, OP_BIT_XOR>(broadcast);
+        case OP_SHL: return select<T, OP_SHL>(broadcast);
+        case OP_SHR: return select<T, OP_SHR>(broadcast);
+        default: return nullptr;
+    }
+}
+}  // namespace
+
+ArrayKernel findArrayKernel(OPERATOR op, VALUE_TYPE element, uint8_t broadcast) {
+    switch (element) {
+        case VALUE_I8: return selectOp<int8_t>(op, broadcast);
+        case VALUE_I16: return selectOp<int16_t>(op, broadcast);
+        case VALUE_I32: return selectOp<int32_t>(op, broadcast);
+        case VALUE_I64: return selectOp<int64_t>(op, broadcast);
+        case VALUE_F32: return selectOp<float>(op, broadcast);
+        case VALUE_F64: return selectOp<double>(op, broadcast);
+        default: return nullptr;
+    }
+}
@@ -0,0 +1,103 @@
+#include "../include/ArrowFusion.h"
+
+#include <sstream>
+
+namespace {
+bool isRepr(const Arrow &arrow, int32_t node) {
+    return node != arrow.start && node != arrow.end;
+}
+}  // namespace
+
+void collectEdgeCounts(const Module &module, const Profiler &profiler, EdgeCounts &counts) {
+    counts.assign(module.arrows.size(), {});
+    for (size_t a = 0; a < module.arrows.size(); ++a) {
+        counts[a].resize(module.arrows[a].transfers.size());
+        for (size_t t = 0; t < counts[a].size(); ++t) {
+            counts[a][t] = profiler.traversals(static_cast<int32_t>(a), static_cast<uint32_t>(t));
+        }
+    }
+}
+
+void writeEdgeCounts(const Module &module, const EdgeCounts &counts, std::ostream &out) {
+    for (size_t a = 0; a < module.arrows.size() && a < counts.size(); ++a) {
+        const Arrow &arrow = module.arrows[a];
+        for (size_t t = 0; t < arrow.transfers.size() && t < counts[a].size(); ++t) {
+            if (!counts[a][t]) continue;
+            const Transfer &transfer = arrow.transfers[t];
+            out << arrow.name << " " << t << " " << arrow.nodes[transfer.from].name << " "
+                << arrow.nodes[transfer.to].name << " " << counts[a][t] << "\n";
+        }
+    }
+}
+
+bool readEdgeCounts(const Module &module, std::istream &in, EdgeCounts &counts,
+                    std::string &error) {
+    counts.assign(module.arrows.size(), {});
+    for (size_t a = 0; a < module.arrows.size(); ++a) {
+        counts[a].resize(module.arrows[a].transfers.size());
+    }
+    std::string line;
+    for (size_t number = 1; std::getline(in, line); ++number) {
+        std::istringstream fields(line);
+        std::string block, from, to;
+        size_t transfer;
+        uint64_t count;
+        if (!(fields >> block)) continue;
+        if (!(fields >> transfer >> from >> to >> count)) {
+            error = "line " + std::to_string(number) + ": expected <block> <transfer> <from> "
+                    "<to> <count>";
+            return false;
+        }
+        int32_t a = module.findArrow(block);
+        if (a < 0) continue;
+        const Arrow &arrow = module.arrows[a];
+        if (transfer >= arrow.transfers.size()) continue;
+        const Transfer &t = arrow.transfers[transfer];
+        if (arrow.nodes[t.from].name != from || arrow.nodes[t.to].name != to) continue;
+        counts[a][transfer] += count;
+    }
+    return true;
+}
+
+size_t fuseArrowChains(Module &module, const EdgeCounts &counts, uint64_t minTraversals) {
+    size_t chains = 0;
+    std::vector<uint32_t> seen;
+    for (size_t a = 0; a < module.arrows.size() && a < counts.size(); ++a) {
+        Arrow &arrow = module.arrows[a];
+        const std::vector<uint64_t> &edges = counts[a];
+        if (edges.size() != arrow.transfers.size()) continue;
+
+        // The transfer that joins `node` to its successor in a chain, or -1.
+        auto link = [&](int32_t node) -> int64_t {
+            const ArrowNode &n = arrow.nodes[node];
+            if (!isRepr(arrow, node) || n.count != 1 || edges[n.first] < minTraversals) {
+                return -1;
+            }
+            int32_t to = arrow.transfers[n.first].to;
+            return isRepr(arrow, to) && to != node ? static_cast<int64_t>(n.first) : -1;
+        };
+
+        // A chain starts wherever a hot transfer enters from outside one.
+        seen.assign(arrow.nodes.size(), 0);
+        uint32_t mark = 0;
+        for (size_t t = 0; t < arrow.transfers.size(); ++t) {
+            const Transfer &entry = arrow.transfers[t];
+            if (edges[t] < minTraversals || !isRepr(arrow, entry.to) || link(entry.from) >= 0) {
+                continue;
+            }
+            ArrowNode &head = arrow.nodes[entry.to];
+            if (!head.fused.empty()) continue;
+            ++mark;
+            seen[entry.to] = mark;
+            int64_t hop;
+            for (int32_t at = entry.to; (hop = link(at)) >= 0;) {
+                at = arrow.transfers[hop].to;
+                if (seen[at] == mark) break;  // a cycle of single successors
+                seen[at] = mark;
+                head.fused.push_back(static_cast<uint32_t>(hop));
+            }
+            if (!head.fused.empty()) ++chains;
+        }
+    }
+    return chains;
+}
@@ -0,0 +1,192 @@
+#include "../include/ArrowGraph.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+const uint32_t kUnvisited = UINT32_MAX;
+
+void markFrom(uint32_t root, const std::vector<uint32_t> &offsets,
+              const std::vector<uint32_t> &targets, std::vector<uint8_t> &seen) {
+    std::vector<uint32_t> queue{root};
+    seen[root] = 1;
+    for (size_t head = 0; head < queue.size(); ++head) {
+        uint32_t node = queue[head];
+        for (uint32_t e = offsets[node]; e < offsets[node + 1]; ++e) {
+            if (!seen[targets[e]]) {
+                seen[targets[e]] = 1;
+                queue.push_back(targets[e]);
+            }
+        }
+    }
+}
+
+void writeNodes(const char *label, const ArrowGraph &graph, const std::vector<uint32_t> &nodes,
+                std::ostream &out) {
+    if (nodes.empty()) return;
+    out << "  " << label << ":";
+    for (uint32_t node : nodes) out << " " << graph.names[node];
+    out << "\n";
+}
+}  // namespace
+
+void buildArrowGraph(const ArrowBlock &block, ArrowGraph &graph) {
+    graph = ArrowGraph();
+    graph.name = block.name;
+    graph.names = {"start", "end"};
+    graph.symbols = {Interner::START, Interner::END};
+    // Node ids are handed out through a flat map from interned symbol;
+    // Interner::START/END already coincide with ArrowGraph::START/END.
+    std::vector<uint32_t> ids{ArrowGraph::START, ArrowGraph::END};
+    auto idOf = [&](uint32_t symbol, const std::string &name) {
+        if (symbol >= ids.size()) ids.resize(symbol + 1, kUnvisited);
+        if (ids[symbol] == kUnvisited) {
+            ids[symbol] = static_cast<uint32_t>(graph.names.size());
+            graph.names.push_back(name);
+            graph.symbols.push_back(symbol);
+        }
+        return ids[symbol];
+    };
+
+    std::vector<std::pair<uint32_t, uint32_t>> edges;
+    edges.reserve(block.edges.size());
+    for (const auto &edge : block.edges) {
+        uint32_t from = idOf(edge.fromSymbol, edge.from);
+        edges.emplace_back(from, idOf(edge.toSymbol, edge.to));
+    }
+
+    // Counting sort by source keeps declaration order within each node.
+    uint32_t nodes = graph.nodeCount();
+    graph.offsets.assign(nodes + 1, 0);
+    for (const auto &edge : edges) ++graph.offsets[edge.first + 1];
+    for (uint32_t n = 0; n < nodes; ++n) graph.offsets[n + 1] += graph.offsets[n];
+    std::vector<uint32_t> cursor(graph.offsets.begin(), graph.offsets.end() - 1);
+    graph.targets.resize(edges.size());
+    graph.declaration.resize(edges.size());
+    for (uint32_t i = 0; i < edges.size(); ++i) {
+        uint32_t slot = cursor[edges[i].first]++;
+        graph.targets[slot] = edges[i].second;
+        graph.declaration[slot] = i;
+    }
+
+    graph.payloadOffsets.assign(edges.size() + 1, 0);
+    for (uint32_t e = 0; e < edges.size(); ++e) {
+        const auto &payload = block.edges[graph.declaration[e]].payload;
+        graph.payloadOffsets[e + 1] = graph.payloadOffsets[e] + static_cast<uint32_t>(payload.size());
+    }
+    graph.payloads.reserve(graph.payloadOffsets.back());
+    for (uint32_t e = 0; e < edges.size(); ++e) {
+        const auto &payload = block.edges[graph.declaration[e]].payload;
+        graph.payloads.insert(graph.payloads.end(), payload.begin(), payload.end());
+    }
+}
+
+void analyseArrowGraph(const ArrowGraph &graph, ArrowAnalysis &analysis) {
+    uint32_t nodes = graph.nodeCount();
+    analysis = ArrowAnalysis();
+
+    analysis.reachable.assign(nodes, 0);
+    markFrom(ArrowGraph::START, graph.offsets, graph.targets, analysis.reachable);
+
+    // Reverse CSR for the backward search from `end`.
+    std::vector<uint32_t> reverseOffsets(nodes + 1, 0), sources(graph.edgeCount());
+    for (uint32_t target : graph.targets) ++reverseOffsets[target + 1];
+    for (uint32_t n = 0; n < nodes; ++n) reverseOffsets[n + 1] += reverseOffsets[n];
+    std::vector<uint32_t> cursor(reverseOffsets.begin(), reverseOffsets.end() - 1);
+    for (uint32_t n = 0; n < nodes; ++n) {
+        for (uint32_t e = graph.offsets[n]; e < graph.offsets[n + 1]; ++e) {
+            sources[cursor[graph.targets[e]]++] = n;
+        }
+    }
+    analysis.reachesEnd.assign(nodes, 0);
+    markFrom(ArrowGraph::END, reverseOffsets, sources, analysis.reachesEnd);
+
+    for (uint32_t n = 0; n < nodes; ++n) {
+        if (!analysis.reachable[n]) {
+            analysis.unreachable.push_back(n);
+        } else if (!analysis.reachesEnd[n]) {
+            analysis.deadEnds.push_back(n);
+        }
+    }
+
+    // Tarjan's algorithm with an explicit call stack. Components come out in
+    // reverse topological order of the condensation.
+    std::vector<uint32_t> index(nodes, kUnvisited), low(nodes, 0);
+    std::vector<uint8_t> onStack(nodes, 0);
+    std::vector<uint32_t> stack;
+    std::vector<std::pair<uint32_t, uint32_t>> calls;
+    analysis.component.assign(nodes, 0);
+    uint32_t counter = 0;
+    for (uint32_t root = 0; root < nodes; ++root) {
+        if (index[root] != kUnvisited) continue;
+        calls.emplace_back(root, graph.offsets[root]);
+        index[root] = low[root] = counter++;
+        stack.push_back(root);
+        onStack[root] = 1;
+        while (!calls.empty()) {
+            uint32_t node = calls.back().first;
+            uint32_t &edge = calls.back().second;
+            if (edge < graph.offsets[node + 1]) {
+                uint32_t next = graph.targets[edge++];
+                if (index[next] == kUnvisited) {
+                    index[next] = low[next] = counter++;
+                    stack.push_back(next);
+                    onStack[next] = 1;
+                    calls.emplace_back(next, graph.offsets[next]);
+                } else if (onStack[next]) {
+                    low[node] = std::min(low[node], index[next]);
+                }
+                continue;
+            }
+            if (low[node] == index[node]) {
+                uint32_t member;
+                do {
+                    member = stack.back();
+                    stack.pop_back();
+                    onStack[member] = 0;
+                    analysis.component[member] = analysis.componentCount;
+                } while (member != node);
+                ++analysis.componentCount;
+            }
+            calls.pop_back();
+            if (!calls.empty()) {
+                uint32_t parent = calls.back().first;
+                low[parent] = std::min(low[parent], low[node]);
+            }
+        }
+    }
+
+    std::vector<uint32_t> size(analysis.componentCount, 0);
+    for (uint32_t n = 0; n < nodes; ++n) ++size[analysis.component[n]];
+    analysis.cyclic.assign(nodes, 0);
+    std::vector<uint32_t> byComponent(analysis.componentCount, kUnvisited);
+    for (uint32_t n = 0; n < nodes; ++n) {
+        bool cyclic = size[analysis.component[n]] > 1;
+        for (uint32_t e = graph.offsets[n]; !cyclic && e < graph.offsets[n + 1]; ++e) {
+            cyclic = graph.targets[e] == n;
+        }
+        analysis.cyclic[n] = cyclic;
+        if (!cyclic) byComponent[analysis.component[n]] = n;
+    }
+    for (uint32_t c = analysis.componentCount; c-- > 0;) {
+        if (byComponent[c] != kUnvisited) analysis.order.push_back(byComponent[c]);
+    }
+}
+
+void writeArrowReport(const Program &program, std::ostream &out) {
+    for (const auto &block : program.arrows) {
+        ArrowGraph graph;
+        ArrowAnalysis analysis;
+        buildArrowGraph(block, graph);
+        analyseArrowGraph(graph, analysis);
+        size_t cyclic = 0;
+        for (uint8_t flag : analysis.cyclic) cyclic += flag;
+        out << "Arrow block #" << graph.name << ": " << graph.nodeCount() << " nodes, "
+            << graph.edgeCount() << " edges, " << graph.payloads.size() << " payload values, "
+            << analysis.componentCount << " components, " << cyclic << " nodes on cycles\n";
+        if (!analysis.reachesEnd[ArrowGraph::START]) out << "  end is not reachable from start\n";
+        writeNodes("unreachable", graph, analysis.unreachable, out);
+        writeNodes("cannot reach end", graph, analysis.deadEnds, out);
+        writeNodes("order", graph, analysis.order, out);
+    }
+}
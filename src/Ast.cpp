@@ -0,0 +1,613 @@
+#include "../include/Ast.h"
+#include "../include/SymbolTable.h"
+
+#include <algorithm>
+#include <cctype>
+#include <limits>
+
+namespace {
+struct SyntaxNode {
+    const Token *token;
+    uint32_t end;
+    std::pmr::vector<size_t> children;
+};
+
+std::string trim(std::string_view text) {
+    size_t begin = 0;
+    size_t end = text.size();
+    while (begin < end && std::isspace(static_cast<unsigned char>(text[begin]))) ++begin;
+    while (end > begin && std::isspace(static_cast<unsigned char>(text[end - 1]))) --end;
+    return std::string(text.substr(begin, end - begin));
+}
+
+bool operatorFromSymbol(const std::string &symbol, OPERATOR &op) {
+    static const struct {
+        const char *symbol;
+        OPERATOR op;
+    } kOperators[] = {{"||", OP_OR},     {"&&", OP_AND},  {"|", OP_BIT_OR},
+                      {"^", OP_BIT_XOR}, {"&", OP_BIT_AND}, {"==", OP_EQ},
+                      {"!=", OP_NE},     {"<=", OP_LE},   {">=", OP_GE},
+                      {"<", OP_LT},      {">", OP_GT},    {"<<", OP_SHL},
+                      {">>", OP_SHR},    {"+", OP_ADD},   {"-", OP_SUB},
+                      {"*", OP_MUL},     {"/", OP_DIV},   {"%", OP_MOD}};
+    for (const auto &entry : kOperators) {
+        if (symbol == entry.symbol) {
+            op = entry.op;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t decodeCodepoint(std::string_view text) {
+    if (text.empty()) return 0;
+    unsigned char c = static_cast<unsigned char>(text[0]);
+    if ((c & 0x80) == 0) return c;
+    if ((c & 0xE0) == 0xC0 && text.size() >= 2) {
+        return ((c & 0x1F) << 6) | (text[1] & 0x3F);
+    }
+    if ((c & 0xF0) == 0xE0 && text.size() >= 3) {
+        return ((c & 0x0F) << 12) | ((text[1] & 0x3F) << 6) | (text[2] & 0x3F);
+    }
+    if (text.size() >= 4) {
+        return ((c & 0x07) << 18) | ((text[1] & 0x3F) << 12) |
+               ((text[2] & 0x3F) << 6) | (text[3] & 0x3F);
+    }
+    return 0;
+}
+
+class TreeBuilder {
+ public:
+    TreeBuilder(const std::pmr::vector<Token> &tokens, const Interner &symbols,
+                std::string &error)
+        : tokens_(tokens),
+          error_(error),
+          nodes_(tokens.get_allocator().resource()),
+          scopes_(symbols.size()) {}
+
+    bool build(Program &program) {
+        if (!link()) return false;
+        return buildProgram(root_, program);
+    }
+
+ private:
+    // Tokens arrive in post-order, each carrying the source span of its rule,
+    // so the children of a node are exactly the preceding subtrees that lie
+    // inside its span.
+    bool link() {
+        std::pmr::memory_resource *resource = nodes_.get_allocator().resource();
+        std::pmr::vector<size_t> stack(resource);
+        nodes_.reserve(tokens_.size());
+        for (const auto &token : tokens_) {
+            SyntaxNode node{&token,
+                            static_cast<uint32_t>(token.offset + token.lexeme.size()),
+                            std::pmr::vector<size_t>(resource)};
+            while (!stack.empty()) {
+                const SyntaxNode &top = nodes_[stack.back()];
+                if (top.token->offset < token.offset || top.end > node.end) break;
+                node.children.push_back(stack.back());
+                stack.pop_back();
+            }
+            std::reverse(node.children.begin(), node.children.end());
+            nodes_.push_back(std::move(node));
+            stack.push_back(nodes_.size() - 1);
+        }
+        if (stack.size() != 1 || nodes_[stack.back()].token->type != PROGRAM) {
+            return fail(nullptr, "token stream does not form a single program");
+        }
+        root_ = stack.back();
+        return true;
+    }
+
+    bool fail(const SyntaxNode *node, const std::string &message) {
+        if (error_.empty()) {
+            if (node) {
+                error_ = std::to_string(node->token->row) + ":" +
+                         std::to_string(node->token->column) + ": " + message;
+            } else {
+                error_ = message;
+            }
+        }
+        return false;
+    }
+
+    const SyntaxNode &at(size_t index) const { return nodes_[index]; }
+    TOKEN_TYPE typeOf(size_t index) const { return nodes_[index].token->type; }
+
+    // Source text between two sibling subtrees, i.e. the operator separating them.
+    std::string gap(size_t parent, size_t left, size_t right) const {
+        const Token &p = *at(parent).token;
+        size_t begin = at(left).end - p.offset;
+        size_t end = at(right).token->offset - p.offset;
+        return trim(p.lexeme.substr(begin, end - begin));
+    }
+
+    template <typename T>
+    void place(T &target, const SyntaxNode &node) const {
+        target.row = node.token->row;
+        target.column = node.token->column;
+    }
+
+    bool buildProgram(size_t root, Program &program) {
+        for (size_t decl : at(root).children) {
+            if (typeOf(decl) != TOPLEVEL_DECL || at(decl).children.size() != 1) {
+                return fail(&at(decl), "unexpected top-level token");
+            }
+            size_t inner = at(decl).children[0];
+            if (typeOf(inner) == REPR_FUNC) {
+                program.functions.emplace_back();
+                if (!reprFunc(inner, program.functions.back())) return false;
+            } else if (typeOf(inner) == ARROW_BLOCK) {
+                program.arrows.emplace_back();
+                if (!arrowBlock(inner, program.arrows.back())) return false;
+            } else {
+                return fail(&at(inner), "unexpected top-level declaration");
+            }
+        }
+        return true;
+    }
+
+    bool type(size_t node, TypeRef &out) {
+        if (typeOf(node) == TYPE) {
+            if (at(node).children.size() != 1) return fail(&at(node), "malformed type");
+            return type(at(node).children[0], out);
+        }
+        if (typeOf(node) == PRIMITIVE_TYPE) {
+            out.arraySize = 0;
+            std::string name(at(node).token->lexeme);
+            if (!valueTypeFromName(name, out.element)) {
+                return fail(&at(node), "unknown type '" + name + "'");
+            }
+            return true;
+        }
+        if (typeOf(node) == ARRAY_TYPE && at(node).children.size() == 2) {
+            if (!type(at(node).children[0], out)) return false;
+            const Token &size = *at(at(node).children[1]).token;
+            if (size.integer <= 0 || size.integer > std::numeric_limits<uint32_t>::max()) {
+                return fail(&at(node), "invalid array size '" + std::string(size.lexeme) + "'");
+            }
+            out.arraySize = static_cast<uint32_t>(size.integer);
+            return true;
+        }
+        return fail(&at(node), "malformed type");
+    }
+
+    bool reprFunc(size_t node, ReprFunc &func) {
+        place(func, at(node));
+        scopes_.enterScope();
+        for (size_t child : at(node).children) {
+            switch (typeOf(child)) {
+                case IDENTIFIER:
+                    func.name = at(child).token->lexeme;
+                    func.symbol = at(child).token->symbol;
+                    break;
+                case PARAM_LIST:
+                    for (size_t p : at(child).children) {
+                        const auto &parts = at(p).children;
+                        if (typeOf(p) != PARAM || parts.size() != 2) {
+                            return fail(&at(p), "malformed parameter");
+                        }
+                        Param param;
+                        param.name = at(parts[0]).token->lexeme;
+                        param.symbol = at(parts[0]).token->symbol;
+                        if (!type(parts[1], param.type)) return false;
+                        scopes_.bind(param.symbol, SYMBOL_PARAM, true);
+                        func.params.push_back(std::move(param));
+                    }
+                    break;
+                case RETURN_TYPE_LIST:
+                    for (size_t t : at(child).children) {
+                        TypeRef ref;
+                        if (!type(t, ref)) return false;
+                        func.returnTypes.push_back(ref);
+                    }
+                    break;
+                case BLOCK:
+                    if (!block(child, func.body)) return false;
+                    break;
+                default: return fail(&at(child), "unexpected token in repr");
+            }
+        }
+        scopes_.leaveScope();
+        return true;
+    }
+
+    bool block(size_t node, Block &out, uint32_t loopVariable = Interner::NONE) {
+        scopes_.enterScope();
+        if (loopVariable != Interner::NONE) scopes_.bind(loopVariable, SYMBOL_LOCAL, true);
+        for (size_t child : at(node).children) {
+            StmtPtr stmt;
+            if (!statement(child, stmt)) return false;
+            out.push_back(std::move(stmt));
+        }
+        scopes_.leaveScope();
+        return true;
+    }
+
+    bool statement(size_t node, StmtPtr &out) {
+        if (typeOf(node) != STATEMENT || at(node).children.size() != 1) {
+            return fail(&at(node), "malformed statement");
+        }
+        size_t inner = at(node).children[0];
+        const auto &parts = at(inner).children;
+        out = std::make_unique<Stmt>();
+        Stmt &stmt = *out;
+        place(stmt, at(inner));
+        switch (typeOf(inner)) {
+            case VAR_DECL: {
+                stmt.name = at(parts[0]).token->lexeme;
+                stmt.symbol = at(parts[0]).token->symbol;
+                ExprPtr init;
+                for (size_t i = 1; i < parts.size(); ++i) {
+                    if (typeOf(parts[i]) == TYPE) {
+                        stmt.hasType = true;
+                        if (!type(parts[i], stmt.type)) return false;
+                    } else if (!(init = expr(parts[i]))) {
+                        return false;
+                    }
+                }
+                // `x = e` on a name already in scope is parsed by the var_decl
+                // rule as well; it is an assignment.
+                if (!stmt.hasType && scopes_.lookup(stmt.symbol)) {
+                    if (init) {
+                        stmt.kind = STMT_ASSIGN;
+                        stmt.exprs.push_back(std::move(init));
+                    } else {
+                        stmt.kind = STMT_EXPR;
+                        auto name = std::make_unique<Expr>();
+                        name->kind = EXPR_NAME;
+                        name->name = stmt.name;
+                        name->symbol = stmt.symbol;
+                        place(*name, at(parts[0]));
+                        stmt.name.clear();
+                        stmt.symbol = Interner::NONE;
+                        stmt.exprs.push_back(std::move(name));
+                    }
+                    return true;
+                }
+                stmt.kind = STMT_VAR_DECL;
+                stmt.exprs.push_back(std::move(init));
+                scopes_.bind(stmt.symbol, SYMBOL_LOCAL, true);
+                return true;
+            }
+            case ASSIGNMENT: {
+                stmt.kind = STMT_ASSIGN;
+                stmt.name = at(parts[0]).token->lexeme;
+                stmt.symbol = at(parts[0]).token->symbol;
+                ExprPtr value = expr(parts[1]);
+                if (!value) return false;
+                stmt.exprs.push_back(std::move(value));
+                return true;
+            }
+            case EXPR: {
+                stmt.kind = STMT_EXPR;
+                ExprPtr value = expr(inner);
+                if (!value) return false;
+                stmt.exprs.push_back(std::move(value));
+                return true;
+            }
+            case RETURN_STMT: {
+                stmt.kind = STMT_RETURN;
+                ExprPtr value = expr(parts[0]);
+                if (!value) return false;
+                stmt.exprs.push_back(std::move(value));
+                return true;
+            }
+            case IF_STMT:
+            case WHILE_STMT:
+            case DO_WHILE_STMT: {
+                stmt.kind = typeOf(inner) == IF_STMT      ? STMT_IF
+                            : typeOf(inner) == WHILE_STMT ? STMT_WHILE
+                                                          : STMT_DO_WHILE;
+                for (size_t part : parts) {
+                    if (typeOf(part) == BLOCK) {
+                        stmt.blocks.emplace_back();
+                        if (!block(part, stmt.blocks.back())) return false;
+                    } else {
+                        ExprPtr cond = expr(part);
+                        if (!cond) return false;
+                        stmt.exprs.push_back(std::move(cond));
+                    }
+                }
+                return true;
+            }
+            case FOR_STMT: {
+                stmt.kind = STMT_FOR;
+                if (parts.size() != 3 || typeOf(parts[1]) != RANGE) {
+                    return fail(&at(inner), "malformed for statement");
+                }
+                stmt.name = at(parts[0]).token->lexeme;
+                stmt.symbol = at(parts[0]).token->symbol;
+                const auto &bounds = at(parts[1]).children;
+                for (size_t i = 0; i < bounds.size(); ++i) {
+                    if (bounds.size() == 2 && i == 1) stmt.exprs.push_back(nullptr);
+                    ExprPtr bound = expr(bounds[i]);
+                    if (!bound) return false;
+                    stmt.exprs.push_back(std::move(bound));
+                }
+                if (stmt.exprs.size() != 3) return fail(&at(inner), "malformed range");
+                stmt.blocks.emplace_back();
+                return block(parts[2], stmt.blocks.back(), stmt.symbol);
+            }
+            default: return fail(&at(inner), "unexpected statement");
+        }
+    }
+
+    ExprPtr make(EXPR_KIND kind, size_t node) const {
+        auto e = std::make_unique<Expr>();
+        e->kind = kind;
+        place(*e, at(node));
+        return e;
+    }
+
+    // Moves the elements of a comma expression into `out` so that `f(a, b)` and
+    // `{a, b}` get one operand per element.
+    void flatten(ExprPtr value, std::vector<ExprPtr> &out) const {
+        if (value->kind == EXPR_TUPLE) {
+            for (auto &item : value->operands) out.push_back(std::move(item));
+        } else {
+            out.push_back(std::move(value));
+        }
+    }
+
+    // Every parenthesised level wraps its expression in a dozen single-child
+    // nodes (EXPR, COMMA_EXPR, LOGIC_OR ... UNARY, PRIMARY); they are skipped
+    // in a loop so deep nesting does not recurse through them.
+    size_t unwrap(size_t node) const {
+        while (at(node).children.size() == 1) {
+            size_t child = at(node).children[0];
+            switch (typeOf(node)) {
+                case UNARY:
+                    if (at(child).token->offset != at(node).token->offset) return node;
+                    break;
+                case EXPR:
+                case PRIMARY:
+                case LITERAL:
+                case COMMA_EXPR:
+                case LOGIC_OR:
+                case LOGIC_AND:
+                case BIT_OR:
+                case BIT_XOR:
+                case BIT_AND:
+                case EQUALITY:
+                case REL:
+                case SHIFT:
+                case ADD:
+                case MUL: break;
+                default: return node;
+            }
+            node = child;
+        }
+        return node;
+    }
+
+    ExprPtr expr(size_t node) {
+        node = unwrap(node);
+        const auto &parts = at(node).children;
+        switch (typeOf(node)) {
+            case EXPR:
+            case PRIMARY:
+            case LITERAL:
+                if (parts.size() != 1) break;
+                return expr(parts[0]);
+            case COMMA_EXPR: {
+                if (parts.size() == 1) return expr(parts[0]);
+                ExprPtr tuple = make(EXPR_TUPLE, node);
+                for (size_t part : parts) {
+                    ExprPtr item = expr(part);
+                    if (!item) return nullptr;
+                    tuple->operands.push_back(std::move(item));
+                }
+                return tuple;
+            }
+            case LOGIC_OR:
+            case LOGIC_AND:
+            case BIT_OR:
+            case BIT_XOR:
+            case BIT_AND:
+            case EQUALITY:
+            case REL:
+            case SHIFT:
+            case ADD:
+            case MUL: {
+                if (parts.empty()) break;
+                ExprPtr left = expr(parts[0]);
+                for (size_t i = 1; left && i < parts.size(); ++i) {
+                    ExprPtr right = expr(parts[i]);
+                    if (!right) return nullptr;
+                    ExprPtr bin = make(EXPR_BINARY, node);
+                    std::string symbol = gap(node, parts[i - 1], parts[i]);
+                    if (!operatorFromSymbol(symbol, bin->op)) {
+                        fail(&at(node), "unknown operator '" + symbol + "'");
+                        return nullptr;
+                    }
+                    bin->operands.push_back(std::move(left));
+                    bin->operands.push_back(std::move(right));
+                    left = std::move(bin);
+                }
+                return left;
+            }
+            case UNARY: {
+                if (parts.size() != 1) break;
+                ExprPtr operand = expr(parts[0]);
+                if (!operand) return nullptr;
+                const Token &t = *at(node).token;
+                std::string prefix =
+                    trim(t.lexeme.substr(0, at(parts[0]).token->offset - t.offset));
+                if (prefix.empty()) return operand;
+                ExprPtr un = make(EXPR_UNARY, node);
+                un->op = prefix == "+" ? OP_PLUS : prefix == "-" ? OP_NEG : OP_NOT;
+                un->operands.push_back(std::move(operand));
+                return un;
+            }
+            case IDENTIFIER: {
+                ExprPtr name = make(EXPR_NAME, node);
+                name->name = at(node).token->lexeme;
+                name->symbol = at(node).token->symbol;
+                return name;
+            }
+            case CALL_EXPR: {
+                if (parts.empty()) break;
+                ExprPtr call = make(EXPR_CALL, node);
+                call->name = at(parts[0]).token->lexeme;
+                call->symbol = at(parts[0]).token->symbol;
+                if (parts.size() == 2) {
+                    for (size_t arg : at(parts[1]).children) {
+                        ExprPtr value = expr(arg);
+                        if (!value) return nullptr;
+                        flatten(std::move(value), call->operands);
+                    }
+                }
+                return call;
+            }
+            case ARRAY_LITERAL: {
+                ExprPtr array = make(EXPR_ARRAY, node);
+                for (size_t part : parts) {
+                    ExprPtr value = expr(part);
+                    if (!value) return nullptr;
+                    flatten(std::move(value), array->operands);
+                }
+                return array;
+            }
+            case INTEGER_LITERAL:
+            case FLOAT_LITERAL:
+            case CHAR_LITERAL:
+            case STRING_LITERAL:
+            case BOOL_LITERAL: {
+                ExprPtr lit = make(EXPR_LITERAL, node);
+                if (!literal(node, lit->value)) return nullptr;
+                return lit;
+            }
+            default: break;
+        }
+        fail(&at(node), "malformed expression");
+        return nullptr;
+    }
+
+    bool literal(size_t node, Value &out) {
+        std::string_view text = at(node).token->lexeme;
+        switch (typeOf(node)) {
+            case INTEGER_LITERAL: {
+                int64_t v = at(node).token->integer;
+                bool small = v <= std::numeric_limits<int32_t>::max();
+                out = makeInteger(small ? VALUE_I32 : VALUE_I64, v);
+                return true;
+            }
+            case FLOAT_LITERAL: out = makeFloat(VALUE_F64, at(node).token->real); return true;
+            case CHAR_LITERAL:
+                out = makeInteger(VALUE_CHAR,
+                                  decodeCodepoint(text.substr(1, text.size() - 2)));
+                return true;
+            case STRING_LITERAL: out = makeString(std::string(text.substr(1, text.size() - 2))); return true;
+            case BOOL_LITERAL: out = makeBool(text == "true"); return true;
+            default: return fail(&at(node), "malformed literal");
+        }
+    }
+
+    bool arrowBlock(size_t node, ArrowBlock &out) {
+        place(out, at(node));
+        for (size_t child : at(node).children) {
+            if (typeOf(child) == IDENTIFIER) {
+                out.name = at(child).token->lexeme;
+                continue;
+            }
+            const auto &parts = at(child).children;
+            if (typeOf(child) != ARROW_LINE || parts.size() != 3) {
+                return fail(&at(child), "malformed arrow line");
+            }
+            ArrowEdge edge;
+            place(edge, at(child));
+            edge.from = at(parts[0]).token->lexeme;
+            edge.to = at(parts[2]).token->lexeme;
+            edge.fromSymbol = at(parts[0]).token->symbol;
+            edge.toSymbol = at(parts[2]).token->symbol;
+            for (size_t list : at(parts[1]).children) {
+                edge.hasPayload = true;
+                for (size_t item : at(list).children) {
+                    if (at(item).children.size() != 1) {
+                        return fail(&at(item), "malformed literal");
+                    }
+                    Value value;
+                    if (!literal(at(item).children[0], value)) return false;
+                    edge.payload.push_back(std::move(value));
+                }
+            }
+            out.edges.push_back(std::move(edge));
+        }
+        return true;
+    }
+
+    const std::pmr::vector<Token> &tokens_;
+    std::string &error_;
+    std::pmr::vector<SyntaxNode> nodes_;
+    size_t root_ = 0;
+    SymbolTable<bool> scopes_;
+};
+}  // namespace
+
+bool buildProgram(const std::pmr::vector<Token> &tokens, const Interner &symbols,
+                  Program &program, std::string &error) {
+    error.clear();
+    program.symbols = symbols;
+    TreeBuilder builder(tokens, symbols, error);
+    return builder.build(program);
+}
+
+bool isBinaryOperator(OPERATOR op) {
+    return op != OP_PLUS && op != OP_NEG && op != OP_NOT;
+}
+
+const char *operatorSymbol(OPERATOR op) {
+    switch (op) {
+        case OP_PLUS: return "+";
+        case OP_NEG: return "-";
+        case OP_NOT: return "!";
+        case OP_OR: return "||";
+        case OP_AND: return "&&";
+        case OP_BIT_OR: return "|";
+        case OP_BIT_XOR: return "^";
+        case OP_BIT_AND: return "&";
+        case OP_EQ: return "==";
+        case OP_NE: return "!=";
+        case OP_LT: return "<";
+        case OP_GT: return ">";
+        case OP_LE: return "<=";
+        case OP_GE: return ">=";
+        case OP_SHL: return "<<";
+        case OP_SHR: return ">>";
+        case OP_ADD: return "+";
+        case OP_SUB: return "-";
+        case OP_MUL: return "*";
+        case OP_DIV: return "/";
+        case OP_MOD: return "%";
+    }
+    return "?";
+}
+
+std::string typeRefName(const TypeRef &type) {
+    std::string name = valueTypeName(type.element);
+    if (type.arraySize) name += "[" + std::to_string(type.arraySize) + "]";
+    return name;
+}
+
+size_t countNodes(const Expr &expr) {
+    size_t count = 1;
+    for (const auto &operand : expr.operands) {
+        if (operand) count += countNodes(*operand);
+    }
+    return count;
+}
+
+size_t countNodes(const Block &block) {
+    size_t count = 0;
+    for (const auto &stmt : block) {
+        ++count;
+        for (const auto &e : stmt->exprs) {
+            if (e) count += countNodes(*e);
+        }
+        for (const auto &b : stmt->blocks) count += countNodes(b);
+    }
+    return count;
+}
+
+size_t countNodes(const ReprFunc &func) { return 1 + countNodes(func.body); }
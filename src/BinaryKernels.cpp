@@ -0,0 +1,171 @@
+#include "../include/BinaryKernels.h"
+
+#include "../include/Arithmetic.h"
+
+#include <array>
+#include <cmath>
+#include <type_traits>
+#include <utility>
+
+namespace {
+const size_t kTypes = VALUE_BOOL + 1;
+const size_t kOperators = OP_MOD - OP_OR + 1;
+
+template <VALUE_TYPE T> struct Native;
+template <> struct Native<VALUE_I8> { using type = int8_t; };
+template <> struct Native<VALUE_I16> { using type = int16_t; };
+template <> struct Native<VALUE_I32> { using type = int32_t; };
+template <> struct Native<VALUE_I64> { using type = int64_t; };
+template <> struct Native<VALUE_F32> { using type = float; };
+template <> struct Native<VALUE_F64> { using type = double; };
+template <> struct Native<VALUE_CHAR> { using type = uint32_t; };
+template <> struct Native<VALUE_BOOL> { using type = uint8_t; };
+
+template <VALUE_TYPE T>
+using NativeType = typename Native<T>::type;
+
+template <VALUE_TYPE T>
+NativeType<T> load(Slot slot) {
+    if constexpr (isFloating(T)) {
+        return static_cast<NativeType<T>>(slot.f);
+    } else {
+        return static_cast<NativeType<T>>(slot.i);
+    }
+}
+
+template <VALUE_TYPE T>
+Slot store(NativeType<T> value) {
+    Slot slot{};
+    if constexpr (isFloating(T)) {
+        slot.f = value;
+    } else if constexpr (T == VALUE_BOOL) {
+        slot.i = value != 0;
+    } else {
+        slot.i = value;
+    }
+    return slot;
+}
+
+// Widening conversion to the operand type; bool operands test truthiness.
+template <VALUE_TYPE TO, VALUE_TYPE FROM>
+NativeType<TO> promote(Slot slot) {
+    if constexpr (TO == VALUE_BOOL) {
+        return load<FROM>(slot) != 0;
+    } else {
+        return static_cast<NativeType<TO>>(load<FROM>(slot));
+    }
+}
+
+struct Typing {
+    bool valid = false;
+    VALUE_TYPE result = VALUE_I32;
+    VALUE_TYPE operand = VALUE_I32;
+};
+
+constexpr Typing typing(OPERATOR op, VALUE_TYPE lhs, VALUE_TYPE rhs) {
+    Typing t;
+    t.valid = binaryResultType(op, lhs, rhs, t.result, t.operand) &&
+              t.operand != VALUE_STRINGA;
+    return t;
+}
+
+template <OPERATOR OP, VALUE_TYPE L, VALUE_TYPE R>
+bool binaryKernel(Slot lhs, Slot rhs, Slot &out) {
+    constexpr Typing t = typing(OP, L, R);
+    constexpr VALUE_TYPE O = t.operand;
+    using T = NativeType<O>;
+    T x = promote<O, L>(lhs);
+
+    if constexpr (OP == OP_SHL || OP == OP_SHR) {
+        using U = std::common_type_t<std::make_unsigned_t<T>, unsigned>;
+        int64_t count = rhs.i & (integerBits(O) - 1);
+        if constexpr (OP == OP_SHL) {
+            out = store<O>(static_cast<T>(static_cast<U>(x) << count));
+        } else {
+            out = store<O>(static_cast<T>(x >> count));
+        }
+        return true;
+    } else {
+        T y = promote<O, R>(rhs);
+        switch (OP) {
+            case OP_OR: out = store<VALUE_BOOL>(x || y); return true;
+            case OP_AND: out = store<VALUE_BOOL>(x && y); return true;
+            case OP_EQ: out = store<VALUE_BOOL>(x == y); return true;
+            case OP_NE: out = store<VALUE_BOOL>(x != y); return true;
+            case OP_LT: out = store<VALUE_BOOL>(x < y); return true;
+            case OP_GT: out = store<VALUE_BOOL>(x > y); return true;
+            case OP_LE: out = store<VALUE_BOOL>(x <= y); return true;
+            case OP_GE: out = store<VALUE_BOOL>(x >= y); return true;
+            default: break;
+        }
+        if constexpr (std::is_floating_point_v<T>) {
+            if constexpr (OP == OP_ADD) out = store<O>(x + y);
+            if constexpr (OP == OP_SUB) out = store<O>(x - y);
+            if constexpr (OP == OP_MUL) out = store<O>(x * y);
+            if constexpr (OP == OP_DIV) out = store<O>(x / y);
+            if constexpr (OP == OP_MOD) out = store<O>(static_cast<T>(std::fmod(x, y)));
+        } else {
+            // Integer lanes are computed unsigned, at least as wide as
+            // unsigned: uint8_t and uint16_t would be promoted to int, where
+            // a product such as 65535 * 65535 overflows. The result is
+            // narrowed back, so i8/i16 still wrap at their own width.
+            using U = std::common_type_t<std::make_unsigned_t<T>, unsigned>;
+            if constexpr (OP == OP_BIT_OR) out = store<O>(static_cast<T>(x | y));
+            if constexpr (OP == OP_BIT_XOR) out = store<O>(static_cast<T>(x ^ y));
+            if constexpr (OP == OP_BIT_AND) out = store<O>(static_cast<T>(x & y));
+            if constexpr (OP == OP_ADD) out = store<O>(static_cast<T>(U(x) + U(y)));
+            if constexpr (OP == OP_SUB) out = store<O>(static_cast<T>(U(x) - U(y)));
+            if constexpr (OP == OP_MUL) out = store<O>(static_cast<T>(U(x) * U(y)));
+            if constexpr (OP == OP_DIV || OP == OP_MOD) {
+                if (y == 0) return false;
+                if (std::is_signed_v<T> && y == static_cast<T>(-1)) {
+                    out = store<O>(OP == OP_DIV ? static_cast<T>(U(0) - U(x)) : T(0));
+                } else {
+                    out = store<O>(static_cast<T>(OP == OP_DIV ? x / y : x % y));
+                }
+            }
+        }
+        return true;
+    }
+}
+
+template <OPERATOR OP>
+bool stringKernel(Slot lhs, Slot rhs, Slot &out) {
+    if constexpr (OP == OP_EQ || OP == OP_NE) {
+        out = store<VALUE_BOOL>(equalStrings(lhs, rhs) == (OP == OP_EQ));
+    } else {
+        int cmp = compareStrings(lhs, rhs);
+        if constexpr (OP == OP_LT) out = store<VALUE_BOOL>(cmp < 0);
+        if constexpr (OP == OP_GT) out = store<VALUE_BOOL>(cmp > 0);
+        if constexpr (OP == OP_LE) out = store<VALUE_BOOL>(cmp <= 0);
+        if constexpr (OP == OP_GE) out = store<VALUE_BOOL>(cmp >= 0);
+    }
+    return true;
+}
+
+template <size_t I>
+constexpr BinaryKernel entry() {
+    constexpr OPERATOR op = static_cast<OPERATOR>(OP_OR + I / (kTypes * kTypes));
+    constexpr VALUE_TYPE lhs = static_cast<VALUE_TYPE>(I / kTypes % kTypes);
+    constexpr VALUE_TYPE rhs = static_cast<VALUE_TYPE>(I % kTypes);
+    if constexpr (lhs == VALUE_STRINGA && rhs == VALUE_STRINGA && op >= OP_EQ && op <= OP_GE) {
+        return &stringKernel<op>;
+    } else if constexpr (typing(op, lhs, rhs).valid) {
+        return &binaryKernel<op, lhs, rhs>;
+    } else {
+        return nullptr;
+    }
+}
+
+template <size_t... I>
+constexpr std::array<BinaryKernel, sizeof...(I)> makeTable(std::index_sequence<I...>) {
+    return {entry<I>()...};
+}
+
+constexpr auto kKernels = makeTable(std::make_index_sequence<kOperators * kTypes * kTypes>{});
+}  // namespace
+
+BinaryKernel findBinaryKernel(OPERATOR op, VALUE_TYPE lhs, VALUE_TYPE rhs) {
+    if (op < OP_OR || op > OP_MOD) return nullptr;
+    return kKernels[(op - OP_OR) * kTypes * kTypes + lhs * kTypes + rhs];
+}
@@ -0,0 +1,294 @@
+#include "../include/Build.h"
+
+#include "../include/ArrowGraph.h"
+#include "../include/Ast.h"
+#include "../include/Compiler.h"
+#include "../include/ConstantFolder.h"
+#include "../include/Linker.h"
+#include "../include/TableParser.h"
+#include "../include/ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+struct SourceFile {
+    std::string path;
+    size_t bytes = 0, tokens = 0;
+    Program program;
+    std::vector<std::vector<std::string>> calls;  // callee names per function
+    std::vector<std::string> arrowNodes;          // repr names used by arrow blocks
+    std::vector<uint32_t> dependencies;           // files defining reprs used here
+    size_t linked = 0;                            // reprs linked in from other files
+    std::string error;
+    double parseMs = 0, passMs = 0;
+};
+
+struct Definition {
+    uint32_t file, function;
+};
+
+void collectCalls(const Expr &expr, std::vector<std::string> &out) {
+    if (expr.kind == EXPR_CALL) out.push_back(expr.name);
+    for (const auto &operand : expr.operands) {
+        if (operand) collectCalls(*operand, out);
+    }
+}
+
+void collectCalls(const Block &block, std::vector<std::string> &out) {
+    for (const auto &stmt : block) {
+        for (const auto &expr : stmt->exprs) {
+            if (expr) collectCalls(*expr, out);
+        }
+        for (const auto &body : stmt->blocks) collectCalls(body, out);
+    }
+}
+
+void parseFile(SourceFile &file) {
+    Clock::time_point start = Clock::now();
+    std::ifstream in(file.path, std::ios::binary);
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    if (!in) {
+        file.error = " cannot read file";
+        return;
+    }
+    std::string text = buffer.str();
+    file.bytes = text.size();
+    thread_local TableParser parser;
+    if (!parser.parseProgram(text)) {
+        file.error = parser.error();
+    } else if (buildProgram(parser.tokens(), parser.symbols(), file.program, file.error)) {
+        file.tokens = parser.tokens().size();
+        for (const auto &func : file.program.functions) {
+            file.calls.emplace_back();
+            collectCalls(func.body, file.calls.back());
+        }
+        for (const auto &block : file.program.arrows) {
+            for (const auto &edge : block.edges) {
+                file.arrowNodes.push_back(edge.from);
+                file.arrowNodes.push_back(edge.to);
+            }
+        }
+    }
+    file.parseMs = millisecondsSince(start);
+}
+
+class Build {
+ public:
+    Build(std::vector<SourceFile> &files, ThreadPool &pool) : files_(files), pool_(pool) {}
+
+    // The first definition in path order wins; later ones are errors.
+    void index() {
+        for (uint32_t f = 0; f < files_.size(); ++f) {
+            SourceFile &file = files_[f];
+            if (!file.error.empty()) continue;
+            for (uint32_t i = 0; i < file.program.functions.size(); ++i) {
+                const ReprFunc &func = file.program.functions[i];
+                auto inserted = definitions_.emplace(func.name, Definition{f, i});
+                const Definition &first = inserted.first->second;
+                if (!inserted.second && first.file != f && file.error.empty()) {
+                    file.error = std::to_string(func.row) + ":" + std::to_string(func.column) +
+                                 ": repr '" + func.name + "' is also defined in " +
+                                 files_[first.file].path;
+                }
+            }
+        }
+        for (uint32_t f = 0; f < files_.size(); ++f) {
+            SourceFile &file = files_[f];
+            auto depend = [&](const std::string &name) {
+                auto it = definitions_.find(name);
+                if (it != definitions_.end() && it->second.file != f) {
+                    file.dependencies.push_back(it->second.file);
+                }
+            };
+            for (const auto &calls : file.calls) {
+                for (const auto &name : calls) depend(name);
+            }
+            for (const auto &name : file.arrowNodes) depend(name);
+            std::sort(file.dependencies.begin(), file.dependencies.end());
+            file.dependencies.erase(std::unique(file.dependencies.begin(), file.dependencies.end()),
+                                    file.dependencies.end());
+        }
+    }
+
+    // Files that refer to each other in a cycle form one component; a
+    // component is scheduled once every component it depends on is done.
+    void run() {
+        // The file graph has the shape of an arrow graph; only its strongly
+        // connected components are used.
+        ArrowGraph graph;
+        graph.names.resize(files_.size());
+        graph.offsets.assign(files_.size() + 1, 0);
+        for (uint32_t f = 0; f < files_.size(); ++f) {
+            graph.offsets[f + 1] = graph.offsets[f] + static_cast<uint32_t>(files_[f].dependencies.size());
+            graph.targets.insert(graph.targets.end(), files_[f].dependencies.begin(),
+                                 files_[f].dependencies.end());
+        }
+        ArrowAnalysis analysis;
+        analyseArrowGraph(graph, analysis);
+
+        // Tarjan numbers components in reverse topological order, so every
+        // dependency of component c has a smaller id.
+        components_ = analysis.componentCount;
+        members_.assign(components_, {});
+        dependents_.assign(components_, {});
+        pending_ = std::vector<std::atomic<uint32_t>>(components_);
+        levels_.assign(components_, 0);
+        for (uint32_t f = 0; f < files_.size(); ++f) members_[analysis.component[f]].push_back(f);
+        for (uint32_t c = 0; c < components_; ++c) {
+            for (uint32_t f : members_[c]) {
+                for (uint32_t dep : files_[f].dependencies) {
+                    uint32_t d = analysis.component[dep];
+                    if (d == c) continue;
+                    dependents_[d].push_back(c);
+                    ++pending_[c];
+                    levels_[c] = std::max(levels_[c], levels_[d] + 1);
+                }
+            }
+        }
+        // Collected first: once tasks run they release dependents themselves.
+        std::vector<uint32_t> ready;
+        for (uint32_t c = 0; c < components_; ++c) {
+            if (pending_[c] == 0) ready.push_back(c);
+        }
+        for (uint32_t c : ready) pool_.submit([this, c] { component(c); });
+        pool_.wait();
+    }
+
+    uint32_t components() const { return components_; }
+
+    uint32_t levels() const {
+        return levels_.empty() ? 0 : *std::max_element(levels_.begin(), levels_.end()) + 1;
+    }
+
+ private:
+    void component(uint32_t c) {
+        for (uint32_t f : members_[c]) {
+            if (!files_[f].error.empty()) continue;
+            Clock::time_point start = Clock::now();
+            ConstantFolder(files_[f].program).run();
+            files_[f].passMs += millisecondsSince(start);
+        }
+        for (uint32_t f : members_[c]) {
+            if (files_[f].error.empty()) compile(f);
+        }
+        for (uint32_t d : dependents_[c]) {
+            if (--pending_[d] == 0) pool_.submit([this, d] { component(d); });
+        }
+    }
+
+    // Links the file with every repr it reaches in other files and compiles
+    // the result; only the file's own errors matter, the rest were reported
+    // where they are defined.
+    void compile(uint32_t f) {
+        Clock::time_point start = Clock::now();
+        SourceFile &file = files_[f];
+        Program unit;
+        Linker linker(unit);
+        std::unordered_set<std::string> included;
+        std::vector<std::string> queue;
+        for (size_t i = 0; i < file.program.functions.size(); ++i) {
+            linker.add(file.program, file.program.functions[i]);
+            included.insert(file.program.functions[i].name);
+            queue.insert(queue.end(), file.calls[i].begin(), file.calls[i].end());
+        }
+        for (const auto &block : file.program.arrows) linker.add(file.program, block);
+        queue.insert(queue.end(), file.arrowNodes.begin(), file.arrowNodes.end());
+        while (!queue.empty()) {
+            std::string name = std::move(queue.back());
+            queue.pop_back();
+            if (included.count(name)) continue;
+            auto it = definitions_.find(name);
+            if (it == definitions_.end()) continue;
+            const SourceFile &owner = files_[it->second.file];
+            linker.add(owner.program, owner.program.functions[it->second.function]);
+            included.insert(name);
+            ++file.linked;
+            const auto &calls = owner.calls[it->second.function];
+            queue.insert(queue.end(), calls.begin(), calls.end());
+        }
+        Module module;
+        Compiler compiler(unit);
+        if (!compiler.compile(module)) file.error = compiler.error();
+        file.passMs += millisecondsSince(start);
+    }
+
+    std::vector<SourceFile> &files_;
+    ThreadPool &pool_;
+    std::unordered_map<std::string, Definition> definitions_;
+    uint32_t components_ = 0;
+    std::vector<std::vector<uint32_t>> members_, dependents_;
+    std::vector<std::atomic<uint32_t>> pending_;
+    std::vector<uint32_t> levels_;
+};
+}  // namespace
+
+bool buildDirectory(const std::string &root, unsigned threads) {
+    Clock::time_point start = Clock::now();
+    std::error_code ec;
+    std::vector<std::string> paths;
+    for (std::filesystem::recursive_directory_iterator it(root, ec), end; !ec && it != end;
+         it.increment(ec)) {
+        if (it->is_regular_file(ec) && it->path().extension() == ".pfru") {
+            paths.push_back(it->path().string());
+        }
+    }
+    if (ec) {
+        std::cerr << "Cannot read " << root << ": " << ec.message() << "\n";
+        return false;
+    }
+    std::sort(paths.begin(), paths.end());
+    std::vector<SourceFile> files(paths.size());
+    for (size_t i = 0; i < paths.size(); ++i) files[i].path = paths[i];
+
+    ThreadPool pool(threads);
+    for (auto &file : files) pool.submit([&file] { parseFile(file); });
+    pool.wait();
+    double parseMs = millisecondsSince(start);
+
+    Clock::time_point passes = Clock::now();
+    Build build(files, pool);
+    build.index();
+    build.run();
+    double passMs = millisecondsSince(passes);
+
+    size_t bytes = 0, tokens = 0, failed = 0;
+    std::cout << std::fixed << std::setprecision(3);
+    for (const auto &file : files) {
+        bytes += file.bytes;
+        tokens += file.tokens;
+        std::cout << file.path << ": " << file.bytes << " bytes, " << file.tokens
+                  << " tokens, parse " << file.parseMs << " ms, passes " << file.passMs << " ms";
+        if (file.linked) std::cout << ", " << file.linked << " reprs linked";
+        std::cout << "\n";
+        if (!file.error.empty()) {
+            std::cerr << file.path << ":" << file.error << "\n";
+            ++failed;
+        }
+    }
+    double seconds = millisecondsSince(start) / 1000;
+    double parseSeconds = std::max(parseMs / 1000, 1e-9);
+    std::cout << "Built " << files.size() << " files (" << failed << " failed) on " << pool.size()
+              << " threads in " << seconds << " s\n"
+              << "  parse: " << bytes / 1e6 << " MB, " << tokens << " tokens in " << parseSeconds
+              << " s (" << bytes / 1e6 / parseSeconds << " MB/s, "
+              << tokens / 1e6 / parseSeconds << "M tokens/s)\n"
+              << "  passes: " << passMs / 1000 << " s over " << build.components()
+              << " components in " << build.levels() << " dependency levels\n";
+    return failed == 0;
+}
@@ -0,0 +1,818 @@
+#include "../include/Compiler.h"
+
+#include "../include/Arithmetic.h"
+#include "../include/ArrowGraph.h"
+#include "../include/ArrayKernels.h"
+#include "../include/BinaryKernels.h"
+#include "../include/ParallelLoops.h"
+#include "../include/Purity.h"
+
+#include <algorithm>
+
+namespace {
+bool sameType(const TypeRef &a, const TypeRef &b) {
+    return a.element == b.element && a.arraySize == b.arraySize;
+}
+
+TypeRef scalar(VALUE_TYPE type) {
+    TypeRef ref;
+    ref.element = type;
+    return ref;
+}
+}  // namespace
+
+Compiler::Compiler(const Program &program) : program_(program) {}
+
+const std::string &Compiler::error() const { return error_; }
+
+bool Compiler::compile(Module &module) {
+    error_.clear();
+    module_ = &module;
+    module.functions.clear();
+    module.functionIndex.clear();
+    module.functions.resize(program_.functions.size());
+    states_.assign(program_.functions.size(), STATE_PENDING);
+    resultsKnown_.assign(program_.functions.size(), false);
+    reprs_.assign(program_.symbols.size(), -1);
+    scopeTables_.clear();
+    depth_ = 0;
+    for (size_t i = 0; i < program_.functions.size(); ++i) {
+        const ReprFunc &src = program_.functions[i];
+        if (reprs_[src.symbol] >= 0) {
+            return fail(src.row, src.column, "repr '" + src.name + "' is defined twice");
+        }
+        reprs_[src.symbol] = static_cast<int32_t>(i);
+        module.functionIndex.emplace(src.name, static_cast<int32_t>(i));
+        module.functions[i].name = src.name;
+    }
+    for (size_t i = 0; i < program_.functions.size(); ++i) {
+        if (states_[i] == STATE_PENDING && !compileFunction(static_cast<int32_t>(i))) {
+            return false;
+        }
+    }
+    analysePurity(module);
+    analyseParallelLoops(module);
+    module.arrows.clear();
+    for (const auto &src : program_.arrows) {
+        module.arrows.emplace_back();
+        if (!compileArrow(src, module.arrows.back())) return false;
+    }
+    return true;
+}
+
+bool Compiler::compileArrow(const ArrowBlock &src, Arrow &arrow) {
+    ArrowGraph graph;
+    buildArrowGraph(src, graph);
+    arrow.name = src.name;
+    arrow.start = ArrowGraph::START;
+    arrow.end = ArrowGraph::END;
+    for (uint32_t n = 0; n < graph.nodeCount(); ++n) {
+        ArrowNode node;
+        node.name = graph.names[n];
+        node.first = graph.offsets[n];
+        node.count = graph.outDegree(n);
+        if (n != ArrowGraph::START && n != ArrowGraph::END) {
+            node.function = reprs_[graph.symbols[n]];
+        }
+        arrow.nodes.push_back(node);
+    }
+    for (uint32_t n = 0; n < graph.nodeCount(); ++n) {
+        for (uint32_t e = graph.offsets[n]; e < graph.offsets[n + 1]; ++e) {
+            const ArrowEdge &edge = src.edges[graph.declaration[e]];
+            uint32_t to = graph.targets[e];
+            for (uint32_t node : {n, to}) {
+                if (node != ArrowGraph::START && node != ArrowGraph::END &&
+                    arrow.nodes[node].function < 0) {
+                    return fail(edge.row, edge.column,
+                                "unknown repr '" + arrow.nodes[node].name + "'");
+                }
+            }
+            if (n == ArrowGraph::END) {
+                return fail(edge.row, edge.column, "'end' cannot have successors");
+            }
+            if (to == ArrowGraph::START) {
+                return fail(edge.row, edge.column, "'start' cannot be a target");
+            }
+            Transfer transfer;
+            transfer.from = static_cast<int32_t>(n);
+            transfer.to = static_cast<int32_t>(to);
+            transfer.row = edge.row;
+            transfer.column = edge.column;
+            if (!transferArgs(graph, e, arrow, transfer, arrow.args)) return false;
+            arrow.transfers.push_back(transfer);
+        }
+    }
+    return true;
+}
+
+bool Compiler::transferArgs(const ArrowGraph &graph, uint32_t edge, const Arrow &arrow,
+                            Transfer &transfer, std::vector<ArrowArg> &args) {
+    const ArrowNode &from = arrow.nodes[transfer.from];
+    const ArrowNode &to = arrow.nodes[transfer.to];
+    transfer.first = static_cast<uint32_t>(args.size());
+
+    std::vector<ArrowArg> forwarded;
+    if (from.function >= 0) {
+        const Function &fn = module_->functions[from.function];
+        size_t skip = from.count > 1 ? 1 : 0;
+        if (skip && (fn.results.empty() || fn.results[0].arraySize ||
+                     isFloating(fn.results[0].element) ||
+                     fn.results[0].element == VALUE_STRINGA)) {
+            return fail(transfer.row, transfer.column,
+                        "'" + from.name + "' has several successors, its first result "
+                                          "must be an integer selector");
+        }
+        for (size_t i = skip; i < fn.results.size(); ++i) {
+            ArrowArg arg;
+            arg.source = static_cast<int32_t>(i);
+            arg.from = fn.results[i].element;
+            arg.sourceSlot = fn.resultSlots[i];
+            arg.type = fn.results[i];
+            forwarded.push_back(arg);
+        }
+    }
+
+    std::vector<ArrowArg> payload;
+    for (uint32_t i = graph.payloadOffsets[edge]; i < graph.payloadOffsets[edge + 1]; ++i) {
+        const Value &literal = graph.payloads[i];
+        ArrowArg arg;
+        arg.value = literal;
+        arg.type.element = literal.type;
+        arg.constant = literal.type == VALUE_STRINGA ? module_->strings.intern(literal.s)
+                                                     : slotFromValue(literal);
+        payload.push_back(arg);
+    }
+
+    if (to.function >= 0) {
+        const Function &target = module_->functions[to.function];
+        size_t passed = forwarded.size() + payload.size();
+        if (payload.size() > target.params.size() ||
+            (from.function >= 0 && passed != target.params.size())) {
+            return fail(transfer.row, transfer.column, "'" + to.name + "' takes " +
+                                                   std::to_string(target.params.size()) +
+                                                   " arguments, the arrow passes " +
+                                                   std::to_string(passed));
+        }
+        size_t param = target.params.size() - forwarded.size() - payload.size();
+        for (auto &arg : forwarded) {
+            const TypeRef &type = target.params[param];
+            if (arg.type.arraySize != type.arraySize ||
+                (type.arraySize && arg.type.element != type.element)) {
+                return fail(transfer.row, transfer.column, "cannot pass " + typeRefName(arg.type) +
+                                                       " to " + typeRefName(type));
+            }
+            arg.type = type;
+            arg.slot = target.paramSlots[param++];
+        }
+        for (auto &arg : payload) {
+            const TypeRef &type = target.params[param];
+            Value converted;
+            if (type.arraySize || !convertValue(arg.value, type.element, converted)) {
+                return fail(transfer.row, transfer.column, "cannot pass " + formatValue(arg.value) +
+                                                       " to " + typeRefName(type));
+            }
+            arg.type = type;
+            arg.slot = target.paramSlots[param++];
+            arg.constant = converted.type == VALUE_STRINGA ? module_->strings.intern(converted.s)
+                                                           : slotFromValue(converted);
+        }
+    }
+
+    args.insert(args.end(), forwarded.begin(), forwarded.end());
+    args.insert(args.end(), payload.begin(), payload.end());
+    transfer.count = static_cast<uint32_t>(args.size() - transfer.first);
+    return true;
+}
+
+bool Compiler::compileFunction(int32_t index) {
+    const ReprFunc &src = program_.functions[index];
+    Function &fn = module_->functions[index];
+    states_[index] = STATE_ACTIVE;
+
+    if (depth_ == scopeTables_.size()) scopeTables_.emplace_back(program_.symbols.size());
+    Context context;
+    context.fn = &fn;
+    context.index = index;
+    context.scopes = &scopeTables_[depth_++];
+    Context *saved = ctx_;
+    ctx_ = &context;
+
+    bool ok = true;
+    context.scopes->enterScope();
+    for (const auto &param : src.params) {
+        if (param.type.element == VALUE_STRINGA && param.type.arraySize) {
+            ok = fail(src.row, src.column, "stringa arrays are not supported by the runtime yet");
+            break;
+        }
+        Local local{allocate(param.type), param.type};
+        context.scopes->bind(param.symbol, SYMBOL_PARAM, local);
+        fn.params.push_back(param.type);
+        fn.paramSlots.push_back(local.slot);
+    }
+    fn.paramSize = context.nextSlot;
+    for (const auto &type : src.returnTypes) {
+        if (ok && type.element == VALUE_STRINGA && type.arraySize) {
+            ok = fail(src.row, src.column, "stringa arrays are not supported by the runtime yet");
+        }
+    }
+    if (ok && !src.returnTypes.empty()) setResults(src.returnTypes);
+    if (ok && (fn.body = block(src.body)) >= 0) {
+        node(fn.body).row = src.row;
+        node(fn.body).column = src.column;
+    }
+    if (fn.body >= 0 && !resultsKnown_[index]) setResults({});
+
+    if (fn.body >= 0) context.scopes->leaveScope();
+    --depth_;
+    ctx_ = saved;
+    if (fn.body < 0) return false;
+    states_[index] = STATE_DONE;
+    return true;
+}
+
+bool Compiler::fail(uint32_t row, uint32_t column, const std::string &message) {
+    if (error_.empty()) {
+        error_ = std::to_string(row) + ":" + std::to_string(column) + ": " + message;
+    }
+    return false;
+}
+
+int32_t Compiler::add(const Node &node) {
+    ctx_->fn->nodes.push_back(node);
+    return static_cast<int32_t>(ctx_->fn->nodes.size() - 1);
+}
+
+int32_t Compiler::addList(const std::vector<int32_t> &items, Node &node) {
+    node.first = static_cast<uint32_t>(ctx_->fn->lists.size());
+    node.count = static_cast<uint32_t>(items.size());
+    ctx_->fn->lists.insert(ctx_->fn->lists.end(), items.begin(), items.end());
+    return add(node);
+}
+
+Node &Compiler::node(int32_t index) { return ctx_->fn->nodes[index]; }
+
+TypeRef Compiler::typeOf(int32_t index) {
+    TypeRef type;
+    type.element = node(index).type;
+    type.arraySize = node(index).length;
+    return type;
+}
+
+uint32_t Compiler::allocate(const TypeRef &type) {
+    uint32_t slot = ctx_->nextSlot;
+    ctx_->nextSlot += slotCount(type);
+    ctx_->fn->frameSlots = std::max(ctx_->fn->frameSlots, ctx_->nextSlot);
+    return slot;
+}
+
+const Compiler::Local *Compiler::lookup(uint32_t symbol) const {
+    const auto *binding = ctx_->scopes->lookup(symbol);
+    return binding ? &binding->value : nullptr;
+}
+
+void Compiler::setResults(const std::vector<TypeRef> &types) {
+    Function &fn = *ctx_->fn;
+    fn.results = types;
+    fn.resultSlots.clear();
+    fn.resultSize = 0;
+    for (const auto &type : types) {
+        fn.resultSlots.push_back(fn.resultSize);
+        fn.resultSize += slotCount(type);
+    }
+    resultsKnown_[ctx_->index] = true;
+}
+
+int32_t Compiler::block(const Block &body, uint32_t loopVariable,
+                        VALUE_TYPE loopType, uint32_t *loopSlot) {
+    ctx_->scopes->enterScope();
+    uint32_t mark = ctx_->nextSlot;
+    if (loopVariable != Interner::NONE) {
+        Local local{allocate(scalar(loopType)), scalar(loopType)};
+        ctx_->scopes->bind(loopVariable, SYMBOL_LOCAL, local);
+        *loopSlot = local.slot;
+    }
+    std::vector<int32_t> items;
+    for (const auto &stmt : body) {
+        int32_t item = statement(*stmt);
+        if (item < 0) return -1;
+        items.push_back(item);
+    }
+    ctx_->scopes->leaveScope();
+    ctx_->nextSlot = mark;
+    Node n;
+    n.kind = NODE_BLOCK;
+    return addList(items, n);
+}
+
+int32_t Compiler::statement(const Stmt &stmt) {
+    uint32_t mark = ctx_->nextSlot;
+    int32_t result = -1;
+    Node n;
+    n.row = stmt.row;
+    n.column = stmt.column;
+    switch (stmt.kind) {
+        case STMT_VAR_DECL: {
+            const Expr *init = stmt.exprs.empty() ? nullptr : stmt.exprs[0].get();
+            Local local{};
+            int32_t value = -1;
+            if (stmt.hasType) {
+                if (stmt.type.element == VALUE_STRINGA && stmt.type.arraySize) {
+                    fail(stmt.row, stmt.column, "stringa arrays are not supported by the runtime yet");
+                    return -1;
+                }
+                local = Local{allocate(stmt.type), stmt.type};
+                if (init && (value = this->value(*init, &stmt.type)) < 0) return -1;
+            } else {
+                if (!init) {
+                    fail(stmt.row, stmt.column, "'" + stmt.name + "' needs a type or an initialiser");
+                    return -1;
+                }
+                if ((value = this->value(*init)) < 0) return -1;
+                TypeRef type = typeOf(value);
+                local = Local{allocate(type), type};
+            }
+            mark = ctx_->nextSlot;
+            if (value < 0) {
+                Node zero;
+                zero.type = local.type.element;
+                zero.length = local.type.arraySize;
+                if (local.type.arraySize) {
+                    zero.kind = NODE_ARRAY_LITERAL;
+                    zero.slot = static_cast<int32_t>(local.slot);
+                }
+                value = add(zero);
+            }
+            result = store(local, value, stmt.row, stmt.column);
+            ctx_->scopes->bind(stmt.symbol, SYMBOL_LOCAL, local);
+            break;
+        }
+        case STMT_ASSIGN: {
+            const Local *found = lookup(stmt.symbol);
+            if (!found) {
+                fail(stmt.row, stmt.column, "unknown variable '" + stmt.name + "'");
+                return -1;
+            }
+            Local local = *found;
+            int32_t value = this->value(*stmt.exprs[0], &local.type);
+            if (value < 0) return -1;
+            result = store(local, value, stmt.exprs[0]->row, stmt.exprs[0]->column);
+            break;
+        }
+        case STMT_EXPR: {
+            n.kind = NODE_EVAL;
+            if ((n.a = expr(*stmt.exprs[0])) < 0) return -1;
+            n.length = node(n.a).length;
+            result = add(n);
+            break;
+        }
+        case STMT_IF: {
+            std::vector<int32_t> items;
+            for (size_t i = 0; i < stmt.exprs.size(); ++i) {
+                int32_t cond = condition(*stmt.exprs[i]);
+                if (cond < 0) return -1;
+                int32_t body = block(stmt.blocks[i]);
+                if (body < 0) return -1;
+                items.push_back(cond);
+                items.push_back(body);
+            }
+            n.kind = NODE_IF;
+            result = addList(items, n);
+            break;
+        }
+        case STMT_WHILE:
+        case STMT_DO_WHILE: {
+            n.kind = stmt.kind == STMT_WHILE ? NODE_WHILE : NODE_DO_WHILE;
+            if ((n.a = condition(*stmt.exprs[0])) < 0) return -1;
+            if ((n.b = block(stmt.blocks[0])) < 0) return -1;
+            result = add(n);
+            break;
+        }
+        case STMT_FOR: {
+            int32_t bounds[3] = {-1, -1, -1};
+            VALUE_TYPE loopType = VALUE_I32;
+            bool first = true;
+            for (int i = 0; i < 3; ++i) {
+                if (!stmt.exprs[i]) continue;
+                if ((bounds[i] = value(*stmt.exprs[i])) < 0) return -1;
+                TypeRef type = typeOf(bounds[i]);
+                VALUE_TYPE common, operand;
+                if (type.arraySize || type.element == VALUE_STRINGA ||
+                    !binaryResultType(OP_ADD, first ? type.element : loopType,
+                                      type.element, common, operand)) {
+                    fail(stmt.row, stmt.column, "range bounds must be numeric");
+                    return -1;
+                }
+                loopType = common;
+                first = false;
+            }
+            for (int i = 0; i < 3; ++i) {
+                if (bounds[i] >= 0 &&
+                    (bounds[i] = convert(bounds[i], scalar(loopType), *stmt.exprs[i])) < 0) {
+                    return -1;
+                }
+            }
+            uint32_t slot = 0;
+            n.kind = NODE_FOR;
+            n.from = loopType;
+            n.a = bounds[0];
+            n.b = bounds[1];
+            n.c = bounds[2];
+            if ((n.d = block(stmt.blocks[0], stmt.symbol, loopType, &slot)) < 0) return -1;
+            n.slot = static_cast<int32_t>(slot);
+            result = add(n);
+            break;
+        }
+        case STMT_RETURN: result = returnStmt(stmt); break;
+        case STMT_BLOCK: result = block(stmt.blocks[0]); break;
+    }
+    ctx_->nextSlot = mark;
+    return result;
+}
+
+int32_t Compiler::store(const Local &local, int32_t value, uint32_t row, uint32_t column) {
+    if ((value = convert(value, local.type, row, column)) < 0) return -1;
+    Node n;
+    n.row = row;
+    n.column = column;
+    n.slot = static_cast<int32_t>(local.slot);
+    n.type = local.type.element;
+    n.length = local.type.arraySize;
+    n.a = value;
+    if (local.type.arraySize == 0) {
+        n.kind = NODE_STORE;
+        return add(n);
+    }
+    // Element-wise results are computed straight into the destination.
+    NODE_KIND kind = node(value).kind;
+    if (kind == NODE_ARRAY_BINARY || kind == NODE_ARRAY_CONVERT || kind == NODE_ARRAY_CALL) {
+        node(value).slot = n.slot;
+    }
+    n.kind = NODE_ARRAY_STORE;
+    return add(n);
+}
+
+int32_t Compiler::returnStmt(const Stmt &stmt) {
+    const Expr &e = *stmt.exprs[0];
+    Function &fn = *ctx_->fn;
+    Node n;
+    n.kind = NODE_RETURN;
+    n.row = stmt.row;
+    n.column = stmt.column;
+
+    std::vector<const Expr *> items;
+    if (e.kind == EXPR_TUPLE) {
+        for (const auto &item : e.operands) items.push_back(item.get());
+    } else {
+        items.push_back(&e);
+    }
+
+    std::vector<int32_t> values;
+    if (e.kind == EXPR_CALL) {
+        int32_t callNode = expr(e);
+        if (callNode < 0) return -1;
+        const Function &callee = module_->functions[node(callNode).callee];
+        if (!resultsKnown_[ctx_->index]) setResults(callee.results);
+        bool same = callee.results.size() == fn.results.size();
+        for (size_t i = 0; same && i < fn.results.size(); ++i) {
+            same = sameType(callee.results[i], fn.results[i]);
+        }
+        if (same) {
+            n.c = callNode;
+            return add(n);
+        }
+        if (callee.results.size() != 1) {
+            fail(e.row, e.column, "'" + callee.name + "' results do not match the results of '" + fn.name + "'");
+            return -1;
+        }
+        values.push_back(callNode);
+    } else {
+        for (size_t i = 0; i < items.size(); ++i) {
+            const TypeRef *expected =
+                resultsKnown_[ctx_->index] && i < fn.results.size() ? &fn.results[i] : nullptr;
+            int32_t value = this->value(*items[i], expected);
+            if (value < 0) return -1;
+            values.push_back(value);
+        }
+    }
+
+    if (!resultsKnown_[ctx_->index]) {
+        std::vector<TypeRef> types;
+        for (int32_t value : values) types.push_back(typeOf(value));
+        setResults(types);
+    }
+    if (values.size() != fn.results.size()) {
+        fail(stmt.row, stmt.column, "'" + fn.name + "' returns " +
+                                        std::to_string(fn.results.size()) + " values");
+        return -1;
+    }
+    for (size_t i = 0; i < values.size(); ++i) {
+        if ((values[i] = convert(values[i], fn.results[i], *items[std::min(i, items.size() - 1)])) < 0) {
+            return -1;
+        }
+    }
+    n.slot = static_cast<int32_t>(allocate(scalar(VALUE_I64)));
+    for (uint32_t i = 1; i < fn.resultSize; ++i) allocate(scalar(VALUE_I64));
+    return addList(values, n);
+}
+
+int32_t Compiler::expr(const Expr &e, const TypeRef *expected) {
+    Node n;
+    n.row = e.row;
+    n.column = e.column;
+    switch (e.kind) {
+        case EXPR_LITERAL:
+            n.kind = NODE_CONST;
+            n.type = e.value.type;
+            n.constant = e.value.type == VALUE_STRINGA ? module_->strings.intern(e.value.s)
+                                                       : slotFromValue(e.value);
+            return add(n);
+        case EXPR_NAME: {
+            const Local *local = lookup(e.symbol);
+            if (!local) {
+                fail(e.row, e.column, "unknown variable '" + e.name + "'");
+                return -1;
+            }
+            n.kind = local->type.arraySize ? NODE_ARRAY_LOAD : NODE_LOAD;
+            n.type = local->type.element;
+            n.length = local->type.arraySize;
+            n.slot = static_cast<int32_t>(local->slot);
+            return add(n);
+        }
+        case EXPR_UNARY: return unary(e);
+        case EXPR_BINARY: return binary(e);
+        case EXPR_CALL: return call(e);
+        case EXPR_ARRAY: return arrayLiteral(e, expected);
+        case EXPR_TUPLE: break;
+    }
+    fail(e.row, e.column, "comma expressions are only allowed in return");
+    return -1;
+}
+
+int32_t Compiler::value(const Expr &e, const TypeRef *expected) {
+    int32_t index = expr(e, expected);
+    if (index < 0) return -1;
+    if (node(index).kind == NODE_CALL) {
+        const Function &callee = module_->functions[node(index).callee];
+        if (callee.results.size() != 1) {
+            fail(e.row, e.column, "'" + callee.name + "' does not return a single value");
+            return -1;
+        }
+    }
+    return index;
+}
+
+int32_t Compiler::condition(const Expr &e) {
+    int32_t index = value(e);
+    if (index < 0) return -1;
+    return convert(index, scalar(VALUE_BOOL), e);
+}
+
+int32_t Compiler::convert(int32_t index, const TypeRef &target, const Expr &where) {
+    return convert(index, target, where.row, where.column);
+}
+
+int32_t Compiler::convert(int32_t index, const TypeRef &target, uint32_t row,
+                          uint32_t column) {
+    TypeRef source = typeOf(index);
+    if (sameType(source, target)) return index;
+    if (source.arraySize != target.arraySize || source.element == VALUE_STRINGA ||
+        target.element == VALUE_STRINGA) {
+        fail(row, column, "cannot convert " + typeRefName(source) + " to " + typeRefName(target));
+        return -1;
+    }
+    Node n;
+    n.row = row;
+    n.column = column;
+    n.from = source.element;
+    n.type = target.element;
+    n.length = target.arraySize;
+    n.a = index;
+    if (target.arraySize) {
+        n.kind = NODE_ARRAY_CONVERT;
+        n.slot = static_cast<int32_t>(allocate(target));
+        return add(n);
+    }
+    if (node(index).kind == NODE_CONST) {
+        // A constant that only fits by wrapping or overflowing is almost
+        // always a typo.
+        Value value = valueFromSlot(source.element, node(index).constant);
+        if (!constantFits(value, target.element)) {
+            fail(row, column, "constant " + formatValue(value) + " is out of range for " +
+                                  valueTypeName(target.element));
+            return -1;
+        }
+        Value converted;
+        if (convertValue(value, target.element, converted)) {
+            n.kind = NODE_CONST;
+            n.constant = slotFromValue(converted);
+            n.a = -1;
+            return add(n);
+        }
+    }
+    n.kind = NODE_CONVERT;
+    return add(n);
+}
+
+int32_t Compiler::unary(const Expr &e) {
+    int32_t operand = value(*e.operands[0]);
+    if (operand < 0) return -1;
+    TypeRef type = typeOf(operand);
+    if (type.arraySize) {
+        if (e.op == OP_PLUS) return operand;
+        if (e.op == OP_NEG) {
+            Node zero;
+            zero.type = type.element;
+            int32_t lhs = add(zero);
+            return arrayBinary(e, OP_SUB, lhs, operand);
+        }
+        fail(e.row, e.column, "operator ! is not defined for arrays");
+        return -1;
+    }
+    VALUE_TYPE result;
+    if (!unaryResultType(e.op, type.element, result)) {
+        fail(e.row, e.column, std::string("operator ") + operatorSymbol(e.op) +
+                                  " is not defined for " + valueTypeName(type.element));
+        return -1;
+    }
+    Node n;
+    n.kind = NODE_UNARY;
+    n.row = e.row;
+    n.column = e.column;
+    n.op = e.op;
+    n.type = result;
+    n.from = e.op == OP_NOT ? type.element : result;
+    if ((n.a = convert(operand, scalar(n.from), e)) < 0) return -1;
+    return add(n);
+}
+
+int32_t Compiler::binary(const Expr &e) {
+    int32_t lhs = value(*e.operands[0]);
+    if (lhs < 0) return -1;
+    int32_t rhs = value(*e.operands[1]);
+    if (rhs < 0) return -1;
+    TypeRef lt = typeOf(lhs), rt = typeOf(rhs);
+    if (lt.arraySize || rt.arraySize) return arrayBinary(e, e.op, lhs, rhs);
+
+    Node n;
+    n.row = e.row;
+    n.column = e.column;
+    n.op = e.op;
+    if (!binaryResultType(e.op, lt.element, rt.element, n.type, n.from)) {
+        fail(e.row, e.column, std::string("operator ") + operatorSymbol(e.op) +
+                                  " is not defined for " + valueTypeName(lt.element) +
+                                  " and " + valueTypeName(rt.element));
+        return -1;
+    }
+    if (e.op == OP_AND || e.op == OP_OR) {
+        n.kind = e.op == OP_AND ? NODE_AND : NODE_OR;
+        if ((n.a = convert(lhs, scalar(VALUE_BOOL), e)) < 0) return -1;
+        if ((n.b = convert(rhs, scalar(VALUE_BOOL), e)) < 0) return -1;
+        return add(n);
+    }
+    if (n.type == VALUE_STRINGA) {
+        n.kind = NODE_CONCAT;
+        n.a = lhs;
+        n.b = rhs;
+        return add(n);
+    }
+    // The kernel for this exact type pair does the promotion itself.
+    n.kind = NODE_BINARY;
+    n.a = lhs;
+    n.b = rhs;
+    if (!(n.binary = findBinaryKernel(e.op, lt.element, rt.element))) {
+        fail(e.row, e.column, std::string("operator ") + operatorSymbol(e.op) +
+                                  " is not supported by the runtime for " +
+                                  valueTypeName(lt.element));
+        return -1;
+    }
+    return add(n);
+}
+
+int32_t Compiler::arrayBinary(const Expr &e, OPERATOR op, int32_t lhs, int32_t rhs) {
+    TypeRef lt = typeOf(lhs), rt = typeOf(rhs);
+    if (lt.arraySize && rt.arraySize && lt.arraySize != rt.arraySize) {
+        fail(e.row, e.column, "array lengths differ: " + typeRefName(lt) + " and " +
+                                  typeRefName(rt));
+        return -1;
+    }
+    Node n;
+    n.kind = NODE_ARRAY_BINARY;
+    n.row = e.row;
+    n.column = e.column;
+    n.op = op;
+    n.length = std::max(lt.arraySize, rt.arraySize);
+    n.broadcast = lt.arraySize == 0 ? 1 : rt.arraySize == 0 ? 2 : 0;
+    // A broadcast constant takes the array element type, so `f32[N] * 0.5`
+    // stays an f32 operation instead of widening the whole array.
+    if (n.broadcast) {
+        int32_t &scalarSide = n.broadcast == 1 ? lhs : rhs;
+        TypeRef &scalarType = n.broadcast == 1 ? lt : rt;
+        VALUE_TYPE element = n.broadcast == 1 ? rt.element : lt.element;
+        if (node(scalarSide).kind == NODE_CONST &&
+            isFloating(scalarType.element) == isFloating(element)) {
+            if ((scalarSide = convert(scalarSide, scalar(element), e)) < 0) return -1;
+            scalarType.element = element;
+        }
+    }
+    if (!binaryResultType(op, lt.element, rt.element, n.type, n.from) || n.type != n.from ||
+        !(n.kernel = findArrayKernel(op, n.from, n.broadcast))) {
+        fail(e.row, e.column, std::string("operator ") + operatorSymbol(op) +
+                                  " is not defined for " + typeRefName(lt) + " and " +
+                                  typeRefName(rt));
+        return -1;
+    }
+    TypeRef operand;
+    operand.element = n.from;
+    operand.arraySize = lt.arraySize;
+    if ((n.a = convert(lhs, operand, e)) < 0) return -1;
+    operand.arraySize = rt.arraySize;
+    if ((n.b = convert(rhs, operand, e)) < 0) return -1;
+    operand.arraySize = n.length;
+    n.slot = static_cast<int32_t>(allocate(operand));
+    return add(n);
+}
+
+int32_t Compiler::call(const Expr &e) {
+    int32_t index = reprs_[e.symbol];
+    if (index < 0) {
+        fail(e.row, e.column, "unknown repr '" + e.name + "'");
+        return -1;
+    }
+    if (states_[index] == STATE_PENDING && !compileFunction(index)) return -1;
+    if (!resultsKnown_[index]) {
+        fail(e.row, e.column, "recursive call to '" + e.name +
+                                  "' needs an explicit return type list");
+        return -1;
+    }
+    const Function &callee = module_->functions[index];
+    if (e.operands.size() != callee.params.size()) {
+        fail(e.row, e.column, "'" + e.name + "' takes " +
+                                  std::to_string(callee.params.size()) + " arguments");
+        return -1;
+    }
+    std::vector<int32_t> args;
+    for (size_t i = 0; i < e.operands.size(); ++i) {
+        int32_t arg = value(*e.operands[i], &callee.params[i]);
+        if (arg < 0 || (arg = convert(arg, callee.params[i], *e.operands[i])) < 0) return -1;
+        args.push_back(arg);
+    }
+    Node n;
+    n.kind = NODE_CALL;
+    n.row = e.row;
+    n.column = e.column;
+    n.callee = index;
+    if (callee.results.size() == 1) {
+        n.type = callee.results[0].element;
+        n.length = callee.results[0].arraySize;
+        if (n.length) {
+            n.kind = NODE_ARRAY_CALL;
+            n.slot = static_cast<int32_t>(allocate(callee.results[0]));
+        }
+    }
+    return addList(args, n);
+}
+
+int32_t Compiler::arrayLiteral(const Expr &e, const TypeRef *expected) {
+    std::vector<int32_t> items;
+    VALUE_TYPE element = VALUE_I32;
+    for (size_t i = 0; i < e.operands.size(); ++i) {
+        int32_t item = value(*e.operands[i]);
+        if (item < 0) return -1;
+        TypeRef type = typeOf(item);
+        if (type.arraySize || type.element == VALUE_STRINGA) {
+            fail(e.row, e.column, "array elements must be numeric scalars");
+            return -1;
+        }
+        VALUE_TYPE operand;
+        if (i == 0) {
+            element = type.element;
+        } else if (element != type.element &&
+                   !binaryResultType(OP_ADD, element, type.element, element, operand)) {
+            fail(e.row, e.column, "array elements have incompatible types");
+            return -1;
+        }
+        items.push_back(item);
+    }
+    if (expected && expected->arraySize) {
+        if (expected->arraySize != items.size()) {
+            fail(e.row, e.column, "expected " + std::to_string(expected->arraySize) +
+                                      " elements, got " + std::to_string(items.size()));
+            return -1;
+        }
+        element = expected->element;
+    }
+    for (size_t i = 0; i < items.size(); ++i) {
+        if ((items[i] = convert(items[i], scalar(element), *e.operands[i])) < 0) return -1;
+    }
+    Node n;
+    n.kind = NODE_ARRAY_LITERAL;
+    n.row = e.row;
+    n.column = e.column;
+    n.type = element;
+    n.length = static_cast<uint32_t>(items.size());
+    TypeRef type;
+    type.element = element;
+    type.arraySize = n.length;
+    n.slot = static_cast<int32_t>(allocate(type));
+    return addList(items, n);
+}
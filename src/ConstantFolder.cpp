@@ -0,0 +1,325 @@
+#include "../include/ConstantFolder.h"
+
+#include "../include/Arithmetic.h"
+
+namespace {
+const int kMaxIterations = 8;
+
+bool isLiteral(const ExprPtr &expr) { return expr && expr->kind == EXPR_LITERAL; }
+
+bool hasDeclarations(const Block &block) {
+    for (const auto &stmt : block) {
+        if (stmt->kind == STMT_VAR_DECL) return true;
+    }
+    return false;
+}
+}  // namespace
+
+ConstantFolder::ConstantFolder(Program &program) : program_(program) {}
+
+FoldStats ConstantFolder::run() {
+    stats_ = FoldStats();
+    uses_.assign(program_.symbols.size(), Uses());
+    touched_.clear();
+    scopes_.reset(program_.symbols.size());
+    for (auto &func : program_.functions) {
+        stats_.nodesBefore += countNodes(func);
+        foldFunction(func);
+        stats_.nodesAfter += countNodes(func);
+    }
+    return stats_;
+}
+
+void ConstantFolder::foldFunction(ReprFunc &func) {
+    for (uint32_t symbol : touched_) uses_[symbol] = Uses();
+    touched_.clear();
+    for (const auto &param : func.params) {
+        ++uses(param.symbol).declarations;
+        ++uses(param.symbol).writes;
+    }
+    countWrites(func.body);
+
+    for (int i = 0; i < kMaxIterations; ++i) {
+        changed_ = false;
+        scopes_.enterScope();
+        for (const auto &param : func.params) scopes_.bind(param.symbol, SYMBOL_PARAM, Binding());
+        foldBlock(func.body);
+        scopes_.leaveScope();
+        for (uint32_t symbol : touched_) uses_[symbol].reads = 0;
+        countReads(func.body);
+        dropDeadDeclarations(func.body);
+        if (!changed_) break;
+    }
+}
+
+void ConstantFolder::countWrites(const Block &block) {
+    for (const auto &stmt : block) {
+        if (stmt->kind == STMT_VAR_DECL) ++uses(stmt->symbol).declarations;
+        if (stmt->kind == STMT_ASSIGN) ++uses(stmt->symbol).writes;
+        if (stmt->kind == STMT_FOR) {
+            ++uses(stmt->symbol).declarations;
+            ++uses(stmt->symbol).writes;
+        }
+        for (const auto &body : stmt->blocks) countWrites(body);
+    }
+}
+
+void ConstantFolder::countReads(const Expr &expr) {
+    if (expr.kind == EXPR_NAME) ++uses(expr.symbol).reads;
+    for (const auto &operand : expr.operands) countReads(*operand);
+}
+
+void ConstantFolder::countReads(const Block &block) {
+    for (const auto &stmt : block) {
+        for (const auto &e : stmt->exprs) {
+            if (e) countReads(*e);
+        }
+        for (const auto &body : stmt->blocks) countReads(body);
+    }
+}
+
+void ConstantFolder::foldBlock(Block &block) {
+    Block out;
+    out.reserve(block.size());
+    for (auto &stmt : block) {
+        if (!out.empty() && out.back()->kind == STMT_RETURN) {
+            ++stats_.removedStatements;
+            changed_ = true;
+            continue;
+        }
+        foldStmt(stmt, out);
+    }
+    block.swap(out);
+}
+
+void ConstantFolder::foldScopedBlock(Block &block, uint32_t shadowed) {
+    scopes_.enterScope();
+    if (shadowed != Interner::NONE) scopes_.bind(shadowed, SYMBOL_LOCAL, Binding());
+    foldBlock(block);
+    scopes_.leaveScope();
+}
+
+// Appends the folded form of `stmt` to `out`; statements that turn out to be
+// dead are not appended at all, and nested blocks without declarations are
+// spliced into the enclosing one.
+void ConstantFolder::foldStmt(StmtPtr &stmt, Block &out) {
+    auto splice = [&](Block &body) {
+        changed_ = true;
+        if (hasDeclarations(body)) {
+            auto wrapper = std::make_unique<Stmt>();
+            wrapper->kind = STMT_BLOCK;
+            wrapper->row = stmt->row;
+            wrapper->column = stmt->column;
+            wrapper->blocks.push_back(std::move(body));
+            out.push_back(std::move(wrapper));
+            return;
+        }
+        for (auto &inner : body) out.push_back(std::move(inner));
+    };
+
+    switch (stmt->kind) {
+        case STMT_VAR_DECL:
+            if (stmt->exprs[0]) foldExpr(stmt->exprs[0]);
+            declare(stmt->symbol, stmt->exprs[0].get(), *stmt);
+            out.push_back(std::move(stmt));
+            return;
+        case STMT_EXPR:
+            foldExpr(stmt->exprs[0]);
+            if (stmt->exprs[0]->kind == EXPR_LITERAL || stmt->exprs[0]->kind == EXPR_NAME) {
+                ++stats_.removedStatements;
+                changed_ = true;
+                return;
+            }
+            out.push_back(std::move(stmt));
+            return;
+        case STMT_ASSIGN:
+        case STMT_RETURN:
+            foldExpr(stmt->exprs[0]);
+            out.push_back(std::move(stmt));
+            return;
+        case STMT_IF: {
+            std::vector<ExprPtr> conditions;
+            std::vector<Block> bodies;
+            for (size_t i = 0; i < stmt->exprs.size(); ++i) {
+                foldExpr(stmt->exprs[i]);
+                bool constant = isLiteral(stmt->exprs[i]);
+                if (constant && !isTruthy(stmt->exprs[i]->value)) {
+                    ++stats_.removedBranches;
+                    changed_ = true;
+                    continue;
+                }
+                foldScopedBlock(stmt->blocks[i]);
+                conditions.push_back(std::move(stmt->exprs[i]));
+                bodies.push_back(std::move(stmt->blocks[i]));
+                if (constant) {
+                    size_t rest = stmt->exprs.size() - i - 1;
+                    stats_.removedBranches += rest;
+                    changed_ = changed_ || rest > 0;
+                    break;
+                }
+            }
+            if (conditions.empty()) return;
+            if (isLiteral(conditions[0])) {
+                splice(bodies[0]);
+                return;
+            }
+            stmt->exprs.swap(conditions);
+            stmt->blocks.swap(bodies);
+            out.push_back(std::move(stmt));
+            return;
+        }
+        case STMT_WHILE:
+            foldExpr(stmt->exprs[0]);
+            if (isLiteral(stmt->exprs[0]) && !isTruthy(stmt->exprs[0]->value)) {
+                ++stats_.removedLoops;
+                changed_ = true;
+                return;
+            }
+            foldScopedBlock(stmt->blocks[0]);
+            out.push_back(std::move(stmt));
+            return;
+        case STMT_DO_WHILE:
+            foldScopedBlock(stmt->blocks[0]);
+            foldExpr(stmt->exprs[0]);
+            if (isLiteral(stmt->exprs[0]) && !isTruthy(stmt->exprs[0]->value)) {
+                ++stats_.removedLoops;
+                splice(stmt->blocks[0]);
+                return;
+            }
+            out.push_back(std::move(stmt));
+            return;
+        case STMT_FOR: {
+            bool constant = true;
+            for (auto &bound : stmt->exprs) {
+                if (!bound) continue;
+                foldExpr(bound);
+                constant = constant && isLiteral(bound) && !isFloating(bound->value.type) &&
+                           bound->value.type != VALUE_STRINGA;
+            }
+            if (constant) {
+                int64_t start = stmt->exprs[0]->value.i;
+                int64_t step = stmt->exprs[1] ? stmt->exprs[1]->value.i : 1;
+                int64_t end = stmt->exprs[2]->value.i;
+                if ((step > 0 && start >= end) || (step < 0 && start <= end)) {
+                    ++stats_.removedLoops;
+                    changed_ = true;
+                    return;
+                }
+            }
+            foldScopedBlock(stmt->blocks[0], stmt->symbol);
+            out.push_back(std::move(stmt));
+            return;
+        }
+        case STMT_BLOCK:
+            foldScopedBlock(stmt->blocks[0]);
+            if (stmt->blocks[0].empty()) {
+                changed_ = true;
+                return;
+            }
+            if (hasDeclarations(stmt->blocks[0])) {
+                out.push_back(std::move(stmt));
+                return;
+            }
+            splice(stmt->blocks[0]);
+            return;
+    }
+}
+
+void ConstantFolder::foldExpr(ExprPtr &expr) {
+    switch (expr->kind) {
+        case EXPR_LITERAL: return;
+        case EXPR_NAME: {
+            const auto *binding = scopes_.lookup(expr->symbol);
+            if (binding && binding->value.constant) {
+                replaceWithLiteral(expr, binding->value.value);
+                ++stats_.propagatedConstants;
+            }
+            return;
+        }
+        case EXPR_UNARY: {
+            foldExpr(expr->operands[0]);
+            Value result;
+            if (isLiteral(expr->operands[0]) &&
+                evalUnary(expr->op, expr->operands[0]->value, result)) {
+                replaceWithLiteral(expr, result);
+                ++stats_.foldedExpressions;
+            }
+            return;
+        }
+        case EXPR_BINARY: {
+            foldExpr(expr->operands[0]);
+            foldExpr(expr->operands[1]);
+            const ExprPtr &lhs = expr->operands[0];
+            const ExprPtr &rhs = expr->operands[1];
+            // Short-circuit operators decide on the left operand alone.
+            if ((expr->op == OP_AND || expr->op == OP_OR) && isLiteral(lhs) &&
+                lhs->value.type != VALUE_STRINGA) {
+                bool left = isTruthy(lhs->value);
+                if (left == (expr->op == OP_OR)) {
+                    replaceWithLiteral(expr, makeBool(left));
+                    ++stats_.foldedExpressions;
+                    return;
+                }
+            }
+            Value result;
+            if (isLiteral(lhs) && isLiteral(rhs) &&
+                evalBinary(expr->op, lhs->value, rhs->value, result)) {
+                replaceWithLiteral(expr, result);
+                ++stats_.foldedExpressions;
+            }
+            return;
+        }
+        default:
+            for (auto &operand : expr->operands) foldExpr(operand);
+            return;
+    }
+}
+
+ConstantFolder::Uses &ConstantFolder::uses(uint32_t symbol) {
+    Uses &entry = uses_[symbol];
+    if (!entry.declarations && !entry.writes && !entry.reads) touched_.push_back(symbol);
+    return entry;
+}
+
+void ConstantFolder::declare(uint32_t symbol, const Expr *init, const Stmt &decl) {
+    const Uses &counts = uses_[symbol];
+    Binding binding;
+    if (init && init->kind == EXPR_LITERAL && counts.declarations == 1 &&
+        counts.writes == 0 && (!decl.hasType || decl.type.arraySize == 0)) {
+        if (!decl.hasType) {
+            binding.constant = true;
+            binding.value = init->value;
+        } else if (constantFits(init->value, decl.type.element)) {
+            // A constant that does not fit is left for the compiler to report.
+            binding.constant = convertValue(init->value, decl.type.element, binding.value);
+        }
+    }
+    scopes_.bind(symbol, SYMBOL_LOCAL, binding);
+}
+
+void ConstantFolder::replaceWithLiteral(ExprPtr &expr, const Value &value) {
+    auto literal = std::make_unique<Expr>();
+    literal->kind = EXPR_LITERAL;
+    literal->row = expr->row;
+    literal->column = expr->column;
+    literal->value = value;
+    expr = std::move(literal);
+    changed_ = true;
+}
+
+void ConstantFolder::dropDeadDeclarations(Block &block) {
+    Block out;
+    out.reserve(block.size());
+    for (auto &stmt : block) {
+        for (auto &body : stmt->blocks) dropDeadDeclarations(body);
+        if (stmt->kind == STMT_VAR_DECL && uses_[stmt->symbol].declarations == 1 &&
+            uses_[stmt->symbol].writes == 0 && uses_[stmt->symbol].reads == 0 &&
+            (!stmt->exprs[0] || isLiteral(stmt->exprs[0]))) {
+            ++stats_.removedStatements;
+            changed_ = true;
+            continue;
+        }
+        out.push_back(std::move(stmt));
+    }
+    block.swap(out);
+}
@@ -0,0 +1,146 @@
+#include "../include/ExprDag.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+namespace {
+uint64_t mix(uint64_t hash, uint64_t value) {
+    return (hash ^ (value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2))) * 0xff51afd7ed558ccdull;
+}
+
+uint64_t floatBits(double f) {
+    uint64_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+// Bitwise, so 0.0 and -0.0 stay apart.
+bool identical(const Value &a, const Value &b) {
+    return a.type == b.type && a.i == b.i && floatBits(a.f) == floatBits(b.f) && a.s == b.s;
+}
+
+size_t heapBytes(const std::string &text) {
+    return text.capacity() > 15 ? text.capacity() + 1 : 0;
+}
+
+void measure(const Expr &expr, size_t &nodes, size_t &bytes) {
+    ++nodes;
+    bytes += sizeof(Expr) + expr.operands.capacity() * sizeof(ExprPtr) + heapBytes(expr.name) +
+             heapBytes(expr.value.s);
+    for (const auto &operand : expr.operands) {
+        if (operand) measure(*operand, nodes, bytes);
+    }
+}
+
+void measure(const Block &block, size_t &nodes, size_t &bytes) {
+    for (const auto &stmt : block) {
+        for (const auto &expr : stmt->exprs) {
+            if (expr) measure(*expr, nodes, bytes);
+        }
+        for (const auto &body : stmt->blocks) measure(body, nodes, bytes);
+    }
+}
+}  // namespace
+
+ExprDag::ExprDag() : table_(64, NONE), literalTable_(64, NONE) {}
+
+uint32_t ExprDag::add(const Expr &expr) {
+    // Operands first; their ids go to a local list because adding them may
+    // append operands of their own.
+    std::vector<uint32_t> ids;
+    ids.reserve(expr.operands.size());
+    for (const auto &operand : expr.operands) ids.push_back(operand ? add(*operand) : NONE);
+
+    Node node{expr.kind, OP_ADD, Interner::NONE, NONE, 0, static_cast<uint32_t>(ids.size()), 0};
+    if (expr.kind == EXPR_UNARY || expr.kind == EXPR_BINARY) node.op = expr.op;
+    if (expr.kind == EXPR_NAME || expr.kind == EXPR_CALL) node.symbol = expr.symbol;
+    if (expr.kind == EXPR_LITERAL) node.literal = literal(expr.value);
+
+    uint64_t hash = mix(mix(mix(mix(node.kind, node.op), node.symbol), node.literal), ids.size());
+    for (uint32_t id : ids) hash = mix(hash, id);
+
+    size_t mask = table_.size() - 1;
+    size_t slot = hash & mask;
+    for (;; slot = (slot + 1) & mask) {
+        uint32_t id = table_[slot];
+        if (id == NONE) break;
+        const Node &other = nodes_[id];
+        if (hashes_[id] == hash && other.kind == node.kind && other.op == node.op &&
+            other.symbol == node.symbol && other.literal == node.literal &&
+            other.count == node.count &&
+            std::equal(ids.begin(), ids.end(), operands_.begin() + other.first)) {
+            // The stored node already holds its operands.
+            for (uint32_t operand : ids) {
+                if (operand != NONE) --nodes_[operand].uses;
+            }
+            ++nodes_[id].uses;
+            return id;
+        }
+    }
+    uint32_t id = static_cast<uint32_t>(nodes_.size());
+    node.first = static_cast<uint32_t>(operands_.size());
+    node.uses = 1;
+    operands_.insert(operands_.end(), ids.begin(), ids.end());
+    nodes_.push_back(node);
+    hashes_.push_back(hash);
+    table_[slot] = id;
+    if (nodes_.size() * 2 > table_.size()) grow(table_, hashes_);
+    return id;
+}
+
+void ExprDag::add(const Program &program) {
+    for (const auto &func : program.functions) addBlock(func.body);
+}
+
+void ExprDag::addBlock(const Block &block) {
+    for (const auto &stmt : block) {
+        for (const auto &expr : stmt->exprs) roots_.push_back(expr ? add(*expr) : NONE);
+        for (const auto &body : stmt->blocks) addBlock(body);
+    }
+}
+
+size_t ExprDag::bytes() const {
+    size_t total = nodes_.capacity() * sizeof(Node) + hashes_.capacity() * sizeof(uint64_t) +
+                   (table_.capacity() + operands_.capacity() + literalTable_.capacity() +
+                    roots_.capacity()) * sizeof(uint32_t) +
+                   literals_.capacity() * sizeof(Value) +
+                   literalHashes_.capacity() * sizeof(uint64_t);
+    for (const auto &value : literals_) total += heapBytes(value.s);
+    return total;
+}
+
+uint32_t ExprDag::literal(const Value &value) {
+    uint64_t hash = mix(mix(mix(value.type, static_cast<uint64_t>(value.i)), floatBits(value.f)),
+                        std::hash<std::string>()(value.s));
+    size_t mask = literalTable_.size() - 1;
+    size_t slot = hash & mask;
+    for (;; slot = (slot + 1) & mask) {
+        uint32_t id = literalTable_[slot];
+        if (id == NONE) break;
+        if (literalHashes_[id] == hash && identical(literals_[id], value)) return id;
+    }
+    uint32_t id = static_cast<uint32_t>(literals_.size());
+    literals_.push_back(value);
+    literalHashes_.push_back(hash);
+    literalTable_[slot] = id;
+    if (literals_.size() * 2 > literalTable_.size()) grow(literalTable_, literalHashes_);
+    return id;
+}
+
+void ExprDag::grow(std::vector<uint32_t> &table, const std::vector<uint64_t> &hashes) {
+    std::vector<uint32_t> bigger(table.size() * 2, NONE);
+    size_t mask = bigger.size() - 1;
+    for (uint32_t id = 0; id < hashes.size(); ++id) {
+        size_t slot = hashes[id] & mask;
+        while (bigger[slot] != NONE) slot = (slot + 1) & mask;
+        bigger[slot] = id;
+    }
+    table.swap(bigger);
+}
+
+void measureExpressionTrees(const Program &program, size_t &nodes, size_t &bytes) {
+    nodes = 0;
+    bytes = 0;
+    for (const auto &func : program.functions) measure(func.body, nodes, bytes);
+}
@@ -0,0 +1,803 @@
+// Build-time generator for TableParser: reads the BNF blocks of Пфру.tex and
+// writes strong LL(2) prediction tables as a C++ header.
+//
+//   pfru_grammar <grammar.tex> <output.h>
+//
+// Character-level rules (the ones built from ranges, escapes or ?...?) are
+// recognised by TableParser's scanner; every other rule becomes a parser
+// nonterminal that emits the TOKEN_TYPE of the same name. Where two
+// alternatives share a lookahead the earlier one wins, and the conflict is
+// reported on stdout and in the generated header.
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+const size_t kLookahead = 2;
+const int kEnd = 0;
+
+// Lexical rules the scanner implements, in terminal order after end of input.
+const std::vector<std::string> kScannedRules = {"identifier", "integer_literal",
+                                                "float_literal", "char_literal",
+                                                "string_literal"};
+
+enum ITEM_KIND { ITEM_TERMINAL, ITEM_RULE, ITEM_OPTIONAL, ITEM_REPEAT, ITEM_GROUP, ITEM_CHARACTERS };
+
+struct Item;
+using Sequence = std::vector<Item>;
+using Choice = std::vector<Sequence>;
+
+struct Item {
+    ITEM_KIND kind = ITEM_TERMINAL;
+    std::string text;  // terminal spelling or rule name
+    Choice body;       // OPTIONAL, REPEAT, GROUP
+};
+
+struct Definition {
+    std::string name;
+    Choice body;
+};
+
+enum EBNF_TOKEN { EBNF_NAME, EBNF_DEFINE, EBNF_BAR, EBNF_OPEN, EBNF_CLOSE, EBNF_STRING, EBNF_CHARACTERS };
+
+struct EbnfToken {
+    EBNF_TOKEN kind;
+    std::string text;  // name, spelling, or the bracket character
+};
+
+struct Symbol {
+    int id;       // terminal id, or kRuleBase + rule
+    bool glued;   // terminal must follow the previous one without whitespace
+};
+
+const int kRuleBase = 0x4000;
+
+struct Production {
+    int lhs;
+    std::vector<Symbol> rhs;
+};
+
+using Lookahead = std::vector<int>;
+using LookaheadSet = std::set<Lookahead>;
+
+struct Grammar {
+    std::vector<std::string> terminals;  // kEnd, scanned rules, then spellings
+    std::vector<bool> keyword;
+    std::vector<std::string> rules;      // declared rules first, then helpers
+    std::vector<std::string> display;    // EBNF text of helpers, name of rules
+    std::vector<bool> emits;
+    std::vector<Production> productions;  // grouped by lhs, in declaration order
+    std::vector<std::vector<int>> byRule;
+    int start = -1;
+};
+
+bool failWith(const std::string &message) {
+    std::cerr << "pfru_grammar: " << message << "\n";
+    return false;
+}
+
+void replaceAll(std::string &text, const std::string &from, const std::string &to) {
+    for (size_t at = text.find(from); at != std::string::npos; at = text.find(from, at + to.size())) {
+        text.replace(at, from.size(), to);
+    }
+}
+
+// The grammar lives in the alltt blocks. LaTeX escapes are undone; braces that
+// alltt would treat as groups are repetitions as well.
+std::string grammarText(const std::string &tex) {
+    std::string out;
+    const std::string open = "\\begin{alltt}", close = "\\end{alltt}";
+    for (size_t at = tex.find(open); at != std::string::npos; at = tex.find(open, at)) {
+        at += open.size();
+        size_t end = tex.find(close, at);
+        if (end == std::string::npos) break;
+        out += tex.substr(at, end - at) + "\n";
+        at = end + close.size();
+    }
+    replaceAll(out, "\\textbackslash{", "\\");
+    replaceAll(out, "\\{", "{");
+    replaceAll(out, "\\}", "}");
+    replaceAll(out, "\\#", "#");
+    return out;
+}
+
+bool tokenize(const std::string &text, std::vector<EbnfToken> &out) {
+    size_t i = 0;
+    auto readString = [&](std::string &value) {
+        // `"""` is the quote character itself.
+        if (text.compare(i, 3, "\"\"\"") == 0) {
+            value = "\"";
+            i += 3;
+            return true;
+        }
+        size_t end = text.find('"', i + 1);
+        if (end == std::string::npos) return false;
+        value = text.substr(i + 1, end - i - 1);
+        i = end + 1;
+        return true;
+    };
+    while (i < text.size()) {
+        char c = text[i];
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            ++i;
+        } else if (c == '<') {
+            size_t end = text.find('>', i);
+            if (end == std::string::npos) return failWith("unterminated rule name");
+            out.push_back({EBNF_NAME, text.substr(i + 1, end - i - 1)});
+            i = end + 1;
+        } else if (text.compare(i, 2, ":=") == 0) {
+            out.push_back({EBNF_DEFINE, ":="});
+            i += 2;
+        } else if (c == '|') {
+            out.push_back({EBNF_BAR, "|"});
+            ++i;
+        } else if (c == '[' || c == '{' || c == '(') {
+            out.push_back({EBNF_OPEN, std::string(1, c)});
+            ++i;
+        } else if (c == ']' || c == '}' || c == ')') {
+            out.push_back({EBNF_CLOSE, std::string(1, c)});
+            ++i;
+        } else if (c == '"') {
+            std::string value;
+            if (!readString(value)) return failWith("unterminated string");
+            size_t after = text.find_first_not_of(" \t", i);
+            if (after != std::string::npos && text.compare(after, 3, "...") == 0) {
+                i = text.find('"', after);
+                std::string last;
+                if (i == std::string::npos || !readString(last)) return failWith("malformed range");
+                out.push_back({EBNF_CHARACTERS, value + "..." + last});
+            } else {
+                out.push_back({EBNF_STRING, value});
+            }
+        } else if (c == '?') {
+            size_t end = text.find('?', i + 1);
+            if (end == std::string::npos) return failWith("unterminated ?...?");
+            out.push_back({EBNF_CHARACTERS, text.substr(i, end - i + 1)});
+            i = end + 1;
+        } else if (c == '\\') {
+            size_t end = text.find('}', i);
+            if (end == std::string::npos) return failWith("malformed escape");
+            out.push_back({EBNF_CHARACTERS, text.substr(i, end - i)});
+            i = end + 1;
+        } else {
+            return failWith(std::string("unexpected character '") + c + "' in grammar");
+        }
+    }
+    return true;
+}
+
+class EbnfParser {
+ public:
+    explicit EbnfParser(const std::vector<EbnfToken> &tokens) : tokens_(tokens) {}
+
+    bool parse(std::vector<Definition> &out) {
+        while (pos_ < tokens_.size()) {
+            if (!startsDefinition(pos_)) {
+                return failWith("expected a rule definition near '" + tokens_[pos_].text + "'");
+            }
+            Definition def;
+            def.name = tokens_[pos_].text;
+            pos_ += 2;
+            if (!choice(def.body)) return false;
+            if (pos_ < tokens_.size() && !startsDefinition(pos_)) {
+                return failWith("unexpected '" + tokens_[pos_].text + "' in <" + def.name + ">");
+            }
+            out.push_back(std::move(def));
+        }
+        return true;
+    }
+
+ private:
+    bool startsDefinition(size_t at) const {
+        return at + 1 < tokens_.size() && tokens_[at].kind == EBNF_NAME &&
+               tokens_[at + 1].kind == EBNF_DEFINE;
+    }
+
+    bool choice(Choice &out) {
+        out.emplace_back();
+        if (!sequence(out.back())) return false;
+        while (pos_ < tokens_.size() && tokens_[pos_].kind == EBNF_BAR) {
+            ++pos_;
+            out.emplace_back();
+            if (!sequence(out.back())) return false;
+        }
+        return true;
+    }
+
+    bool sequence(Sequence &out) {
+        while (pos_ < tokens_.size() && !startsDefinition(pos_)) {
+            const EbnfToken &token = tokens_[pos_];
+            if (token.kind == EBNF_BAR || token.kind == EBNF_CLOSE) break;
+            ++pos_;
+            Item item;
+            item.text = token.text;
+            switch (token.kind) {
+                case EBNF_NAME: item.kind = ITEM_RULE; break;
+                case EBNF_STRING: item.kind = ITEM_TERMINAL; break;
+                case EBNF_CHARACTERS: item.kind = ITEM_CHARACTERS; break;
+                case EBNF_OPEN: {
+                    const char close = token.text == "[" ? ']' : token.text == "{" ? '}' : ')';
+                    item.kind = close == ']' ? ITEM_OPTIONAL : close == '}' ? ITEM_REPEAT : ITEM_GROUP;
+                    if (!choice(item.body)) return false;
+                    if (pos_ >= tokens_.size() || tokens_[pos_].text != std::string(1, close)) {
+                        return failWith(std::string("missing '") + close + "'");
+                    }
+                    ++pos_;
+                    break;
+                }
+                default: return failWith("unexpected '" + token.text + "'");
+            }
+            out.push_back(std::move(item));
+        }
+        return true;
+    }
+
+    const std::vector<EbnfToken> &tokens_;
+    size_t pos_ = 0;
+};
+
+bool mentions(const Choice &choice, ITEM_KIND kind, const std::set<std::string> *rules = nullptr) {
+    for (const auto &seq : choice) {
+        for (const auto &item : seq) {
+            if (item.kind == kind && (!rules || rules->count(item.text))) return true;
+            if (!item.body.empty() && mentions(item.body, kind, rules)) return true;
+        }
+    }
+    return false;
+}
+
+std::string trim(const std::string &text) {
+    size_t begin = text.find_first_not_of(" \t");
+    if (begin == std::string::npos) return "";
+    return text.substr(begin, text.find_last_not_of(" \t") - begin + 1);
+}
+
+bool isWord(const std::string &text) {
+    for (char c : text) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_') return false;
+    }
+    return !text.empty();
+}
+
+std::string quoted(const std::string &text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+std::string describe(const Choice &choice);
+
+std::string describe(const Sequence &seq) {
+    std::string out;
+    for (const auto &item : seq) {
+        if (!out.empty()) out += " ";
+        switch (item.kind) {
+            case ITEM_TERMINAL: out += quoted(trim(item.text)); break;
+            case ITEM_RULE: out += item.text; break;
+            case ITEM_OPTIONAL: out += "[" + describe(item.body) + "]"; break;
+            case ITEM_REPEAT: out += "{" + describe(item.body) + "}"; break;
+            case ITEM_GROUP: out += "(" + describe(item.body) + ")"; break;
+            case ITEM_CHARACTERS: out += item.text; break;
+        }
+    }
+    return out;
+}
+
+std::string describe(const Choice &choice) {
+    std::string out;
+    for (const auto &seq : choice) out += (out.empty() ? "" : " | ") + describe(seq);
+    return out;
+}
+
+
+// Lowers the syntactic rules to BNF. `splits` maps a composite spelling to the
+// two terminals it is matched as, the second one glued to the first.
+class Lowering {
+ public:
+    Lowering(const std::vector<Definition> &defs, const std::set<std::string> &lexical,
+             const std::map<std::string, std::pair<std::string, std::string>> &splits,
+             Grammar &g)
+        : defs_(defs), lexical_(lexical), splits_(splits), g_(g) {}
+
+    bool run() {
+        g_.terminals = {"end of input"};
+        for (const auto &name : kScannedRules) g_.terminals.push_back(name);
+        g_.keyword.assign(g_.terminals.size(), false);
+        std::set<std::string> referenced;
+        for (const auto &def : defs_) {
+            if (lexical_.count(def.name)) continue;
+            ruleIds_[def.name] = static_cast<int>(g_.rules.size());
+            g_.rules.push_back(def.name);
+            g_.display.push_back(def.name);
+            g_.emits.push_back(true);
+        }
+        for (const auto &def : defs_) {
+            if (lexical_.count(def.name)) continue;
+            if (!alternatives(ruleIds_[def.name], def.name, def.body, false)) return false;
+        }
+        g_.byRule.assign(g_.rules.size(), {});
+        std::stable_sort(g_.productions.begin(), g_.productions.end(),
+                         [](const Production &a, const Production &b) { return a.lhs < b.lhs; });
+        std::vector<bool> used(g_.rules.size(), false);
+        for (size_t p = 0; p < g_.productions.size(); ++p) {
+            g_.byRule[g_.productions[p].lhs].push_back(static_cast<int>(p));
+            for (const auto &symbol : g_.productions[p].rhs) {
+                if (symbol.id >= kRuleBase) used[symbol.id - kRuleBase] = true;
+            }
+        }
+        // The start rule is the one syntactic rule nothing refers to.
+        for (size_t r = 0; r < g_.rules.size(); ++r) {
+            if (used[r]) continue;
+            if (g_.start >= 0) return failWith("both <" + g_.rules[g_.start] + "> and <" + g_.rules[r] + "> are unused");
+            g_.start = static_cast<int>(r);
+        }
+        return g_.start >= 0 || failWith("no start rule");
+    }
+
+ private:
+    bool alternatives(int lhs, const std::string &owner, const Choice &choice, bool repeat) {
+        for (const auto &seq : choice) {
+            Production production{lhs, {}};
+            if (!lower(seq, owner, production.rhs)) return false;
+            if (repeat) production.rhs.push_back({kRuleBase + lhs, false});
+            g_.productions.push_back(std::move(production));
+        }
+        return true;
+    }
+
+    int terminal(const std::string &text) {
+        for (size_t t = kScannedRules.size() + 1; t < g_.terminals.size(); ++t) {
+            if (g_.terminals[t] == text) return static_cast<int>(t);
+        }
+        g_.terminals.push_back(text);
+        g_.keyword.push_back(isWord(text));
+        return static_cast<int>(g_.terminals.size() - 1);
+    }
+
+    bool lower(const Sequence &seq, const std::string &owner, std::vector<Symbol> &rhs) {
+        for (const auto &item : seq) {
+            switch (item.kind) {
+                case ITEM_TERMINAL: {
+                    std::string text = trim(item.text);
+                    if (text.empty()) return failWith("empty terminal in <" + owner + ">");
+                    auto split = splits_.find(text);
+                    if (split == splits_.end()) {
+                        rhs.push_back({terminal(text), false});
+                    } else {
+                        rhs.push_back({terminal(split->second.first), false});
+                        rhs.push_back({terminal(split->second.second), true});
+                    }
+                    break;
+                }
+                case ITEM_RULE: {
+                    auto scanned = std::find(kScannedRules.begin(), kScannedRules.end(), item.text);
+                    if (scanned != kScannedRules.end()) {
+                        rhs.push_back({static_cast<int>(scanned - kScannedRules.begin()) + 1, false});
+                    } else if (lexical_.count(item.text)) {
+                        return failWith("the scanner has no token for <" + item.text + ">");
+                    } else if (!ruleIds_.count(item.text)) {
+                        return failWith("undefined rule <" + item.text + "> in <" + owner + ">");
+                    } else {
+                        rhs.push_back({kRuleBase + ruleIds_[item.text], false});
+                    }
+                    break;
+                }
+                case ITEM_OPTIONAL:
+                case ITEM_REPEAT:
+                case ITEM_GROUP: {
+                    // Helpers carry their owner's name so errors point at a real rule.
+                    int helper = static_cast<int>(g_.rules.size());
+                    g_.rules.push_back(owner);
+                    g_.display.push_back(describe(Sequence{item}));
+                    g_.emits.push_back(false);
+                    if (!alternatives(helper, owner, item.body, item.kind == ITEM_REPEAT)) return false;
+                    if (item.kind != ITEM_GROUP) g_.productions.push_back({helper, {}});
+                    rhs.push_back({kRuleBase + helper, false});
+                    break;
+                }
+                case ITEM_CHARACTERS:
+                    return failWith("character class " + item.text + " in <" + owner + ">");
+            }
+        }
+        return true;
+    }
+
+    const std::vector<Definition> &defs_;
+    const std::set<std::string> &lexical_;
+    const std::map<std::string, std::pair<std::string, std::string>> &splits_;
+    Grammar &g_;
+    std::map<std::string, int> ruleIds_;
+};
+
+bool complete(const Lookahead &word) {
+    return word.size() == kLookahead || (!word.empty() && word.back() == kEnd);
+}
+
+LookaheadSet concat(const LookaheadSet &left, const LookaheadSet &right) {
+    LookaheadSet out;
+    for (const auto &a : left) {
+        if (complete(a)) {
+            out.insert(a);
+            continue;
+        }
+        for (const auto &b : right) {
+            Lookahead word = a;
+            for (size_t i = 0; i < b.size() && word.size() < kLookahead; ++i) word.push_back(b[i]);
+            out.insert(word);
+        }
+    }
+    return out;
+}
+
+// FIRST_k and FOLLOW_k by fixed-point iteration over the BNF.
+struct Analysis {
+    std::vector<LookaheadSet> first, follow;
+    std::vector<LookaheadSet> predict;  // per production
+
+    LookaheadSet firstOf(const std::vector<Symbol> &rhs, size_t from) const {
+        LookaheadSet out{Lookahead{}};
+        for (size_t i = from; i < rhs.size(); ++i) {
+            if (rhs[i].id < kRuleBase) {
+                out = concat(out, LookaheadSet{Lookahead{rhs[i].id}});
+            } else {
+                out = concat(out, first[rhs[i].id - kRuleBase]);
+            }
+            if (std::all_of(out.begin(), out.end(), complete)) break;
+        }
+        return out;
+    }
+
+    void run(const Grammar &g) {
+        first.assign(g.rules.size(), {});
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (const auto &production : g.productions) {
+                for (const auto &word : firstOf(production.rhs, 0)) {
+                    changed |= first[production.lhs].insert(word).second;
+                }
+            }
+        }
+        follow.assign(g.rules.size(), {});
+        follow[g.start].insert(Lookahead{kEnd});
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (const auto &production : g.productions) {
+                for (size_t i = 0; i < production.rhs.size(); ++i) {
+                    if (production.rhs[i].id < kRuleBase) continue;
+                    LookaheadSet after = concat(firstOf(production.rhs, i + 1), follow[production.lhs]);
+                    for (const auto &word : after) {
+                        changed |= follow[production.rhs[i].id - kRuleBase].insert(word).second;
+                    }
+                }
+            }
+        }
+        predict.clear();
+        for (const auto &production : g.productions) {
+            predict.push_back(concat(firstOf(production.rhs, 0), follow[production.lhs]));
+        }
+    }
+
+    // Terminals that may directly follow an occurrence of `terminal`.
+    std::set<int> successors(const Grammar &g, int terminal) const {
+        std::set<int> out;
+        for (const auto &production : g.productions) {
+            for (size_t i = 0; i < production.rhs.size(); ++i) {
+                if (production.rhs[i].id != terminal) continue;
+                for (const auto &word : concat(firstOf(production.rhs, i + 1), follow[production.lhs])) {
+                    if (!word.empty()) out.insert(word[0]);
+                }
+            }
+        }
+        return out;
+    }
+};
+
+std::string terminalName(const Grammar &g, int t) {
+    if (t == kEnd) return "end of input";
+    if (t <= static_cast<int>(kScannedRules.size())) return g.terminals[t];
+    return quoted(g.terminals[t]);
+}
+
+std::string productionText(const Grammar &g, const Production &production) {
+    std::string out;
+    for (const auto &symbol : production.rhs) {
+        if (!out.empty()) out += " ";
+        if (symbol.id >= kRuleBase) {
+            out += g.display[symbol.id - kRuleBase];
+        } else {
+            out += terminalName(g, symbol.id);
+        }
+    }
+    return out.empty() ? "<empty>" : out;
+}
+
+struct Tables {
+    std::vector<std::vector<int>> predict;   // rule x terminal
+    std::vector<std::vector<int>> predict2;  // row x terminal
+    std::vector<std::string> conflicts;
+};
+
+const int kError = -1;
+
+int secondRow(int row) { return -2 - row; }
+
+void buildTables(const Grammar &g, const Analysis &a, Tables &tables) {
+    const size_t terminals = g.terminals.size();
+    tables.predict.assign(g.rules.size(), std::vector<int>(terminals, kError));
+    for (size_t rule = 0; rule < g.rules.size(); ++rule) {
+        // Conflicting lookaheads, grouped by the alternatives they predict.
+        std::map<std::vector<int>, std::vector<std::string>> clashes;
+        for (size_t t1 = 0; t1 < terminals; ++t1) {
+            std::vector<int> candidates;
+            for (int p : g.byRule[rule]) {
+                for (const auto &word : a.predict[p]) {
+                    if (word[0] == static_cast<int>(t1)) {
+                        candidates.push_back(p);
+                        break;
+                    }
+                }
+            }
+            if (candidates.size() <= 1) {
+                if (!candidates.empty()) tables.predict[rule][t1] = candidates[0];
+                continue;
+            }
+            std::vector<int> row(terminals, kError);
+            for (size_t t2 = 0; t2 < terminals; ++t2) {
+                std::vector<int> chosen;
+                for (int p : candidates) {
+                    for (const auto &word : a.predict[p]) {
+                        if (word[0] == static_cast<int>(t1) &&
+                            (word.size() == 1 || word[1] == static_cast<int>(t2))) {
+                            chosen.push_back(p);
+                            break;
+                        }
+                    }
+                }
+                if (chosen.empty()) continue;
+                row[t2] = chosen[0];
+                if (chosen.size() > 1) {
+                    std::string where = terminalName(g, static_cast<int>(t1));
+                    if (t1 != kEnd) where += " " + terminalName(g, static_cast<int>(t2));
+                    clashes[chosen].push_back(where);
+                }
+            }
+            // One production behind every non-error entry needs no second token.
+            int only = kError;
+            bool single = true;
+            for (int p : row) {
+                if (p == kError) continue;
+                if (only != kError && p != only) single = false;
+                only = p;
+            }
+            if (single) {
+                tables.predict[rule][t1] = only;
+            } else {
+                tables.predict[rule][t1] = secondRow(static_cast<int>(tables.predict2.size()));
+                tables.predict2.push_back(std::move(row));
+            }
+        }
+        for (const auto &clash : clashes) {
+            std::string text = g.rules[rule] + (g.emits[rule] ? "" : " " + g.display[rule]) + ": ";
+            for (size_t i = 0; i < clash.first.size(); ++i) {
+                text += (i ? " / " : "") + productionText(g, g.productions[clash.first[i]]);
+            }
+            text += " on " + clash.second[0];
+            if (clash.second.size() > 1) text += " and " + std::to_string(clash.second.size() - 1) + " more";
+            tables.conflicts.push_back(text);
+        }
+    }
+}
+
+std::string upper(const std::string &name) {
+    std::string out = name;
+    for (char &c : out) c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    return out;
+}
+
+template <typename Row>
+void writeRow(std::ostream &out, const Row &row) {
+    out << "    {";
+    for (size_t i = 0; i < row.size(); ++i) out << (i ? ", " : "") << row[i];
+    out << "},\n";
+}
+
+void writeHeader(std::ostream &out, const Grammar &g, const Tables &tables) {
+    out << "// Generated by pfru_grammar from the BNF in Пфру.tex. Do not edit.\n";
+    out << "//\n";
+    if (tables.conflicts.empty()) {
+        out << "// The grammar is LL(" << kLookahead << ").\n";
+    } else {
+        out << "// LL(" << kLookahead << ") conflicts, resolved in favour of the earlier alternative:\n";
+        for (const auto &conflict : tables.conflicts) out << "//   " << conflict << "\n";
+    }
+    out << "#pragma once\n\n#include \"Token.h\"\n\n#include <cstdint>\n\nnamespace grammar {\n";
+    out << "constexpr uint16_t kEnd = 0;\n";
+    for (size_t i = 0; i < kScannedRules.size(); ++i) {
+        std::string constant = "k";
+        bool capital = true;
+        for (char c : kScannedRules[i]) {
+            if (c == '_') {
+                capital = true;
+                continue;
+            }
+            constant += capital ? static_cast<char>(std::toupper(static_cast<unsigned char>(c))) : c;
+            capital = false;
+        }
+        out << "constexpr uint16_t " << constant << " = " << i + 1 << ";\n";
+    }
+    out << "constexpr uint16_t kTerminalCount = " << g.terminals.size() << ";\n";
+    out << "constexpr uint16_t kRuleCount = " << g.rules.size() << ";\n";
+    out << "constexpr uint16_t kStartRule = " << g.start << ";\n";
+    out << "constexpr uint16_t kRuleBit = 0x" << std::hex << kRuleBase << ";\n";
+    out << "constexpr uint16_t kGlued = 0x8000;  // no whitespace before this terminal\n" << std::dec;
+    out << "constexpr uint16_t kSymbolMask = 0x3fff;\n\n";
+
+    out << "struct Word {\n    const char *text;\n    uint16_t terminal;\n};\n\n";
+    std::vector<int> keywords, punctuators;
+    std::vector<bool> used(g.terminals.size(), false);
+    for (const auto &production : g.productions) {
+        for (const auto &symbol : production.rhs) {
+            if (symbol.id < kRuleBase) used[symbol.id] = true;
+        }
+    }
+    for (size_t t = kScannedRules.size() + 1; t < g.terminals.size(); ++t) {
+        if (!used[t]) continue;
+        (g.keyword[t] ? keywords : punctuators).push_back(static_cast<int>(t));
+    }
+    // Longest first, so the scanner's first match is the maximal munch.
+    std::stable_sort(punctuators.begin(), punctuators.end(), [&](int a, int b) {
+        return g.terminals[a].size() > g.terminals[b].size();
+    });
+    out << "constexpr Word kKeywords[] = {\n";
+    for (int t : keywords) out << "    {" << quoted(g.terminals[t]) << ", " << t << "},\n";
+    out << "};\n\nconstexpr Word kPunctuators[] = {\n";
+    for (int t : punctuators) out << "    {" << quoted(g.terminals[t]) << ", " << t << "},\n";
+    out << "};\n\nconstexpr const char *kTerminalNames[kTerminalCount] = {\n";
+    for (size_t t = 0; t < g.terminals.size(); ++t) {
+        out << "    " << quoted(terminalName(g, static_cast<int>(t))) << ",\n";
+    }
+    out << "};\n\n";
+
+    out << "// Helper rules from [ ], { } and ( ) emit no token.\n";
+    out << "struct Rule {\n    const char *name;\n    int16_t token;\n    uint16_t productions;\n};\n\n";
+    out << "constexpr Rule kRules[kRuleCount] = {\n";
+    for (size_t r = 0; r < g.rules.size(); ++r) {
+        out << "    {" << quoted(g.rules[r]) << ", "
+            << (g.emits[r] ? upper(g.rules[r]) : std::string("-1")) << ", "
+            << g.byRule[r].front() << "},\n";
+    }
+    out << "};\n\n";
+
+    out << "struct Production {\n    uint16_t first;\n    uint16_t count;\n};\n\n";
+    std::vector<int> rhs;
+    out << "constexpr Production kProductions[] = {\n";
+    for (const auto &production : g.productions) {
+        out << "    {" << rhs.size() << ", " << production.rhs.size() << "},\n";
+        for (const auto &symbol : production.rhs) {
+            rhs.push_back(symbol.id | (symbol.glued ? 0x8000 : 0));
+        }
+    }
+    out << "};\n\nconstexpr uint16_t kRhs[] = {\n";
+    for (size_t i = 0; i < rhs.size(); i += 12) {
+        out << "   ";
+        for (size_t j = i; j < std::min(rhs.size(), i + 12); ++j) out << " " << rhs[j] << ",";
+        out << "\n";
+    }
+    out << "};\n\n";
+
+    out << "// Production to expand, -1 for a syntax error, or -2 - row to decide on the\n";
+    out << "// second token through kPredict2[row].\n";
+    out << "constexpr int16_t kPredict[kRuleCount][kTerminalCount] = {\n";
+    for (const auto &row : tables.predict) writeRow(out, row);
+    out << "};\n\n";
+    out << "constexpr int16_t kPredict2[][kTerminalCount] = {\n";
+    if (tables.predict2.empty()) writeRow(out, std::vector<int>(g.terminals.size(), kError));
+    for (const auto &row : tables.predict2) writeRow(out, row);
+    out << "};\n}  // namespace grammar\n";
+}
+
+bool generate(const std::string &tex, std::ostream &out) {
+    std::vector<EbnfToken> tokens;
+    std::vector<Definition> defs;
+    if (!tokenize(grammarText(tex), tokens) || !EbnfParser(tokens).parse(defs)) return false;
+    if (defs.empty()) return failWith("no grammar found");
+
+    // The scanned rules, rules built from character classes, and everything
+    // those refer to are left to the scanner.
+    std::set<std::string> lexical(kScannedRules.begin(), kScannedRules.end());
+    for (const auto &name : kScannedRules) {
+        auto found = std::find_if(defs.begin(), defs.end(), [&](const Definition &def) { return def.name == name; });
+        if (found == defs.end()) return failWith("<" + name + "> is missing");
+    }
+    for (const auto &def : defs) {
+        if (mentions(def.body, ITEM_CHARACTERS)) lexical.insert(def.name);
+    }
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (const auto &def : defs) {
+            if (!lexical.count(def.name)) continue;
+            for (const auto &other : defs) {
+                std::set<std::string> one{other.name};
+                if (!lexical.count(other.name) && mentions(def.body, ITEM_RULE, &one)) {
+                    lexical.insert(other.name);
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    // A composite punctuator that is also two terminals which may follow each
+    // other ("-(" against "-" "(") is matched as those two, without whitespace
+    // between them; maximal munch would otherwise misread `a - (b)`.
+    Grammar plain;
+    if (!Lowering(defs, lexical, {}, plain).run()) return false;
+    Analysis plainAnalysis;
+    plainAnalysis.run(plain);
+    std::map<std::string, std::pair<std::string, std::string>> splits;
+    auto find = [&](const std::string &text) {
+        auto it = std::find(plain.terminals.begin() + kScannedRules.size() + 1, plain.terminals.end(), text);
+        return it == plain.terminals.end() ? -1 : static_cast<int>(it - plain.terminals.begin());
+    };
+    for (size_t t = kScannedRules.size() + 1; t < plain.terminals.size(); ++t) {
+        const std::string &text = plain.terminals[t];
+        if (plain.keyword[t]) continue;
+        for (size_t cut = 1; cut < text.size(); ++cut) {
+            int head = find(text.substr(0, cut)), tail = find(text.substr(cut));
+            if (head < 0 || tail < 0 || !plainAnalysis.successors(plain, head).count(tail)) continue;
+            splits[text] = {text.substr(0, cut), text.substr(cut)};
+            std::cout << "pfru_grammar: " << quoted(text) << " is matched as " << quoted(text.substr(0, cut))
+                      << " followed directly by " << quoted(text.substr(cut)) << "\n";
+            break;
+        }
+    }
+
+    Grammar g;
+    if (!Lowering(defs, lexical, splits, g).run()) return false;
+    if (g.terminals.size() >= 0x4000 || g.rules.size() >= 0x4000) return failWith("grammar too large");
+    Analysis analysis;
+    analysis.run(g);
+    for (size_t r = 0; r < g.rules.size(); ++r) {
+        if (analysis.first[r].empty()) return failWith("<" + g.rules[r] + "> derives no sentence");
+    }
+    Tables tables;
+    buildTables(g, analysis, tables);
+    for (const auto &conflict : tables.conflicts) std::cout << "pfru_grammar: conflict " << conflict << "\n";
+    writeHeader(out, g, tables);
+    return true;
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        std::cerr << "usage: " << argv[0] << " <grammar.tex> <output.h>\n";
+        return 2;
+    }
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in) {
+        std::cerr << "pfru_grammar: cannot read " << argv[1] << "\n";
+        return 1;
+    }
+    std::stringstream tex;
+    tex << in.rdbuf();
+    std::stringstream header;
+    if (!generate(tex.str(), header)) return 1;
+    // Rewriting an unchanged header would rebuild everything that includes it.
+    std::ifstream previous(argv[2], std::ios::binary);
+    std::stringstream old;
+    if (previous) old << previous.rdbuf();
+    if (previous && old.str() == header.str()) return 0;
+    previous.close();
+    std::ofstream out(argv[2], std::ios::binary);
+    out << header.str();
+    return out ? 0 : 1;
+}
@@ -0,0 +1,68 @@
+#include "../include/Interner.h"
+
+namespace {
+uint64_t hashText(std::string_view text) {
+    uint64_t hash = 1469598103934665603ull;
+    for (unsigned char c : text) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+}  // namespace
+
+Interner::Interner(std::pmr::memory_resource *resource)
+    : names_(resource), hashes_(resource), table_(64, NONE, resource) {
+    intern("start");
+    intern("end");
+}
+
+void Interner::clear() {
+    names_.clear();
+    hashes_.clear();
+    table_.assign(64, NONE);
+    intern("start");
+    intern("end");
+}
+
+uint32_t Interner::intern(std::string_view text) {
+    uint64_t hash = hashText(text);
+    uint32_t slot = probe(text, hash);
+    if (table_[slot] != NONE) return table_[slot];
+    uint32_t id = static_cast<uint32_t>(names_.size());
+    names_.emplace_back(text);
+    hashes_.push_back(hash);
+    table_[slot] = id;
+    if (names_.size() * 2 > table_.size()) grow();
+    return id;
+}
+
+uint32_t Interner::find(std::string_view text) const {
+    return table_[probe(text, hashText(text))];
+}
+
+std::string_view Interner::name(uint32_t id) const { return names_[id]; }
+
+uint32_t Interner::size() const { return static_cast<uint32_t>(names_.size()); }
+
+// Returns the slot holding `text`, or the free slot where it would go.
+uint32_t Interner::probe(std::string_view text, uint64_t hash) const {
+    size_t mask = table_.size() - 1;
+    for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+        uint32_t id = table_[slot];
+        if (id == NONE || (hashes_[id] == hash && names_[id] == text)) {
+            return static_cast<uint32_t>(slot);
+        }
+    }
+}
+
+void Interner::grow() {
+    std::pmr::vector<uint32_t> table(table_.size() * 2, NONE, table_.get_allocator());
+    size_t mask = table.size() - 1;
+    for (uint32_t id = 0; id < names_.size(); ++id) {
+        size_t slot = hashes_[id] & mask;
+        while (table[slot] != NONE) slot = (slot + 1) & mask;
+        table[slot] = id;
+    }
+    table_.swap(table);
+}
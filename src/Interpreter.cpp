@@ -0,0 +1,1137 @@
+#include "../include/Interpreter.h"
+
+#include "../include/ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+namespace {
+const size_t kMaxCallDepth = 10000;
+const size_t kBatchChunk = 1024;
+// Strings a run may build before the first reclaim. Later reclaims wait for
+// the heap to double what survived the last, so each copies at most half of
+// what was built since.
+const size_t kMinReclaim = 1 << 20;
+// Chunks of a parallel loop. Only integer reductions run in chunks (see
+// analyseParallelLoops), so the grouping does not change results.
+const uint64_t kMinChunkTrips = 1024;
+const uint64_t kMaxChunks = 256;
+
+int64_t wrapped(VALUE_TYPE type, uint64_t value) {
+    return wrapInteger(type, static_cast<int64_t>(value));
+}
+
+// Shared by every interpreter. Its tasks never wait on other tasks, since
+// loops inside a chunk run sequentially.
+ThreadPool &loopPool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+// Number of iterations of an integer range, or false when the counter could
+// wrap around before leaving it; such loops stay sequential.
+bool tripCount(VALUE_TYPE type, int64_t start, int64_t step, int64_t end, uint64_t &trips) {
+    int64_t lo = std::numeric_limits<int64_t>::min(), hi = std::numeric_limits<int64_t>::max();
+    switch (type) {
+        case VALUE_I8: lo = INT8_MIN, hi = INT8_MAX; break;
+        case VALUE_I16: lo = INT16_MIN, hi = INT16_MAX; break;
+        case VALUE_I32: lo = INT32_MIN, hi = INT32_MAX; break;
+        case VALUE_I64: break;
+        default: return false;
+    }
+    if (step > 0) {
+        if (end > hi - step) return false;
+        trips = start < end ? (static_cast<uint64_t>(end) - static_cast<uint64_t>(start) +
+                               static_cast<uint64_t>(step) - 1) / static_cast<uint64_t>(step)
+                            : 0;
+    } else {
+        if (step == lo || end < lo - step) return false;
+        trips = start > end ? (static_cast<uint64_t>(start) - static_cast<uint64_t>(end) +
+                               static_cast<uint64_t>(-step) - 1) / static_cast<uint64_t>(-step)
+                            : 0;
+    }
+    return true;
+}
+}  // namespace
+
+Interpreter::Interpreter(const Module &module, size_t stackSlots, uint32_t memoEntries)
+    : module_(module),
+      stack_(stackSlots),
+      memoEntries_(memoEntries),
+      loopThreads_(std::max(1u, std::thread::hardware_concurrency())) {
+    size_t results = 0;
+    for (const auto &fn : module.functions) results = std::max<size_t>(results, fn.resultSize);
+    results_.resize(results);
+    columnar_.assign(module.functions.size(), -1);
+    memo_.resize(module.functions.size());
+    for (size_t i = 0; i < module.functions.size(); ++i) {
+        const Function &fn = module.functions[i];
+        if (fn.memoise && memoEntries) {
+            memo_[i] = MemoCache(fn.paramSize, fn.resultSize, memoEntries);
+        }
+    }
+}
+
+const std::string &Interpreter::error() const { return error_; }
+
+const MemoCache &Interpreter::memo(int32_t function) const { return memo_[function]; }
+
+void Interpreter::clearMemo() {
+    for (auto &memo : memo_) memo.clear();
+    for (auto &worker : loopWorkers_) worker->clearMemo();
+}
+
+void Interpreter::setProfiler(Profiler *profiler) { profiler_ = profiler; }
+
+void Interpreter::setTracer(Tracer *tracer) { tracer_ = tracer; }
+
+void Interpreter::setLoopThreads(unsigned threads) { loopThreads_ = std::max(1u, threads); }
+
+bool Interpreter::call(const std::string &name, const std::vector<Value> &args,
+                       std::vector<Value> &results) {
+    int32_t index = module_.find(name);
+    if (index < 0) {
+        error_ = "unknown repr '" + name + "'";
+        return false;
+    }
+    return call(index, args, results);
+}
+
+bool Interpreter::call(int32_t function, const std::vector<Value> &args,
+                       std::vector<Value> &results) {
+    const Function &fn = module_.functions[function];
+    failed_ = false;
+    ring_ = tracer_ ? &tracer_->ring() : nullptr;
+    error_.clear();
+    results.clear();
+    resetStrings();
+    reclaimDepth_ = 1;
+    if (args.size() != fn.params.size()) {
+        error_ = "'" + fn.name + "' takes " + std::to_string(fn.params.size()) + " arguments";
+        return false;
+    }
+    size_t base = top_;
+    if (base + fn.frameSlots > stack_.size()) {
+        error_ = "stack overflow";
+        return false;
+    }
+    Slot *frame = stack_.data() + base;
+    for (size_t i = 0; i < args.size(); ++i) {
+        Value converted;
+        if (fn.params[i].arraySize || !convertValue(args[i], fn.params[i].element, converted)) {
+            error_ = "cannot pass " + formatValue(args[i]) + " as " + typeRefName(fn.params[i]);
+            return false;
+        }
+        frame[fn.paramSlots[i]] = slotFromValue(converted, strings_);
+    }
+    top_ = base + fn.frameSlots;
+    bool ok = invoke(fn, frame);
+    top_ = base;
+    if (!ok) return false;
+    for (size_t i = 0; i < fn.results.size(); ++i) {
+        const TypeRef &type = fn.results[i];
+        const Slot *slot = results_.data() + fn.resultSlots[i];
+        if (type.arraySize == 0) {
+            results.push_back(valueFromSlot(type.element, *slot));
+            continue;
+        }
+        for (uint32_t j = 0; j < type.arraySize; ++j) {
+            results.push_back(valueFromSlot(type.element, loadElement(slot, type.element, j)));
+        }
+    }
+    return true;
+}
+
+bool Interpreter::run(const std::string &arrow, const std::vector<Value> &inputs,
+                      std::vector<Value> &outputs) {
+    int32_t index = module_.findArrow(arrow);
+    if (index < 0) {
+        error_ = "unknown arrow block '#" + arrow + "'";
+        return false;
+    }
+    return run(index, inputs, outputs);
+}
+
+bool Interpreter::run(int32_t index, const std::vector<Value> &inputs,
+                      std::vector<Value> &outputs) {
+    const Arrow &arrow = module_.arrows[index];
+    failed_ = false;
+    ring_ = tracer_ ? &tracer_->ring() : nullptr;
+    error_.clear();
+    outputs.clear();
+    resetStrings();
+    reclaimDepth_ = 1;
+
+    uint64_t moved = profiler_ ? Profiler::now() : 0;
+    const ArrowNode &start = arrow.nodes[arrow.start];
+    size_t skip = start.count > 1 ? 1 : 0;
+    if (skip && inputs.empty()) {
+        error_ = "'start' has several successors and needs a selector input";
+        return false;
+    }
+    const Transfer *transfer = select(arrow, start, skip ? inputs[0].i : 0);
+    if (!transfer) return false;
+    if (ring_) trace(index, arrow, *transfer);
+    if (transfer->to == arrow.end) {
+        outputs.assign(inputs.begin() + skip, inputs.end());
+        collect(arrow, *transfer, outputs);
+        if (profiler_) {
+            profiler_->traverse(index, static_cast<uint32_t>(transfer - arrow.transfers.data()),
+                                Profiler::now() - moved, 0);
+        }
+        return true;
+    }
+
+    size_t base = top_;
+    Slot *frame = stack_.data() + base;
+    const Function *fn = &module_.functions[arrow.nodes[transfer->to].function];
+    size_t payload = transfer->count;
+    if (inputs.size() - skip + payload != fn->params.size()) {
+        error_ = "'" + fn->name + "' takes " + std::to_string(fn->params.size()) +
+                 " arguments, got " + std::to_string(inputs.size() - skip + payload);
+        return false;
+    }
+    for (size_t i = skip; i < inputs.size(); ++i) {
+        const TypeRef &type = fn->params[i - skip];
+        Value converted;
+        if (type.arraySize || !convertValue(inputs[i], type.element, converted)) {
+            error_ = "cannot pass " + formatValue(inputs[i]) + " as " + typeRefName(type);
+            return false;
+        }
+        frame[fn->paramSlots[i - skip]] = slotFromValue(converted, strings_);
+    }
+
+    // Runs the target of `hop` and records the traversal.
+    auto traverse = [&](const Transfer &hop) {
+        uint64_t started = profiler_ ? Profiler::now() : 0;
+        bool ok = enterNode(arrow, hop, base, frame);
+        if (profiler_) {
+            uint64_t finished = Profiler::now();
+            profiler_->traverse(index, static_cast<uint32_t>(&hop - arrow.transfers.data()),
+                                started - moved, finished - started);
+            moved = finished;
+        }
+        return ok;
+    };
+    while (true) {
+        // A fused chain runs its stages back to back and continues from the
+        // last one; the transfers between them are never selected, but are
+        // traced and counted like any other, so the profile still shows them
+        // as taken.
+        const ArrowNode &head = arrow.nodes[transfer->to];
+        const ArrowNode *node = &head;
+        bool ok = traverse(*transfer);
+        for (size_t i = 0; ok && i < head.fused.size(); ++i) {
+            const Transfer &hop = arrow.transfers[head.fused[i]];
+            if (ring_) trace(index, arrow, hop);
+            ok = traverse(hop);
+            node = &arrow.nodes[hop.to];
+        }
+        if (!ok) return false;
+
+        if (!(transfer = select(arrow, *node, node->count > 1 ? results_[0].i : 0))) return false;
+        if (ring_) trace(index, arrow, *transfer);
+        if (transfer->to == arrow.end) {
+            collect(arrow, *transfer, outputs);
+            if (profiler_) {
+                profiler_->traverse(index, static_cast<uint32_t>(transfer - arrow.transfers.data()),
+                                    Profiler::now() - moved, 0);
+            }
+            return true;
+        }
+        if (strings_.footprint() > reclaimAt_) reclaimStrings(module_.functions[node->function]);
+    }
+}
+
+// Moves the arguments of `transfer` into the shared frame at `base` and runs
+// its target.
+bool Interpreter::enterNode(const Arrow &arrow, const Transfer &transfer, size_t base,
+                            Slot *frame) {
+    for (uint32_t i = 0; i < transfer.count; ++i) {
+        const ArrowArg &arg = arrow.args[transfer.first + i];
+        if (arg.source < 0) {
+            frame[arg.slot] = arg.constant;
+        } else if (arg.type.arraySize) {
+            std::memcpy(frame + arg.slot, results_.data() + arg.sourceSlot,
+                        arg.type.arraySize * elementSize(arg.type.element));
+        } else {
+            frame[arg.slot] = convertSlot(arg.from, arg.type.element, results_[arg.sourceSlot]);
+        }
+    }
+    const Function &fn = module_.functions[arrow.nodes[transfer.to].function];
+    if (base + fn.frameSlots > stack_.size()) {
+        error_ = "stack overflow";
+        return false;
+    }
+    top_ = base + fn.frameSlots;
+    bool ok = invoke(fn, frame);
+    top_ = base;
+    return ok;
+}
+
+void Interpreter::trace(int32_t index, const Arrow &arrow, const Transfer &transfer) {
+    ring_->record(TRACE_TRANSFER, static_cast<uint32_t>(&transfer - arrow.transfers.data()),
+                  static_cast<uint16_t>(index));
+}
+
+const Transfer *Interpreter::select(const Arrow &arrow, const ArrowNode &node, int64_t selector) {
+    if (node.count == 0) {
+        error_ = "'" + node.name + "' has no outgoing arrow in #" + arrow.name;
+        return nullptr;
+    }
+    if (selector < 0 || static_cast<uint64_t>(selector) >= node.count) {
+        error_ = "'" + node.name + "' selected arrow " + std::to_string(selector) + " of " +
+                 std::to_string(node.count);
+        return nullptr;
+    }
+    return &arrow.transfers[node.first + selector];
+}
+
+void Interpreter::collect(const Arrow &arrow, const Transfer &transfer,
+                          std::vector<Value> &outputs) {
+    for (uint32_t i = 0; i < transfer.count; ++i) {
+        const ArrowArg &arg = arrow.args[transfer.first + i];
+        if (arg.source < 0) {
+            outputs.push_back(arg.value);
+            continue;
+        }
+        const Slot *slot = results_.data() + arg.sourceSlot;
+        if (arg.type.arraySize == 0) {
+            outputs.push_back(valueFromSlot(arg.type.element, *slot));
+            continue;
+        }
+        for (uint32_t j = 0; j < arg.type.arraySize; ++j) {
+            outputs.push_back(valueFromSlot(arg.type.element,
+                                            loadElement(slot, arg.type.element, j)));
+        }
+    }
+}
+
+bool Interpreter::runBatch(const std::string &arrow, const Batch &inputs, Batch &outputs) {
+    int32_t index = module_.findArrow(arrow);
+    if (index < 0) {
+        error_ = "unknown arrow block '#" + arrow + "'";
+        return false;
+    }
+    return runBatch(index, inputs, outputs);
+}
+
+bool Interpreter::runBatch(int32_t index, const Batch &inputs, Batch &outputs) {
+    const Arrow &arrow = module_.arrows[index];
+    failed_ = false;
+    ring_ = tracer_ ? &tracer_->ring() : nullptr;
+    error_.clear();
+    resetStrings();
+    reclaimDepth_ = 0;
+    outputs = Batch();
+    outputs.rows = inputs.rows;
+    outputsTyped_ = false;
+    if (inputs.types.size() != inputs.columns.size()) {
+        error_ = "batch has " + std::to_string(inputs.columns.size()) + " columns but " +
+                 std::to_string(inputs.types.size()) + " types";
+        return false;
+    }
+    for (const auto &column : inputs.columns) {
+        if (column.size() != inputs.rows) {
+            error_ = "batch columns differ in length";
+            return false;
+        }
+    }
+
+    std::vector<Pending> pending(arrow.nodes.size());
+    const ArrowNode &start = arrow.nodes[arrow.start];
+    size_t skip = start.count > 1 ? 1 : 0;
+    if (skip > inputs.columns.size()) {
+        error_ = "'start' has several successors and needs a selector column";
+        return false;
+    }
+    for (uint32_t row = 0; row < inputs.rows; ++row) {
+        uint64_t moved = profiler_ ? Profiler::now() : 0;
+        const Transfer *transfer = select(arrow, start, skip ? inputs.columns[0][row].i : 0);
+        if (!transfer) return false;
+        if (ring_) trace(index, arrow, *transfer);
+        forwarded_.clear();
+        forwardedTypes_.clear();
+        for (size_t c = skip; c < inputs.columns.size(); ++c) {
+            forwarded_.push_back(inputs.columns[c][row]);
+            forwardedTypes_.push_back(inputs.types[c]);
+        }
+        if (!deliver(arrow, *transfer, row, pending, outputs)) return false;
+        if (profiler_) {
+            profiler_->traverse(index, static_cast<uint32_t>(transfer - arrow.transfers.data()),
+                                Profiler::now() - moved, 0);
+        }
+    }
+
+    // Drain the nodes in id order until no rows are pending. Rows that loop
+    // back to an earlier node are picked up on the next sweep.
+    std::vector<std::vector<Slot>> results;
+    Pending stage;
+    bool progress = true;
+    while (progress) {
+        progress = false;
+        for (size_t n = 0; n < pending.size(); ++n) {
+            if (pending[n].rows.empty()) continue;
+            progress = true;
+            if (strings_.footprint() > reclaimAt_) reclaimStrings(arrow, pending, outputs);
+            Pending work = std::move(pending[n]);
+            pending[n] = Pending();
+            const ArrowNode &head = arrow.nodes[n];
+            const ArrowNode &node = head.fused.empty()
+                                        ? head
+                                        : arrow.nodes[arrow.transfers[head.fused.back()].to];
+            const Function &fn = module_.functions[node.function];
+            size_t skipResult = node.count > 1 ? 1 : 0;
+            for (size_t begin = 0; begin < work.rows.size(); begin += kBatchChunk) {
+                size_t count = std::min(kBatchChunk, work.rows.size() - begin);
+                if (!runStage(module_.functions[head.function], work, begin, count, results) ||
+                    !runFused(arrow, head, count, stage, results)) {
+                    return false;
+                }
+                for (size_t i = 0; i < count; ++i) {
+                    // The rows took the fused transfers inside runFused.
+                    for (uint32_t t : head.fused) {
+                        if (ring_) trace(index, arrow, arrow.transfers[t]);
+                        if (profiler_) profiler_->traverse(index, t, 0, 0);
+                    }
+                    uint64_t moved = profiler_ ? Profiler::now() : 0;
+                    int64_t selector = skipResult ? results[fn.resultSlots[0]][i].i : 0;
+                    const Transfer *transfer = select(arrow, node, selector);
+                    if (!transfer) return false;
+                    if (ring_) trace(index, arrow, *transfer);
+                    forwarded_.clear();
+                    forwardedTypes_.clear();
+                    for (size_t k = skipResult; k < fn.results.size(); ++k) {
+                        if (fn.results[k].arraySize) {
+                            error_ = "array results of '" + fn.name + "' cannot be batched";
+                            return false;
+                        }
+                        forwarded_.push_back(results[fn.resultSlots[k]][i]);
+                        forwardedTypes_.push_back(fn.results[k].element);
+                    }
+                    if (!deliver(arrow, *transfer, work.rows[begin + i], pending, outputs)) {
+                        return false;
+                    }
+                    if (profiler_) {
+                        profiler_->traverse(
+                            index, static_cast<uint32_t>(transfer - arrow.transfers.data()),
+                            Profiler::now() - moved, 0);
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Runs the stages fused after `head` over a chunk whose results are in
+// `results`; the columns pass straight from stage to stage, and `results`
+// ends up holding those of the last stage.
+bool Interpreter::runFused(const Arrow &arrow, const ArrowNode &head, size_t count,
+                           Pending &stage, std::vector<std::vector<Slot>> &results) {
+    for (uint32_t t : head.fused) {
+        const Transfer &hop = arrow.transfers[t];
+        const Function &fn = module_.functions[arrow.nodes[hop.to].function];
+        stage.args.resize(fn.paramSize);
+        for (uint32_t i = 0; i < hop.count; ++i) {
+            const ArrowArg &arg = arrow.args[hop.first + i];
+            if (arg.type.arraySize) {
+                error_ = "array parameters of '" + fn.name + "' cannot be batched";
+                return false;
+            }
+            std::vector<Slot> &column = stage.args[arg.slot];
+            column.resize(count);
+            if (arg.source < 0) {
+                std::fill(column.begin(), column.end(), arg.constant);
+                continue;
+            }
+            const std::vector<Slot> &source = results[arg.sourceSlot];
+            for (size_t r = 0; r < count; ++r) {
+                column[r] = convertSlot(arg.from, arg.type.element, source[r]);
+            }
+        }
+        if (!runStage(fn, stage, 0, count, results)) return false;
+    }
+    return true;
+}
+
+// Routes one row whose forwarded values are in forwarded_: appends the
+// payload and queues the row at the target node, or stores it as output.
+bool Interpreter::deliver(const Arrow &arrow, const Transfer &transfer, uint32_t row,
+                          std::vector<Pending> &pending, Batch &outputs) {
+    bool toEnd = transfer.to == arrow.end;
+    for (uint32_t i = 0; i < transfer.count; ++i) {
+        const ArrowArg &arg = arrow.args[transfer.first + i];
+        if (arg.source >= 0) continue;
+        forwarded_.push_back(arg.constant);
+        forwardedTypes_.push_back(arg.type.element);
+    }
+
+    if (toEnd) {
+        if (!outputsTyped_) {
+            outputsTyped_ = true;
+            outputs.types = forwardedTypes_;
+            outputs.columns.assign(forwarded_.size(), std::vector<Slot>(outputs.rows));
+        } else if (outputs.types != forwardedTypes_) {
+            error_ = "transfers into 'end' produce different tuples";
+            return false;
+        }
+        for (size_t c = 0; c < forwarded_.size(); ++c) outputs.columns[c][row] = forwarded_[c];
+        return true;
+    }
+
+    const Function &fn = module_.functions[arrow.nodes[transfer.to].function];
+    if (forwarded_.size() != fn.params.size()) {
+        error_ = "'" + fn.name + "' takes " + std::to_string(fn.params.size()) +
+                 " arguments, got " + std::to_string(forwarded_.size());
+        return false;
+    }
+    Pending &target = pending[transfer.to];
+    target.args.resize(fn.paramSize);
+    target.rows.push_back(row);
+    for (size_t j = 0; j < fn.params.size(); ++j) {
+        if (fn.params[j].arraySize) {
+            error_ = "array parameters of '" + fn.name + "' cannot be batched";
+            return false;
+        }
+        target.args[fn.paramSlots[j]].push_back(
+            convertSlot(forwardedTypes_[j], fn.params[j].element, forwarded_[j]));
+    }
+    return true;
+}
+
+bool Interpreter::runStage(const Function &fn, const Pending &work, size_t begin, size_t count,
+                           std::vector<std::vector<Slot>> &results) {
+    results.resize(fn.resultSize);
+    for (auto &column : results) column.resize(count);
+    if (columnar(fn)) {
+        if (!profiler_ && !ring_) return runColumns(fn, work, begin, count, results);
+        int32_t function = static_cast<int32_t>(&fn - module_.functions.data());
+        if (profiler_) profiler_->enter(function);
+        if (ring_) ring_->record(TRACE_ENTER, static_cast<uint32_t>(function));
+        bool ok = runColumns(fn, work, begin, count, results);
+        if (ring_) ring_->record(TRACE_EXIT, static_cast<uint32_t>(function));
+        if (profiler_) profiler_->leave(count);
+        return ok;
+    }
+
+    size_t base = top_;
+    if (base + fn.frameSlots > stack_.size()) {
+        error_ = "stack overflow";
+        return false;
+    }
+    Slot *frame = stack_.data() + base;
+    for (size_t i = 0; i < count; ++i) {
+        for (uint32_t p = 0; p < fn.paramSize; ++p) frame[p] = work.args[p][begin + i];
+        top_ = base + fn.frameSlots;
+        bool ok = invoke(fn, frame);
+        top_ = base;
+        if (!ok) return false;
+        for (uint32_t r = 0; r < fn.resultSize; ++r) results[r][i] = results_[r];
+    }
+    return true;
+}
+
+// Straight-line reprs over scalars: a list of stores followed by one return.
+bool Interpreter::columnar(const Function &fn) {
+    int8_t &known = columnar_[&fn - module_.functions.data()];
+    if (known >= 0) return known;
+    known = 0;
+    const Node &body = fn.nodes[fn.body];
+    if (body.count == 0) return false;
+    for (const auto &param : fn.params) {
+        if (param.arraySize) return false;
+    }
+    for (const auto &result : fn.results) {
+        if (result.arraySize) return false;
+    }
+    for (uint32_t k = 0; k < body.count; ++k) {
+        const Node &stmt = fn.nodes[fn.lists[body.first + k]];
+        bool last = k + 1 == body.count;
+        if (!last && stmt.kind == NODE_STORE && columnarExpr(fn, stmt.a, false)) continue;
+        if (last && stmt.kind == NODE_RETURN && stmt.c < 0) {
+            for (uint32_t i = 0; i < stmt.count; ++i) {
+                if (!columnarExpr(fn, fn.lists[stmt.first + i], false)) return false;
+            }
+            continue;
+        }
+        return false;
+    }
+    known = 1;
+    return true;
+}
+
+// `guarded` marks the right side of && and ||, which may only be evaluated
+// for every row when it cannot fail.
+bool Interpreter::columnarExpr(const Function &fn, int32_t index, bool guarded) const {
+    const Node &n = fn.nodes[index];
+    switch (n.kind) {
+        case NODE_CONST:
+        case NODE_LOAD: return true;
+        case NODE_CONVERT:
+        case NODE_UNARY: return columnarExpr(fn, n.a, guarded);
+        case NODE_BINARY:
+            if (guarded && (n.op == OP_DIV || n.op == OP_MOD)) return false;
+            return columnarExpr(fn, n.a, guarded) && columnarExpr(fn, n.b, guarded);
+        case NODE_AND:
+        case NODE_OR: return columnarExpr(fn, n.a, guarded) && columnarExpr(fn, n.b, true);
+        default: return false;
+    }
+}
+
+bool Interpreter::runColumns(const Function &fn, const Pending &work, size_t begin,
+                             size_t count, std::vector<std::vector<Slot>> &results) {
+    const Function *saved = current_;
+    current_ = &fn;
+    std::vector<Slot> &frame = columnFrame_;
+    frame.resize(fn.frameSlots * count);
+    for (uint32_t p = 0; p < fn.paramSize; ++p) {
+        std::copy_n(work.args[p].begin() + begin, count, frame.begin() + p * count);
+    }
+    std::vector<Slot> column;
+    const Node &body = fn.nodes[fn.body];
+    for (uint32_t k = 0; k < body.count && !failed_; ++k) {
+        const Node &stmt = fn.nodes[fn.lists[body.first + k]];
+        if (stmt.kind == NODE_STORE) {
+            if (evalColumn(fn, stmt.a, count, frame, column)) {
+                std::copy(column.begin(), column.end(), frame.begin() + stmt.slot * count);
+            }
+            continue;
+        }
+        for (uint32_t i = 0; i < stmt.count && !failed_; ++i) {
+            evalColumn(fn, fn.lists[stmt.first + i], count, frame, results[fn.resultSlots[i]]);
+        }
+    }
+    current_ = saved;
+    return !failed_;
+}
+
+bool Interpreter::evalColumn(const Function &fn, int32_t index, size_t count,
+                             const std::vector<Slot> &frame, std::vector<Slot> &out) {
+    const Node &n = fn.nodes[index];
+    out.resize(count);
+    switch (n.kind) {
+        case NODE_CONST: std::fill(out.begin(), out.end(), n.constant); return true;
+        case NODE_LOAD:
+            std::copy_n(frame.begin() + n.slot * count, count, out.begin());
+            return true;
+        case NODE_CONVERT:
+            if (!evalColumn(fn, n.a, count, frame, out)) return false;
+            for (auto &slot : out) slot = convertSlot(n.from, n.type, slot);
+            return true;
+        case NODE_UNARY:
+            if (!evalColumn(fn, n.a, count, frame, out)) return false;
+            for (auto &slot : out) slot = unary(n, slot);
+            return true;
+        default: break;
+    }
+    std::vector<Slot> rhs;
+    if (!evalColumn(fn, n.a, count, frame, out) || !evalColumn(fn, n.b, count, frame, rhs)) {
+        return false;
+    }
+    if (n.kind == NODE_AND || n.kind == NODE_OR) {
+        bool isAnd = n.kind == NODE_AND;
+        for (size_t i = 0; i < count; ++i) {
+            out[i].i = isAnd ? out[i].i && rhs[i].i : out[i].i || rhs[i].i;
+        }
+        return true;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (!n.binary(out[i], rhs[i], out[i])) return fail(n, "division by zero");
+    }
+    return true;
+}
+
+void Interpreter::resetStrings() {
+    strings_.clear();
+    reclaimAt_ = std::max(kMinReclaim, 2 * strings_.footprint());
+}
+
+// Between two transfers of run(), strings survive only as results of the node
+// that ran last.
+void Interpreter::reclaimStrings(const Function &fn) {
+    for (size_t i = 0; i < fn.results.size(); ++i) {
+        if (fn.results[i].element != VALUE_STRINGA) continue;
+        Slot &slot = results_[fn.resultSlots[i]];
+        slot = spare_.copy(slot);
+    }
+    nextGeneration();
+}
+
+// Between two sweeps of runBatch(), strings survive as arguments of pending
+// rows and as outputs of finished ones.
+void Interpreter::reclaimStrings(const Arrow &arrow, std::vector<Pending> &pending,
+                                 Batch &outputs) {
+    for (size_t n = 0; n < pending.size(); ++n) {
+        if (pending[n].rows.empty()) continue;
+        const Function &fn = module_.functions[arrow.nodes[n].function];
+        for (size_t i = 0; i < fn.params.size(); ++i) {
+            if (fn.params[i].element != VALUE_STRINGA) continue;
+            for (Slot &slot : pending[n].args[fn.paramSlots[i]]) slot = spare_.copy(slot);
+        }
+    }
+    for (size_t c = 0; c < outputs.columns.size(); ++c) {
+        if (outputs.types[c] != VALUE_STRINGA) continue;
+        for (Slot &slot : outputs.columns[c]) slot = spare_.copy(slot);
+    }
+    nextGeneration();
+}
+
+// In the outermost repr of call() or run() nothing outside the frame holds
+// strings, so after a tail call they survive only as its arguments.
+void Interpreter::reclaimArguments(const Function &fn, Slot *frame) {
+    for (size_t i = 0; i < fn.params.size(); ++i) {
+        if (fn.params[i].element != VALUE_STRINGA) continue;
+        Slot &slot = frame[fn.paramSlots[i]];
+        slot = spare_.copy(slot);
+    }
+    nextGeneration();
+}
+
+// The survivors have been copied into spare_; everything else goes.
+void Interpreter::nextGeneration() {
+    std::swap(strings_, spare_);
+    spare_.clear();
+    reclaimAt_ = std::max(kMinReclaim, 2 * strings_.footprint());
+}
+
+bool Interpreter::fail(const Node &node, const std::string &message) {
+    if (!failed_) {
+        failed_ = true;
+        error_ = (current_ ? current_->name + ":" : std::string()) +
+                 std::to_string(node.row) + ":" + std::to_string(node.column) + ": " + message;
+    }
+    return false;
+}
+
+// Trampoline: a tail call leaves its arguments staged at the top of the stack
+// and unwinds with FLOW_TAIL; they are moved into the current frame, which is
+// then reused by the callee. Tail calls therefore take no native stack.
+// Memoised functions are looked up before running and cached after success;
+// the body may overwrite its parameters, so the key is copied aside first.
+bool Interpreter::invoke(const Function &entry, Slot *frame) {
+    int32_t function = static_cast<int32_t>(&entry - module_.functions.data());
+    MemoCache &memo = memo_[function];
+    if (profiler_) profiler_->enter(function);
+    if (ring_) ring_->record(TRACE_ENTER, static_cast<uint32_t>(function));
+    size_t key = memoKeys_.size();
+    if (memo.enabled()) {
+        // A loop worker reads its owner's cache first; the owner waits for
+        // the loop, so that cache does not change meanwhile.
+        const Slot *cached = owner_ ? owner_->memo_[function].peek(frame) : nullptr;
+        if (cached || (cached = memo.find(frame))) {
+            std::memcpy(results_.data(), cached, entry.resultSize * sizeof(Slot));
+            if (ring_) ring_->record(TRACE_EXIT, static_cast<uint32_t>(function));
+            if (profiler_) profiler_->leave();
+            return true;
+        }
+        memoKeys_.insert(memoKeys_.end(), frame, frame + entry.paramSize);
+    }
+
+    const Function *saved = current_;
+    const Function *fn = &entry;
+    size_t base = static_cast<size_t>(frame - stack_.data());
+    FLOW flow;
+    ++depth_;
+    while (true) {
+        current_ = fn;
+        flow = exec(*fn, fn->body, frame);
+        if (flow != FLOW_TAIL) break;
+        if (ring_) {
+            ring_->record(TRACE_EXIT, static_cast<uint32_t>(fn - module_.functions.data()));
+            ring_->record(TRACE_ENTER, static_cast<uint32_t>(tailCallee_));
+        }
+        fn = &module_.functions[tailCallee_];
+        if (profiler_) profiler_->replace(tailCallee_);
+        if (base + fn->frameSlots > stack_.size()) {
+            fail(fn->nodes[fn->body], "stack overflow");
+            flow = FLOW_ERROR;
+            break;
+        }
+        std::memmove(frame, stack_.data() + top_, fn->paramSize * sizeof(Slot));
+        top_ = base + fn->frameSlots;
+        if (depth_ == reclaimDepth_ && strings_.footprint() > reclaimAt_) {
+            reclaimArguments(*fn, frame);
+        }
+    }
+    --depth_;
+    if (flow == FLOW_NORMAL && !fn->results.empty()) {
+        fail(fn->nodes[fn->body], "'" + fn->name + "' finished without return");
+    }
+    current_ = saved;
+    if (memo.enabled()) {
+        if (!failed_) memo.insert(memoKeys_.data() + key, results_.data());
+        memoKeys_.resize(key);
+    }
+    if (ring_) ring_->record(TRACE_EXIT, static_cast<uint32_t>(fn - module_.functions.data()));
+    if (profiler_) profiler_->leave();
+    return !failed_;
+}
+
+void Interpreter::stageArguments(const Function &fn, const Node &node, Slot *frame,
+                                 Slot *calleeFrame) {
+    const Function &callee = module_.functions[node.callee];
+    for (uint32_t i = 0; i < node.count; ++i) {
+        int32_t arg = fn.lists[node.first + i];
+        Slot *dst = calleeFrame + callee.paramSlots[i];
+        if (callee.params[i].arraySize == 0) {
+            *dst = eval(fn, arg, frame);
+        } else {
+            const void *src = evalArray(fn, arg, frame);
+            if (src) std::memcpy(dst, src, slotCount(callee.params[i]) * sizeof(Slot));
+        }
+    }
+}
+
+// Callee frames start at the current top of the stack. The top is moved past
+// the callee frame while arguments are evaluated so nested calls land above it.
+bool Interpreter::callNode(const Function &fn, const Node &node, Slot *frame) {
+    const Function &callee = module_.functions[node.callee];
+    size_t base = top_;
+    if (depth_ >= kMaxCallDepth) return fail(node, "call depth limit exceeded");
+    if (base + callee.frameSlots > stack_.size()) return fail(node, "stack overflow");
+    Slot *calleeFrame = stack_.data() + base;
+    top_ = base + callee.frameSlots;
+    stageArguments(fn, node, frame, calleeFrame);
+    bool ok = !failed_ && invoke(callee, calleeFrame);
+    top_ = base;
+    return ok;
+}
+
+// Chunks are claimed in order by the caller and up to loopThreads_ - 1 pool
+// threads. Every chunk below the first failing one still runs, so the error
+// reported is the one the sequential loop would have stopped at.
+bool Interpreter::runParallel(const Function &fn, const Node &loop, const ParallelLoop &plan,
+                              Slot *frame, int64_t start, int64_t step, uint64_t trips) {
+    uint64_t chunkTrips = std::max(kMinChunkTrips, (trips + kMaxChunks - 1) / kMaxChunks);
+    size_t chunks = static_cast<size_t>((trips + chunkTrips - 1) / chunkTrips);
+    size_t helpers = std::min<size_t>({loopThreads_ - 1, loopPool().size(), chunks - 1});
+    while (loopWorkers_.size() < helpers + 1) {
+        loopWorkers_.push_back(std::make_unique<Interpreter>(module_, stack_.size(), memoEntries_));
+        loopWorkers_.back()->loopWorker_ = true;
+        loopWorkers_.back()->owner_ = this;
+    }
+
+    size_t reductions = plan.reductions.size();
+    std::vector<Slot> partials(chunks * reductions);
+    std::vector<std::string> errors(chunks);
+    std::atomic<size_t> next{0}, firstFailure{chunks};
+    auto work = [&](Interpreter &worker) {
+        worker.tracer_ = tracer_;
+        worker.ring_ = tracer_ ? &tracer_->ring() : nullptr;
+        for (size_t c; (c = next.fetch_add(1)) < chunks && c < firstFailure.load();) {
+            uint64_t begin = c * chunkTrips, end = std::min(trips, begin + chunkTrips);
+            if (worker.runChunk(fn, loop, plan, frame, depth_, start, step, begin, end,
+                                partials.data() + c * reductions)) {
+                continue;
+            }
+            errors[c] = worker.error_;
+            size_t seen = firstFailure.load();
+            while (c < seen && !firstFailure.compare_exchange_weak(seen, c)) {
+            }
+        }
+    };
+
+    std::mutex mutex;
+    std::condition_variable finished;
+    size_t running = helpers;
+    for (size_t h = 1; h <= helpers; ++h) {
+        loopPool().submit([&, h] {
+            work(*loopWorkers_[h]);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--running == 0) finished.notify_one();
+        });
+    }
+    work(*loopWorkers_[0]);
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [&] { return running == 0; });
+    }
+
+    if (firstFailure.load() < chunks) {
+        failed_ = true;
+        error_ = errors[firstFailure.load()];
+        return false;
+    }
+    for (size_t r = 0; r < reductions; ++r) {
+        const Reduction &reduction = plan.reductions[r];
+        Slot value = frame[reduction.slot];
+        for (size_t c = 0; c < chunks; ++c) {
+            reduction.combine(value, partials[c * reductions + r], value);
+        }
+        frame[reduction.slot] = value;
+    }
+    return true;
+}
+
+// Runs iterations [begin, end) on this worker's stack, from a copy of the
+// caller's frame with every reduction reset to its identity.
+bool Interpreter::runChunk(const Function &fn, const Node &loop, const ParallelLoop &plan,
+                           const Slot *source, size_t depth, int64_t start, int64_t step,
+                           uint64_t begin, uint64_t end, Slot *partials) {
+    failed_ = false;
+    error_.clear();
+    resetStrings();
+    Slot *frame = stack_.data();
+    std::copy(source, source + fn.frameSlots, frame);
+    top_ = fn.frameSlots;
+    depth_ = depth;
+    current_ = &fn;
+    for (const Reduction &reduction : plan.reductions) frame[reduction.slot] = reduction.identity;
+    for (uint64_t k = begin; k < end; ++k) {
+        frame[loop.slot].i =
+            wrapped(loop.from, static_cast<uint64_t>(start) + k * static_cast<uint64_t>(step));
+        if (exec(fn, loop.d, frame) != FLOW_NORMAL) return false;
+    }
+    for (size_t r = 0; r < plan.reductions.size(); ++r) {
+        partials[r] = frame[plan.reductions[r].slot];
+    }
+    return true;
+}
+
+Interpreter::FLOW Interpreter::exec(const Function &fn, int32_t index, Slot *frame) {
+    const Node &n = fn.nodes[index];
+    switch (n.kind) {
+        case NODE_STORE:
+            frame[n.slot] = eval(fn, n.a, frame);
+            break;
+        case NODE_ARRAY_STORE: {
+            const void *src = evalArray(fn, n.a, frame);
+            if (src && src != frame + n.slot) {
+                std::memmove(frame + n.slot, src, n.length * elementSize(n.type));
+            }
+            break;
+        }
+        case NODE_EVAL:
+            if (fn.nodes[n.a].kind == NODE_CALL) {
+                callNode(fn, fn.nodes[n.a], frame);
+            } else if (n.length) {
+                evalArray(fn, n.a, frame);
+            } else {
+                eval(fn, n.a, frame);
+            }
+            break;
+        case NODE_IF:
+            for (uint32_t i = 0; i < n.count; i += 2) {
+                Slot cond = eval(fn, fn.lists[n.first + i], frame);
+                if (failed_) return FLOW_ERROR;
+                if (cond.i) return exec(fn, fn.lists[n.first + i + 1], frame);
+            }
+            break;
+        case NODE_WHILE:
+            while (true) {
+                Slot cond = eval(fn, n.a, frame);
+                if (failed_) return FLOW_ERROR;
+                if (!cond.i) break;
+                FLOW flow = exec(fn, n.b, frame);
+                if (flow != FLOW_NORMAL) return flow;
+            }
+            break;
+        case NODE_DO_WHILE:
+            while (true) {
+                FLOW flow = exec(fn, n.b, frame);
+                if (flow != FLOW_NORMAL) return flow;
+                Slot cond = eval(fn, n.a, frame);
+                if (failed_) return FLOW_ERROR;
+                if (!cond.i) break;
+            }
+            break;
+        case NODE_FOR: {
+            Slot start = eval(fn, n.a, frame);
+            Slot step{};
+            if (n.b >= 0) {
+                step = eval(fn, n.b, frame);
+            } else {
+                step = convertSlot(VALUE_I64, n.from, Slot{1});
+            }
+            Slot end = eval(fn, n.c, frame);
+            if (failed_) return FLOW_ERROR;
+            if (isFloating(n.from)) {
+                if (step.f == 0.0) {
+                    fail(n, "range step is zero");
+                    return FLOW_ERROR;
+                }
+                for (double v = start.f; step.f > 0 ? v < end.f : v > end.f; v += step.f) {
+                    frame[n.slot].f = v;
+                    FLOW flow = exec(fn, n.d, frame);
+                    if (flow != FLOW_NORMAL) return flow;
+                }
+            } else {
+                if (step.i == 0) {
+                    fail(n, "range step is zero");
+                    return FLOW_ERROR;
+                }
+                // Profiled runs stay sequential, the profiler is not shared.
+                uint64_t trips;
+                if (!fn.parallelLoops.empty() && loopThreads_ > 1 && !loopWorker_ && !profiler_ &&
+                    tripCount(n.from, start.i, step.i, end.i, trips) &&
+                    trips >= 2 * kMinChunkTrips) {
+                    for (const ParallelLoop &plan : fn.parallelLoops) {
+                        if (plan.node != index) continue;
+                        if (!runParallel(fn, n, plan, frame, start.i, step.i, trips)) {
+                            return FLOW_ERROR;
+                        }
+                        return FLOW_NORMAL;
+                    }
+                }
+                for (int64_t v = start.i; step.i > 0 ? v < end.i : v > end.i;
+                     v = wrapped(n.from, static_cast<uint64_t>(v) + step.i)) {
+                    frame[n.slot].i = v;
+                    FLOW flow = exec(fn, n.d, frame);
+                    if (flow != FLOW_NORMAL) return flow;
+                }
+            }
+            break;
+        }
+        case NODE_RETURN: {
+            if (n.c >= 0) {
+                // Tail call: stage the arguments and let invoke() reuse the frame.
+                const Node &call = fn.nodes[n.c];
+                const Function &callee = module_.functions[call.callee];
+                size_t base = top_;
+                if (base + callee.paramSize > stack_.size()) {
+                    fail(n, "stack overflow");
+                    return FLOW_ERROR;
+                }
+                top_ = base + callee.paramSize;
+                stageArguments(fn, call, frame, stack_.data() + base);
+                top_ = base;
+                tailCallee_ = call.callee;
+                return failed_ ? FLOW_ERROR : FLOW_TAIL;
+            }
+            Slot *staging = frame + n.slot;
+            for (uint32_t i = 0; i < n.count; ++i) {
+                const TypeRef &type = fn.results[i];
+                int32_t item = fn.lists[n.first + i];
+                if (type.arraySize == 0) {
+                    staging[fn.resultSlots[i]] = eval(fn, item, frame);
+                } else if (const void *src = evalArray(fn, item, frame)) {
+                    std::memcpy(staging + fn.resultSlots[i], src,
+                                type.arraySize * elementSize(type.element));
+                }
+            }
+            if (failed_) return FLOW_ERROR;
+            std::copy(staging, staging + fn.resultSize, results_.begin());
+            return FLOW_RETURN;
+        }
+        case NODE_BLOCK:
+            for (uint32_t i = 0; i < n.count; ++i) {
+                FLOW flow = exec(fn, fn.lists[n.first + i], frame);
+                if (flow != FLOW_NORMAL) return flow;
+            }
+            break;
+        default:
+            fail(n, "unexpected expression in statement position");
+            break;
+    }
+    return failed_ ? FLOW_ERROR : FLOW_NORMAL;
+}
+
+Slot Interpreter::eval(const Function &fn, int32_t index, Slot *frame) {
+    const Node &n = fn.nodes[index];
+    switch (n.kind) {
+        case NODE_CONST: return n.constant;
+        case NODE_LOAD: return frame[n.slot];
+        case NODE_CONVERT: return convertSlot(n.from, n.type, eval(fn, n.a, frame));
+        case NODE_UNARY: return unary(n, eval(fn, n.a, frame));
+        case NODE_BINARY: {
+            Slot lhs = eval(fn, n.a, frame);
+            Slot rhs = eval(fn, n.b, frame);
+            Slot out{};
+            if (!n.binary(lhs, rhs, out)) fail(n, "division by zero");
+            return out;
+        }
+        case NODE_AND: {
+            Slot out{};
+            out.i = eval(fn, n.a, frame).i && eval(fn, n.b, frame).i;
+            return out;
+        }
+        case NODE_OR: {
+            Slot out{};
+            out.i = eval(fn, n.a, frame).i || eval(fn, n.b, frame).i;
+            return out;
+        }
+        case NODE_CALL:
+            if (!callNode(fn, n, frame)) return Slot{};
+            return results_[0];
+        case NODE_CONCAT: {
+            Slot lhs = eval(fn, n.a, frame);
+            return strings_.concat(lhs, eval(fn, n.b, frame));
+        }
+        default:
+            fail(n, "expected a scalar expression");
+            return Slot{};
+    }
+}
+
+const void *Interpreter::evalArray(const Function &fn, int32_t index, Slot *frame) {
+    const Node &n = fn.nodes[index];
+    Slot *dst = frame + n.slot;
+    switch (n.kind) {
+        case NODE_ARRAY_LOAD: return dst;
+        case NODE_ARRAY_LITERAL:
+            if (n.count == 0) {
+                std::memset(dst, 0, n.length * elementSize(n.type));
+            }
+            for (uint32_t i = 0; i < n.count; ++i) {
+                storeElement(dst, n.type, i, eval(fn, fn.lists[n.first + i], frame));
+            }
+            return dst;
+        case NODE_ARRAY_BINARY: {
+            Slot lhsScalar{}, rhsScalar{};
+            const void *lhs = &lhsScalar;
+            const void *rhs = &rhsScalar;
+            if (n.broadcast == 1) {
+                storeElement(&lhsScalar, n.from, 0, eval(fn, n.a, frame));
+            } else {
+                lhs = evalArray(fn, n.a, frame);
+            }
+            if (n.broadcast == 2) {
+                storeElement(&rhsScalar, n.from, 0, eval(fn, n.b, frame));
+            } else {
+                rhs = evalArray(fn, n.b, frame);
+            }
+            if (failed_ || !lhs || !rhs) return nullptr;
+            if (!n.kernel(dst, lhs, rhs, n.length)) {
+                fail(n, "division by zero");
+                return nullptr;
+            }
+            return dst;
+        }
+        case NODE_ARRAY_CONVERT: {
+            const void *src = evalArray(fn, n.a, frame);
+            if (!src) return nullptr;
+            for (uint32_t i = 0; i < n.length; ++i) {
+                storeElement(dst, n.type, i,
+                             convertSlot(n.from, n.type, loadElement(src, n.from, i)));
+            }
+            return dst;
+        }
+        case NODE_ARRAY_CALL:
+            if (!callNode(fn, n, frame)) return nullptr;
+            std::memcpy(dst, results_.data(), n.length * elementSize(n.type));
+            return dst;
+        default:
+            fail(n, "expected an array expression");
+            return nullptr;
+    }
+}
+
+Slot Interpreter::unary(const Node &node, Slot operand) {
+    Slot out{};
+    if (node.op == OP_NOT) {
+        out.i = isFloating(node.from) ? operand.f == 0.0 : operand.i == 0;
+    } else if (node.op == OP_PLUS) {
+        out = operand;
+    } else if (isFloating(node.type)) {
+        out.f = -operand.f;
+    } else {
+        out.i = wrapped(node.type, 0 - static_cast<uint64_t>(operand.i));
+    }
+    return out;
+}
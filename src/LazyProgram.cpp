@@ -0,0 +1,161 @@
+#include "../include/LazyProgram.h"
+
+#include "../include/Linker.h"
+#include "../include/TableParser.h"
+
+#include <algorithm>
+#include <cctype>
+
+LazyProgram::LazyProgram(const std::string &source) : source_(source) {}
+
+Program &LazyProgram::program() { return program_; }
+
+const std::string &LazyProgram::error() const { return error_; }
+
+size_t LazyProgram::declarationCount() const { return declarations_.size(); }
+
+size_t LazyProgram::loadedCount() const { return loaded_; }
+
+bool LazyProgram::index() {
+    declarations_.clear();
+    reprs_.clear();
+    arrows_.clear();
+    row_ = 1;
+    lastNewLineIndex_ = -1;
+    size_t index = 0;
+    for (skipWhitespace(index); index < source_.size(); skipWhitespace(index)) {
+        Declaration decl;
+        decl.begin = index;
+        decl.row = row_;
+        decl.column = static_cast<uint32_t>(static_cast<int64_t>(index) - lastNewLineIndex_);
+        std::string keyword;
+        if (source_[index] == '#') {
+            decl.arrow = true;
+            ++index;
+            skipWhitespace(index);
+            identifier(index, decl.name);
+        } else if (identifier(index, keyword) && keyword == "repr") {
+            decl.arrow = false;
+            skipWhitespace(index);
+            if (!identifier(index, decl.name)) return false;
+        } else {
+            return false;
+        }
+        if (!scanBody(index, decl)) return false;
+        decl.end = index;
+        std::sort(decl.references.begin(), decl.references.end());
+        decl.references.erase(std::unique(decl.references.begin(), decl.references.end()),
+                              decl.references.end());
+        (decl.arrow ? arrows_ : reprs_)[decl.name].push_back(
+            static_cast<uint32_t>(declarations_.size()));
+        declarations_.push_back(std::move(decl));
+    }
+    return true;
+}
+
+// Skips to the brace that closes the declaration's body. Inside the body a
+// name followed by '(' may be a call, and any name in an arrow block may be
+// a node.
+bool LazyProgram::scanBody(size_t &index, Declaration &decl) {
+    int depth = 0;
+    std::string word;
+    while (index < source_.size()) {
+        char c = source_[index];
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+            skipWhitespace(index);
+        } else if (c == '"' || c == '\'') {
+            // Literals hold identifier characters only, never a line break.
+            size_t close = source_.find(c, index + 1);
+            if (close == std::string::npos ||
+                source_.find_first_of("\r\n", index) < close) {
+                return false;
+            }
+            index = close + 1;
+        } else if (identifierChar(index)) {
+            identifier(index, word);
+            if (depth == 0 || std::isdigit(static_cast<unsigned char>(word[0]))) continue;
+            size_t after = source_.find_first_not_of(" \t\r\n", index);
+            if (decl.arrow || (after != std::string::npos && source_[after] == '(')) {
+                decl.references.push_back(word);
+            }
+        } else {
+            ++index;
+            if (c == '{') {
+                ++depth;
+            } else if (c == '}') {
+                if (depth == 0) return false;
+                if (--depth == 0) return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool LazyProgram::load(const std::vector<std::string> &reprs,
+                       const std::vector<std::string> &arrows) {
+    std::vector<uint32_t> work;
+    auto need = [&](const std::unordered_map<std::string, std::vector<uint32_t>> &byName,
+                    const std::string &name) {
+        auto it = byName.find(name);
+        if (it == byName.end()) return;
+        for (uint32_t d : it->second) {
+            if (declarations_[d].loaded) continue;
+            declarations_[d].loaded = true;
+            work.push_back(d);
+        }
+    };
+    for (const auto &name : reprs) need(reprs_, name);
+    for (const auto &name : arrows) need(arrows_, name);
+    for (size_t i = 0; i < work.size(); ++i) {
+        for (const auto &name : declarations_[work[i]].references) need(reprs_, name);
+    }
+    std::sort(work.begin(), work.end());
+
+    TableParser parser;
+    Linker linker(program_);
+    for (uint32_t d : work) {
+        const Declaration &decl = declarations_[d];
+        parser.setOrigin(decl.row, decl.column);
+        if (!parser.parseProgram(source_.substr(decl.begin, decl.end - decl.begin))) {
+            error_ = parser.error();
+            return false;
+        }
+        Program piece;
+        if (!buildProgram(parser.tokens(), parser.symbols(), piece, error_)) return false;
+        for (const auto &func : piece.functions) linker.add(piece, func);
+        for (const auto &block : piece.arrows) linker.add(piece, block);
+        ++loaded_;
+    }
+    return true;
+}
+
+void LazyProgram::skipWhitespace(size_t &index) {
+    while (index < source_.size()) {
+        char c = source_[index];
+        if (c != ' ' && c != '\t' && c != '\r' && c != '\n') break;
+        if (c == '\n' || c == '\r') {
+            ++row_;
+            lastNewLineIndex_ = static_cast<int64_t>(index);
+        }
+        ++index;
+    }
+}
+
+bool LazyProgram::identifier(size_t &index, std::string &out) const {
+    size_t begin = index;
+    for (size_t length; (length = identifierChar(index)) != 0;) index += length;
+    out.assign(source_, begin, index - begin);
+    return index > begin;
+}
+
+// Bytes of the identifier character at `index`, 0 if there is none. As in
+// TableParser: ASCII letters, digits and '_', А-Я and а-я.
+size_t LazyProgram::identifierChar(size_t index) const {
+    if (index >= source_.size()) return 0;
+    unsigned char c = static_cast<unsigned char>(source_[index]);
+    if (c < 0x80) return std::isalnum(c) || c == '_' ? 1 : 0;
+    if (index + 1 >= source_.size()) return 0;
+    unsigned char c1 = static_cast<unsigned char>(source_[index + 1]);
+    bool cyrillic = (c == 0xD0 && c1 >= 0x90 && c1 <= 0xBF) || (c == 0xD1 && c1 >= 0x80 && c1 <= 0x8F);
+    return cyrillic ? 2 : 0;
+}
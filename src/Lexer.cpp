@@ -1,6 +1,9 @@
 #include "../include/Lexer.h"
 
+#include "../include/NumberLiteral.h"
+
 #include <cctype>
+#include <cstring>
 #include <tuple>
 #include <unordered_set>
 
@@ -19,22 +22,74 @@ const std::unordered_set<std::string> kKeywords = {
     "f32",  "f64",   "char",   "stringa", "bool"};
 }  // namespace
 
-Lexer::Lexer(const std::string &program)
-    : program_(program), symbolIndex_(0), row_(1), lastNewLineIndex_(-1) {}
+Lexer::Lexer(const std::string &program, std::pmr::memory_resource *resource)
+    : program_(program, resource),
+      tokens_(resource),
+      symbols_(resource),
+      symbolIndex_(0),
+      row_(1),
+      lastNewLineIndex_(-1) {}
 
 void Lexer::reset() {
     symbolIndex_ = 0;
     row_ = 1;
     lastNewLineIndex_ = -1;
+    failedOperand_ = -1;
+    status_ = PARSE_OK;
+    error_.clear();
+    ruleCalls_ = 0;
+    depth_ = 0;
     tokens_.clear();
+    symbols_.clear();
 }
 
+void Lexer::setOptions(const ParseOptions &options) { options_ = options; }
+
+// A rule cut short by a limit may have let a shorter alternative match, so
+// the result only counts if none was reached.
 bool Lexer::parseProgram() {
     reset();
-    return program();
+    return program() && status_ == PARSE_OK;
 }
 
-const std::vector<Token> &Lexer::tokens() const { return tokens_; }
+const std::pmr::vector<Token> &Lexer::tokens() const { return tokens_; }
+
+PARSE_STATUS Lexer::status() const { return status_; }
+
+const std::string &Lexer::error() const { return error_; }
+
+uint64_t Lexer::ruleCalls() const { return ruleCalls_; }
+
+const Interner &Lexer::symbols() const { return symbols_; }
+
+// Once a limit is reached every rule fails, so the parse unwinds at once.
+bool Lexer::enterRule() {
+    ++depth_;
+    ++ruleCalls_;
+    if (status_ != PARSE_OK) return false;
+    if (options_.maxRuleCalls && ruleCalls_ > options_.maxRuleCalls) {
+        return stop(PARSE_RULE_LIMIT,
+                    "more than " + std::to_string(options_.maxRuleCalls) + " rule calls");
+    }
+    if (options_.maxDepth && depth_ > options_.maxDepth) {
+        return stop(PARSE_DEPTH_LIMIT,
+                    "rules nested deeper than " + std::to_string(options_.maxDepth) + " levels");
+    }
+    if (options_.cancel && ruleCalls_ % CANCEL_CHECK_INTERVAL == 0 &&
+        options_.cancel->load(std::memory_order_relaxed)) {
+        return stop(PARSE_CANCELLED, "parse cancelled");
+    }
+    return true;
+}
+
+// Keeps the first reason the parse failed.
+bool Lexer::stop(PARSE_STATUS status, const std::string &message) {
+    if (status_ != PARSE_OK) return false;
+    status_ = status;
+    error_ = std::to_string(row_) + ":" + std::to_string(symbolIndex_ - lastNewLineIndex_) +
+             ": " + message;
+    return false;
+}
 
 bool Lexer::decodeUtf8(size_t index, Utf8Char &out) const {
     if (index >= program_.size()) return false;
@@ -166,7 +221,21 @@ void Lexer::emitToken(TOKEN_TYPE type, int startIndex, int startRow, int startCo
     tokens_.push_back({type,
                        static_cast<uint32_t>(startRow),
                        static_cast<uint32_t>(startCol),
-                       program_.substr(startIndex, endIndex - startIndex)});
+                       static_cast<uint32_t>(startIndex),
+                       std::string_view(program_).substr(startIndex, endIndex - startIndex),
+                       UINT32_MAX,
+                       {}});
+    if (options_.maxTokens && tokens_.size() > options_.maxTokens) {
+        stop(PARSE_TOKEN_LIMIT, "more than " + std::to_string(options_.maxTokens) + " tokens");
+    }
+}
+
+void Lexer::dropTokensFrom(int index) {
+    // Tokens are emitted in post-order, so everything produced by an attempt
+    // that started at `index` sits at the tail of the vector.
+    while (!tokens_.empty() && static_cast<int>(tokens_.back().offset) >= index) {
+        tokens_.pop_back();
+    }
 }
 
 bool Lexer::peek(const std::string &symbols) {
@@ -179,6 +248,33 @@ char Lexer::get() {
     return program_[symbolIndex_];
 }
 
+// The name starting at the current position, empty if none does; nothing is
+// consumed. Keywords are returned too, so that rules can dispatch on them.
+std::string_view Lexer::peekWord() {
+    size_t end = symbolIndex_;
+    size_t adv = 0;
+    if (isDigitChar(get())) return {};
+    while (isIdentifierChar(end, adv)) end += adv;
+    return std::string_view(program_).substr(symbolIndex_, end - symbolIndex_);
+}
+
+// The first character at or after `index` that is not whitespace.
+char Lexer::peekAfter(size_t index) const {
+    while (index < program_.size() &&
+           (program_[index] == ' ' || program_[index] == '\t' || program_[index] == '\r' ||
+            program_[index] == '\n')) {
+        ++index;
+    }
+    return index < program_.size() ? program_[index] : '\0';
+}
+
+// Whether an expression can start at the current position.
+bool Lexer::startsExpr() {
+    char c = get();
+    if (c == '\0') return false;
+    return !peekWord().empty() || isDigitChar(c) || std::strchr("\"'{(+-!", c) != nullptr;
+}
+
 bool Lexer::next() {
     if (symbolIndex_ >= static_cast<int>(program_.size())) return false;
     char c = program_[symbolIndex_];
@@ -191,6 +287,8 @@ bool Lexer::next() {
 }
 
 bool Lexer::letter() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     if (symbolIndex_ >= static_cast<int>(program_.size())) return false;
     char c = get();
     if (isAsciiLetter(c)) {
@@ -205,6 +303,8 @@ bool Lexer::letter() {
 }
 
 bool Lexer::ruLetter() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     Utf8Char ch{};
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -220,21 +320,9 @@ bool Lexer::ruLetter() {
     return false;
 }
 
-bool Lexer::digit() {
-    if (symbolIndex_ >= static_cast<int>(program_.size())) return false;
-    char c = get();
-    if (isDigitChar(c)) {
-        int startIndex = symbolIndex_;
-        int startRow = row_;
-        int startCol = startIndex - lastNewLineIndex_;
-        next();
-        emitToken(DIGIT, startIndex, startRow, startCol);
-        return true;
-    }
-    return false;
-}
-
 bool Lexer::any() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     if (symbolIndex_ >= static_cast<int>(program_.size())) return false;
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -245,6 +333,8 @@ bool Lexer::any() {
 }
 
 bool Lexer::identifier() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -265,7 +355,7 @@ bool Lexer::identifier() {
         advanceBytes(adv);
     }
 
-    std::string word = program_.substr(startIndex, symbolIndex_ - startIndex);
+    std::string word(std::string_view(program_).substr(startIndex, symbolIndex_ - startIndex));
     if (isKeyword(word)) {
         symbolIndex_ = startIndex;
         row_ = startRow;
@@ -274,56 +364,36 @@ bool Lexer::identifier() {
     }
 
     emitToken(IDENTIFIER, startIndex, startRow, startCol);
+    tokens_.back().symbol = symbols_.intern(word);
     return true;
 }
 
-bool Lexer::integerLiteral() {
+// Both numeric literals in one scan that also decodes the value; array sizes
+// take integers only.
+bool Lexer::numberLiteral(bool allowFloat) {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
     int startCol = startIndex - lastNewLineIndex_;
-    int startLast = lastNewLineIndex_;
-    if (!digit()) {
-        symbolIndex_ = startIndex;
-        row_ = startRow;
-        lastNewLineIndex_ = startLast;
-        return false;
-    }
-    while (digit()) {
-    }
-    emitToken(INTEGER_LITERAL, startIndex, startRow, startCol);
-    return true;
-}
-
-bool Lexer::floatLiteral() {
-    skipWhitespace();
-    int startIndex = symbolIndex_;
-    int startRow = row_;
-    int startCol = startIndex - lastNewLineIndex_;
-    int startLast = lastNewLineIndex_;
-
-    if (!digit()) return false;
-    while (digit()) {
-    }
-    if (!matchLiteral(".", false)) {
-        symbolIndex_ = startIndex;
-        row_ = startRow;
-        lastNewLineIndex_ = startLast;
-        return false;
-    }
-    if (!digit()) {
-        symbolIndex_ = startIndex;
-        row_ = startRow;
-        lastNewLineIndex_ = startLast;
+    NumberLiteral number = scanNumber(std::string_view(program_).substr(symbolIndex_));
+    if (number.length == 0 || !number.inRange || (number.type == FLOAT_LITERAL && !allowFloat)) {
         return false;
     }
-    while (digit()) {
+    symbolIndex_ += static_cast<int>(number.length);
+    emitToken(number.type, startIndex, startRow, startCol);
+    if (number.type == FLOAT_LITERAL) {
+        tokens_.back().real = number.real;
+    } else {
+        tokens_.back().integer = number.integer;
     }
-    emitToken(FLOAT_LITERAL, startIndex, startRow, startCol);
     return true;
 }
 
 bool Lexer::charLiteral() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -338,6 +408,7 @@ bool Lexer::charLiteral() {
         symbolIndex_ = startIndex;
         row_ = startRow;
         lastNewLineIndex_ = startLast;
+        dropTokensFrom(symbolIndex_);
         return false;
     }
     emitToken(CHAR_LITERAL, startIndex, startRow, startCol);
@@ -345,6 +416,8 @@ bool Lexer::charLiteral() {
 }
 
 bool Lexer::stringLiteral() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -359,6 +432,7 @@ bool Lexer::stringLiteral() {
         symbolIndex_ = startIndex;
         row_ = startRow;
         lastNewLineIndex_ = startLast;
+        dropTokensFrom(symbolIndex_);
         return false;
     }
     emitToken(STRING_LITERAL, startIndex, startRow, startCol);
@@ -366,6 +440,8 @@ bool Lexer::stringLiteral() {
 }
 
 bool Lexer::boolLiteral() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -378,10 +454,13 @@ bool Lexer::boolLiteral() {
     symbolIndex_ = startIndex;
     row_ = startRow;
     lastNewLineIndex_ = startLast;
+    dropTokensFrom(symbolIndex_);
     return false;
 }
 
 bool Lexer::space() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     if (symbolIndex_ >= static_cast<int>(program_.size())) return false;
     if (get() == ' ' || get() == '\t') {
         int startIndex = symbolIndex_;
@@ -395,6 +474,8 @@ bool Lexer::space() {
 }
 
 bool Lexer::newline() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     if (symbolIndex_ >= static_cast<int>(program_.size())) return false;
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -408,6 +489,8 @@ bool Lexer::newline() {
 }
 
 bool Lexer::primitiveType() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -425,10 +508,13 @@ bool Lexer::primitiveType() {
     symbolIndex_ = startIndex;
     row_ = startRow;
     lastNewLineIndex_ = startLast;
+    dropTokensFrom(symbolIndex_);
     return false;
 }
 
 bool Lexer::arrayType() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -439,18 +525,21 @@ bool Lexer::arrayType() {
         symbolIndex_ = startIndex;
         row_ = startRow;
         lastNewLineIndex_ = startLast;
+        dropTokensFrom(symbolIndex_);
         return false;
     }
-    if (!integerLiteral()) {
+    if (!numberLiteral(false)) {
         symbolIndex_ = startIndex;
         row_ = startRow;
         lastNewLineIndex_ = startLast;
+        dropTokensFrom(symbolIndex_);
         return false;
     }
     if (!matchLiteral("]", true)) {
         symbolIndex_ = startIndex;
         row_ = startRow;
         lastNewLineIndex_ = startLast;
+        dropTokensFrom(symbolIndex_);
         return false;
     }
     emitToken(ARRAY_TYPE, startIndex, startRow, startCol);
@@ -458,6 +547,8 @@ bool Lexer::arrayType() {
 }
 
 bool Lexer::type() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -470,10 +561,13 @@ bool Lexer::type() {
     symbolIndex_ = startIndex;
     row_ = startRow;
     lastNewLineIndex_ = startLast;
+    dropTokensFrom(symbolIndex_);
     return false;
 }
 
 bool Lexer::block() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -497,6 +591,7 @@ bool Lexer::block() {
         symbolIndex_ = startIndex;
         row_ = startRow;
         lastNewLineIndex_ = startLast;
+        dropTokensFrom(symbolIndex_);
         return false;
     }
     emitToken(BLOCK, startIndex, startRow, startCol);
@@ -504,57 +599,33 @@ bool Lexer::block() {
 }
 
 bool Lexer::statement() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
     int startCol = startIndex - lastNewLineIndex_;
     int startLast = lastNewLineIndex_;
 
-    if (ifStmt() || whileStmt() || doWhileStmt() || forStmt()) {
-        emitToken(STATEMENT, startIndex, startRow, startCol);
-        return true;
-    }
-
-    if (returnStmt()) {
-        if (!matchLiteral(";", true)) {
-            symbolIndex_ = startIndex;
-            row_ = startRow;
-            lastNewLineIndex_ = startLast;
-            return false;
-        }
-        emitToken(STATEMENT, startIndex, startRow, startCol);
-        return true;
-    }
-
-    if (varDecl()) {
-        if (!matchLiteral(";", true)) {
-            symbolIndex_ = startIndex;
-            row_ = startRow;
-            lastNewLineIndex_ = startLast;
-            return false;
-        }
-        emitToken(STATEMENT, startIndex, startRow, startCol);
-        return true;
-    }
-
-    if (assignment()) {
-        if (!matchLiteral(";", true)) {
-            symbolIndex_ = startIndex;
-            row_ = startRow;
-            lastNewLineIndex_ = startLast;
-            return false;
-        }
-        emitToken(STATEMENT, startIndex, startRow, startCol);
-        return true;
-    }
-
-    if (expr()) {
-        if (!matchLiteral(";", true)) {
-            symbolIndex_ = startIndex;
-            row_ = startRow;
-            lastNewLineIndex_ = startLast;
-            return false;
+    // A leading keyword picks the one statement it can start; otherwise only
+    // the declaration, the assignment and the expression are left, and the
+    // first two need a name.
+    std::string_view word = peekWord();
+    bool matched = false;
+    if (word == "if" || word == "while" || word == "do" || word == "for") {
+        if ((word == "if" && ifStmt()) || (word == "while" && whileStmt()) ||
+            (word == "do" && doWhileStmt()) || (word == "for" && forStmt())) {
+            emitToken(STATEMENT, startIndex, startRow, startCol);
+            return true;
         }
+    } else if (word == "return") {
+        matched = returnStmt() && matchLiteral(";", true);
+    } else if (!word.empty() && (varDecl() || assignment())) {
+        matched = matchLiteral(";", true);
+    } else if (startsExpr() && expr()) {
+        matched = matchLiteral(";", true);
+    }
+    if (matched) {
         emitToken(STATEMENT, startIndex, startRow, startCol);
         return true;
     }
@@ -562,10 +633,13 @@ bool Lexer::statement() {
     symbolIndex_ = startIndex;
     row_ = startRow;
     lastNewLineIndex_ = startLast;
+    dropTokensFrom(symbolIndex_);
     return false;
 }
 
 bool Lexer::varDecl() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -576,18 +650,21 @@ bool Lexer::varDecl() {
         symbolIndex_ = startIndex;
         row_ = startRow;
         lastNewLineIndex_ = startLast;
+        dropTokensFrom(symbolIndex_);
         return false;
     }
     auto save = std::tuple<int, int, int>(symbolIndex_, row_, lastNewLineIndex_);
     if (matchLiteral(":", true)) {
         if (!type()) {
             std::tie(symbolIndex_, row_, lastNewLineIndex_) = save;
+            dropTokensFrom(symbolIndex_);
         }
     }
     save = std::tuple<int, int, int>(symbolIndex_, row_, lastNewLineIndex_);
     if (matchLiteral("=", true)) {
         if (!expr()) {
             std::tie(symbolIndex_, row_, lastNewLineIndex_) = save;
+            dropTokensFrom(symbolIndex_);
         }
     }
     emitToken(VAR_DECL, startIndex, startRow, startCol);
@@ -595,6 +672,8 @@ bool Lexer::varDecl() {
 }
 
 bool Lexer::assignment() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -606,12 +685,14 @@ bool Lexer::assignment() {
         symbolIndex_ = startIndex;
         row_ = startRow;
         lastNewLineIndex_ = startLast;
+        dropTokensFrom(symbolIndex_);
         return false;
     }
     if (!commaExpr()) {
         symbolIndex_ = startIndex;
         row_ = startRow;
         lastNewLineIndex_ = startLast;
+        dropTokensFrom(symbolIndex_);
         return false;
     }
     emitToken(ASSIGNMENT, startIndex, startRow, startCol);
@@ -619,6 +700,8 @@ bool Lexer::assignment() {
 }
 
 bool Lexer::ifStmt() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -629,6 +712,7 @@ bool Lexer::ifStmt() {
         symbolIndex_ = startIndex;
         row_ = startRow;
         lastNewLineIndex_ = startLast;
+        dropTokensFrom(symbolIndex_);
         return false;
     }
     while (true) {
@@ -636,6 +720,7 @@ bool Lexer::ifStmt() {
         if (matchKeyword("elif")) {
             if (!expr() || !block()) {
                 std::tie(symbolIndex_, row_, lastNewLineIndex_) = save;
+                dropTokensFrom(symbolIndex_);
                 break;
             }
         } else {
@@ -647,6 +732,8 @@ bool Lexer::ifStmt() {
 }
 
 bool Lexer::whileStmt() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -657,6 +744,7 @@ bool Lexer::whileStmt() {
         symbolIndex_ = startIndex;
         row_ = startRow;
         lastNewLineIndex_ = startLast;
+        dropTokensFrom(symbolIndex_);
         return false;
     }
     emitToken(WHILE_STMT, startIndex, startRow, startCol);
@@ -664,6 +752,8 @@ bool Lexer::whileStmt() {
 }
 
 bool Lexer::doWhileStmt() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -674,12 +764,14 @@ bool Lexer::doWhileStmt() {
         symbolIndex_ = startIndex;
         row_ = startRow;
         lastNewLineIndex_ = startLast;
+        dropTokensFrom(symbolIndex_);
         return false;
     }
     if (!matchKeyword("while") || !expr() || !matchLiteral(";", true)) {
         symbolIndex_ = startIndex;
         row_ = startRow;
         lastNewLineIndex_ = startLast;
+        dropTokensFrom(symbolIndex_);
         return false;
     }
     emitToken(DO_WHILE_STMT, startIndex, startRow, startCol);
@@ -687,6 +779,8 @@ bool Lexer::doWhileStmt() {
 }
 
 bool Lexer::range() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -697,17 +791,20 @@ bool Lexer::range() {
         symbolIndex_ = startIndex;
         row_ = startRow;
         lastNewLineIndex_ = startLast;
+        dropTokensFrom(symbolIndex_);
         return false;
     }
     auto save = std::tuple<int, int, int>(symbolIndex_, row_, lastNewLineIndex_);
     if (expr()) {
     } else {
         std::tie(symbolIndex_, row_, lastNewLineIndex_) = save;
+        dropTokensFrom(symbolIndex_);
     }
     if (!matchLiteral(";", true) || !expr() || !matchLiteral("]", true)) {
         symbolIndex_ = startIndex;
         row_ = startRow;
         lastNewLineIndex_ = startLast;
+        dropTokensFrom(symbolIndex_);
         return false;
     }
     emitToken(RANGE, startIndex, startRow, startCol);
@@ -715,6 +812,8 @@ bool Lexer::range() {
 }
 
 bool Lexer::forStmt() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -725,6 +824,7 @@ bool Lexer::forStmt() {
         symbolIndex_ = startIndex;
         row_ = startRow;
         lastNewLineIndex_ = startLast;
+        dropTokensFrom(symbolIndex_);
         return false;
     }
     emitToken(FOR_STMT, startIndex, startRow, startCol);
@@ -732,6 +832,8 @@ bool Lexer::forStmt() {
 }
 
 bool Lexer::returnStmt() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -742,6 +844,7 @@ bool Lexer::returnStmt() {
         symbolIndex_ = startIndex;
         row_ = startRow;
         lastNewLineIndex_ = startLast;
+        dropTokensFrom(symbolIndex_);
         return false;
     }
     emitToken(RETURN_STMT, startIndex, startRow, startCol);
@@ -749,6 +852,8 @@ bool Lexer::returnStmt() {
 }
 
 bool Lexer::expr() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -761,6 +866,8 @@ bool Lexer::expr() {
 }
 
 bool Lexer::commaExpr() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -769,8 +876,11 @@ bool Lexer::commaExpr() {
     while (true) {
         auto save = std::tuple<int, int, int>(symbolIndex_, row_, lastNewLineIndex_);
         if (matchLiteral(",", true)) {
+            int operand = symbolIndex_;
             if (!logicOr()) {
+                failedOperand_ = operand;
                 std::tie(symbolIndex_, row_, lastNewLineIndex_) = save;
+                dropTokensFrom(symbolIndex_);
                 break;
             }
         } else {
@@ -782,6 +892,8 @@ bool Lexer::commaExpr() {
 }
 
 bool Lexer::logicOr() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -792,6 +904,7 @@ bool Lexer::logicOr() {
         if (matchLiteral("||", true)) {
             if (!logicAnd()) {
                 std::tie(symbolIndex_, row_, lastNewLineIndex_) = save;
+                dropTokensFrom(symbolIndex_);
                 break;
             }
         } else {
@@ -803,6 +916,8 @@ bool Lexer::logicOr() {
 }
 
 bool Lexer::logicAnd() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -813,6 +928,7 @@ bool Lexer::logicAnd() {
         if (matchLiteral("&&", true)) {
             if (!bitOr()) {
                 std::tie(symbolIndex_, row_, lastNewLineIndex_) = save;
+                dropTokensFrom(symbolIndex_);
                 break;
             }
         } else {
@@ -824,6 +940,8 @@ bool Lexer::logicAnd() {
 }
 
 bool Lexer::bitOr() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -834,6 +952,7 @@ bool Lexer::bitOr() {
         if (matchLiteral("|", true)) {
             if (!bitXor()) {
                 std::tie(symbolIndex_, row_, lastNewLineIndex_) = save;
+                dropTokensFrom(symbolIndex_);
                 break;
             }
         } else {
@@ -845,6 +964,8 @@ bool Lexer::bitOr() {
 }
 
 bool Lexer::bitXor() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -855,6 +976,7 @@ bool Lexer::bitXor() {
         if (matchLiteral("^", true)) {
             if (!bitAnd()) {
                 std::tie(symbolIndex_, row_, lastNewLineIndex_) = save;
+                dropTokensFrom(symbolIndex_);
                 break;
             }
         } else {
@@ -866,6 +988,8 @@ bool Lexer::bitXor() {
 }
 
 bool Lexer::bitAnd() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -876,6 +1000,7 @@ bool Lexer::bitAnd() {
         if (matchLiteral("&", true)) {
             if (!equality()) {
                 std::tie(symbolIndex_, row_, lastNewLineIndex_) = save;
+                dropTokensFrom(symbolIndex_);
                 break;
             }
         } else {
@@ -887,6 +1012,8 @@ bool Lexer::bitAnd() {
 }
 
 bool Lexer::equality() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -897,6 +1024,7 @@ bool Lexer::equality() {
         if (matchLiteral("==", true) || matchLiteral("!=", true)) {
             if (!rel()) {
                 std::tie(symbolIndex_, row_, lastNewLineIndex_) = save;
+                dropTokensFrom(symbolIndex_);
                 break;
             }
         } else {
@@ -908,6 +1036,8 @@ bool Lexer::equality() {
 }
 
 bool Lexer::rel() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -919,6 +1049,7 @@ bool Lexer::rel() {
             matchLiteral("<", true) || matchLiteral(">", true)) {
             if (!shift()) {
                 std::tie(symbolIndex_, row_, lastNewLineIndex_) = save;
+                dropTokensFrom(symbolIndex_);
                 break;
             }
         } else {
@@ -930,6 +1061,8 @@ bool Lexer::rel() {
 }
 
 bool Lexer::shift() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -940,6 +1073,7 @@ bool Lexer::shift() {
         if (matchLiteral("<<", true) || matchLiteral(">>", true)) {
             if (!add()) {
                 std::tie(symbolIndex_, row_, lastNewLineIndex_) = save;
+                dropTokensFrom(symbolIndex_);
                 break;
             }
         } else {
@@ -951,6 +1085,8 @@ bool Lexer::shift() {
 }
 
 bool Lexer::add() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -961,6 +1097,7 @@ bool Lexer::add() {
         if (matchLiteral("+", true) || matchLiteral("-", true)) {
             if (!mul()) {
                 std::tie(symbolIndex_, row_, lastNewLineIndex_) = save;
+                dropTokensFrom(symbolIndex_);
                 break;
             }
         } else {
@@ -972,6 +1109,8 @@ bool Lexer::add() {
 }
 
 bool Lexer::mul() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -983,6 +1122,7 @@ bool Lexer::mul() {
             matchLiteral("%", true)) {
             if (!unary()) {
                 std::tie(symbolIndex_, row_, lastNewLineIndex_) = save;
+                dropTokensFrom(symbolIndex_);
                 break;
             }
         } else {
@@ -994,6 +1134,8 @@ bool Lexer::mul() {
 }
 
 bool Lexer::unary() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -1005,11 +1147,13 @@ bool Lexer::unary() {
         matchLiteral("!", true)) {
     } else {
         std::tie(symbolIndex_, row_, lastNewLineIndex_) = save;
+        dropTokensFrom(symbolIndex_);
     }
     if (!primary()) {
         symbolIndex_ = startIndex;
         row_ = startRow;
         lastNewLineIndex_ = startLast;
+        dropTokensFrom(symbolIndex_);
         return false;
     }
     emitToken(UNARY, startIndex, startRow, startCol);
@@ -1017,31 +1161,42 @@ bool Lexer::unary() {
 }
 
 bool Lexer::primary() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
     int startCol = startIndex - lastNewLineIndex_;
     int startLast = lastNewLineIndex_;
 
-    if (literal() || callExpr() || identifier() || arrayLiteral()) {
+    // A name is a call only if '(' follows it.
+    std::string_view word = peekWord();
+    char c = get();
+    bool matched = false;
+    if (word == "true" || word == "false" || c == '"' || c == '\'' || isDigitChar(c)) {
+        matched = literal();
+    } else if (!word.empty()) {
+        matched = (peekAfter(symbolIndex_ + word.size()) == '(' && callExpr()) || identifier();
+    } else if (c == '{') {
+        matched = arrayLiteral();
+    } else if (matchLiteral("(", false)) {
+        matched = expr() && matchLiteral(")", true);
+    }
+    if (matched) {
         emitToken(PRIMARY, startIndex, startRow, startCol);
         return true;
     }
 
-    if (matchLiteral("(", false)) {
-        if (expr() && matchLiteral(")", true)) {
-            emitToken(PRIMARY, startIndex, startRow, startCol);
-            return true;
-        }
-    }
-
     symbolIndex_ = startIndex;
     row_ = startRow;
     lastNewLineIndex_ = startLast;
+    dropTokensFrom(symbolIndex_);
     return false;
 }
 
 bool Lexer::callExpr() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -1052,16 +1207,19 @@ bool Lexer::callExpr() {
         symbolIndex_ = startIndex;
         row_ = startRow;
         lastNewLineIndex_ = startLast;
+        dropTokensFrom(symbolIndex_);
         return false;
     }
     auto save = std::tuple<int, int, int>(symbolIndex_, row_, lastNewLineIndex_);
     if (!argList()) {
         std::tie(symbolIndex_, row_, lastNewLineIndex_) = save;
+        dropTokensFrom(symbolIndex_);
     }
     if (!matchLiteral(")", true)) {
         symbolIndex_ = startIndex;
         row_ = startRow;
         lastNewLineIndex_ = startLast;
+        dropTokensFrom(symbolIndex_);
         return false;
     }
     emitToken(CALL_EXPR, startIndex, startRow, startCol);
@@ -1069,6 +1227,8 @@ bool Lexer::callExpr() {
 }
 
 bool Lexer::argList() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -1077,8 +1237,11 @@ bool Lexer::argList() {
     while (true) {
         auto save = std::tuple<int, int, int>(symbolIndex_, row_, lastNewLineIndex_);
         if (matchLiteral(",", true)) {
-            if (!expr()) {
+            // The comma_expr of the element before has just failed on this
+            // operand, and would again: going on doubles the work per level.
+            if (symbolIndex_ == failedOperand_ || !expr()) {
                 std::tie(symbolIndex_, row_, lastNewLineIndex_) = save;
+                dropTokensFrom(symbolIndex_);
                 break;
             }
         } else {
@@ -1090,6 +1253,8 @@ bool Lexer::argList() {
 }
 
 bool Lexer::arrayLiteral() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -1100,13 +1265,17 @@ bool Lexer::arrayLiteral() {
         symbolIndex_ = startIndex;
         row_ = startRow;
         lastNewLineIndex_ = startLast;
+        dropTokensFrom(symbolIndex_);
         return false;
     }
     while (true) {
         auto save = std::tuple<int, int, int>(symbolIndex_, row_, lastNewLineIndex_);
         if (matchLiteral(",", true)) {
-            if (!expr()) {
+            // The comma_expr of the element before has just failed on this
+            // operand, and would again: going on doubles the work per level.
+            if (symbolIndex_ == failedOperand_ || !expr()) {
                 std::tie(symbolIndex_, row_, lastNewLineIndex_) = save;
+                dropTokensFrom(symbolIndex_);
                 break;
             }
         } else {
@@ -1117,6 +1286,7 @@ bool Lexer::arrayLiteral() {
         symbolIndex_ = startIndex;
         row_ = startRow;
         lastNewLineIndex_ = startLast;
+        dropTokensFrom(symbolIndex_);
         return false;
     }
     emitToken(ARRAY_LITERAL, startIndex, startRow, startCol);
@@ -1124,23 +1294,32 @@ bool Lexer::arrayLiteral() {
 }
 
 bool Lexer::literal() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
     int startCol = startIndex - lastNewLineIndex_;
     int startLast = lastNewLineIndex_;
-    if (floatLiteral() || integerLiteral() || stringLiteral() || charLiteral() ||
-        boolLiteral()) {
+    char c = get();
+    bool matched = isDigitChar(c) ? numberLiteral(true)
+                 : c == '"'       ? stringLiteral()
+                 : c == '\''      ? charLiteral()
+                                  : boolLiteral();
+    if (matched) {
         emitToken(LITERAL, startIndex, startRow, startCol);
         return true;
     }
     symbolIndex_ = startIndex;
     row_ = startRow;
     lastNewLineIndex_ = startLast;
+    dropTokensFrom(symbolIndex_);
     return false;
 }
 
 bool Lexer::program() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -1151,9 +1330,11 @@ bool Lexer::program() {
     }
     skipWhitespace();
     if (symbolIndex_ != static_cast<int>(program_.size())) {
+        stop(PARSE_SYNTAX_ERROR, "expected a repr or an arrow block");
         symbolIndex_ = startIndex;
         row_ = startRow;
         lastNewLineIndex_ = startLast;
+        dropTokensFrom(symbolIndex_);
         return false;
     }
     emitToken(PROGRAM, startIndex, startRow, startCol);
@@ -1161,22 +1342,27 @@ bool Lexer::program() {
 }
 
 bool Lexer::topLevelDecl() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
     int startCol = startIndex - lastNewLineIndex_;
     int startLast = lastNewLineIndex_;
-    if (reprFunc() || arrowBlock()) {
+    if (get() == '#' ? arrowBlock() : reprFunc()) {
         emitToken(TOPLEVEL_DECL, startIndex, startRow, startCol);
         return true;
     }
     symbolIndex_ = startIndex;
     row_ = startRow;
     lastNewLineIndex_ = startLast;
+    dropTokensFrom(symbolIndex_);
     return false;
 }
 
 bool Lexer::reprFunc() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -1187,28 +1373,33 @@ bool Lexer::reprFunc() {
         symbolIndex_ = startIndex;
         row_ = startRow;
         lastNewLineIndex_ = startLast;
+        dropTokensFrom(symbolIndex_);
         return false;
     }
     auto save = std::tuple<int, int, int>(symbolIndex_, row_, lastNewLineIndex_);
     if (!paramList()) {
         std::tie(symbolIndex_, row_, lastNewLineIndex_) = save;
+        dropTokensFrom(symbolIndex_);
     }
     if (!matchLiteral(")", true)) {
         symbolIndex_ = startIndex;
         row_ = startRow;
         lastNewLineIndex_ = startLast;
+        dropTokensFrom(symbolIndex_);
         return false;
     }
     save = std::tuple<int, int, int>(symbolIndex_, row_, lastNewLineIndex_);
     if (matchLiteral("->", true)) {
         if (!returnTypeList()) {
             std::tie(symbolIndex_, row_, lastNewLineIndex_) = save;
+            dropTokensFrom(symbolIndex_);
         }
     }
     if (!block()) {
         symbolIndex_ = startIndex;
         row_ = startRow;
         lastNewLineIndex_ = startLast;
+        dropTokensFrom(symbolIndex_);
         return false;
     }
     emitToken(REPR_FUNC, startIndex, startRow, startCol);
@@ -1216,6 +1407,8 @@ bool Lexer::reprFunc() {
 }
 
 bool Lexer::paramList() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -1226,6 +1419,7 @@ bool Lexer::paramList() {
         if (matchLiteral(",", true)) {
             if (!param()) {
                 std::tie(symbolIndex_, row_, lastNewLineIndex_) = save;
+                dropTokensFrom(symbolIndex_);
                 break;
             }
         } else {
@@ -1237,6 +1431,8 @@ bool Lexer::paramList() {
 }
 
 bool Lexer::param() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -1246,6 +1442,7 @@ bool Lexer::param() {
         symbolIndex_ = startIndex;
         row_ = startRow;
         lastNewLineIndex_ = startLast;
+        dropTokensFrom(symbolIndex_);
         return false;
     }
     emitToken(PARAM, startIndex, startRow, startCol);
@@ -1253,6 +1450,8 @@ bool Lexer::param() {
 }
 
 bool Lexer::returnTypeList() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -1263,6 +1462,7 @@ bool Lexer::returnTypeList() {
         if (matchLiteral(",", true)) {
             if (!type()) {
                 std::tie(symbolIndex_, row_, lastNewLineIndex_) = save;
+                dropTokensFrom(symbolIndex_);
                 break;
             }
         } else {
@@ -1274,6 +1474,8 @@ bool Lexer::returnTypeList() {
 }
 
 bool Lexer::arrowBlock() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -1283,11 +1485,13 @@ bool Lexer::arrowBlock() {
     auto save = std::tuple<int, int, int>(symbolIndex_, row_, lastNewLineIndex_);
     if (!identifier()) {
         std::tie(symbolIndex_, row_, lastNewLineIndex_) = save;
+        dropTokensFrom(symbolIndex_);
     }
     if (!matchLiteral("{", true)) {
         symbolIndex_ = startIndex;
         row_ = startRow;
         lastNewLineIndex_ = startLast;
+        dropTokensFrom(symbolIndex_);
         return false;
     }
     while (arrowLine()) {
@@ -1296,6 +1500,7 @@ bool Lexer::arrowBlock() {
         symbolIndex_ = startIndex;
         row_ = startRow;
         lastNewLineIndex_ = startLast;
+        dropTokensFrom(symbolIndex_);
         return false;
     }
     emitToken(ARROW_BLOCK, startIndex, startRow, startCol);
@@ -1303,6 +1508,8 @@ bool Lexer::arrowBlock() {
 }
 
 bool Lexer::arrowLine() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -1313,6 +1520,7 @@ bool Lexer::arrowLine() {
         symbolIndex_ = startIndex;
         row_ = startRow;
         lastNewLineIndex_ = startLast;
+        dropTokensFrom(symbolIndex_);
         return false;
     }
     emitToken(ARROW_LINE, startIndex, startRow, startCol);
@@ -1320,6 +1528,8 @@ bool Lexer::arrowLine() {
 }
 
 bool Lexer::arrowNode() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -1327,15 +1537,19 @@ bool Lexer::arrowNode() {
     int startLast = lastNewLineIndex_;
     if (matchKeyword("start") || matchKeyword("end") || identifier()) {
         emitToken(ARROW_NODE, startIndex, startRow, startCol);
+        tokens_.back().symbol = symbols_.intern(tokens_.back().lexeme);
         return true;
     }
     symbolIndex_ = startIndex;
     row_ = startRow;
     lastNewLineIndex_ = startLast;
+    dropTokensFrom(symbolIndex_);
     return false;
 }
 
 bool Lexer::arrowOp() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -1350,6 +1564,7 @@ bool Lexer::arrowOp() {
             symbolIndex_ = startIndex;
             row_ = startRow;
             lastNewLineIndex_ = startLast;
+            dropTokensFrom(symbolIndex_);
             return false;
         }
         emitToken(ARROW_OP, startIndex, startRow, startCol);
@@ -1359,6 +1574,8 @@ bool Lexer::arrowOp() {
 }
 
 bool Lexer::literalList() {
+    Rule rule(*this);
+    if (!rule.entered) return false;
     skipWhitespace();
     int startIndex = symbolIndex_;
     int startRow = row_;
@@ -1369,6 +1586,7 @@ bool Lexer::literalList() {
         if (matchLiteral(",", true)) {
             if (!literal()) {
                 std::tie(symbolIndex_, row_, lastNewLineIndex_) = save;
+                dropTokensFrom(symbolIndex_);
                 break;
             }
         } else {
@@ -0,0 +1,67 @@
+#include "../include/Linker.h"
+
+void Linker::add(const Program &from, const ReprFunc &func) {
+    ReprFunc out;
+    out.name = func.name;
+    out.symbol = symbol(from, func.symbol);
+    out.row = func.row;
+    out.column = func.column;
+    for (const auto &param : func.params) {
+        out.params.push_back({param.name, symbol(from, param.symbol), param.type});
+    }
+    out.returnTypes = func.returnTypes;
+    out.body = clone(from, func.body);
+    unit_.functions.push_back(std::move(out));
+}
+
+void Linker::add(const Program &from, const ArrowBlock &block) {
+    ArrowBlock out;
+    out.name = block.name;
+    out.row = block.row;
+    out.column = block.column;
+    for (const auto &edge : block.edges) {
+        out.edges.push_back(edge);
+        out.edges.back().fromSymbol = symbol(from, edge.fromSymbol);
+        out.edges.back().toSymbol = symbol(from, edge.toSymbol);
+    }
+    unit_.arrows.push_back(std::move(out));
+}
+
+uint32_t Linker::symbol(const Program &from, uint32_t id) {
+    return id == Interner::NONE ? id : unit_.symbols.intern(from.symbols.name(id));
+}
+
+ExprPtr Linker::clone(const Program &from, const Expr &expr) {
+    auto out = std::make_unique<Expr>();
+    out->kind = expr.kind;
+    out->row = expr.row;
+    out->column = expr.column;
+    out->op = expr.op;
+    out->value = expr.value;
+    out->name = expr.name;
+    out->symbol = symbol(from, expr.symbol);
+    for (const auto &operand : expr.operands) {
+        out->operands.push_back(operand ? clone(from, *operand) : nullptr);
+    }
+    return out;
+}
+
+Block Linker::clone(const Program &from, const Block &block) {
+    Block out;
+    for (const auto &stmt : block) {
+        auto copy = std::make_unique<Stmt>();
+        copy->kind = stmt->kind;
+        copy->row = stmt->row;
+        copy->column = stmt->column;
+        copy->name = stmt->name;
+        copy->symbol = symbol(from, stmt->symbol);
+        copy->hasType = stmt->hasType;
+        copy->type = stmt->type;
+        for (const auto &expr : stmt->exprs) {
+            copy->exprs.push_back(expr ? clone(from, *expr) : nullptr);
+        }
+        for (const auto &body : stmt->blocks) copy->blocks.push_back(clone(from, body));
+        out.push_back(std::move(copy));
+    }
+    return out;
+}
@@ -0,0 +1,119 @@
+#include "../include/MemoCache.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+const uint32_t kFirstEntries = 16;
+}  // namespace
+
+MemoCache::MemoCache(uint32_t keySlots, uint32_t valueSlots, uint32_t capacity)
+    : keySlots_(keySlots), valueSlots_(valueSlots), capacity_(capacity) {}
+
+const Slot *MemoCache::find(const Slot *key) {
+    uint32_t entry = table_.empty() ? NONE : table_[probe(key, hash(key))];
+    if (entry == NONE) {
+        ++misses_;
+        return nullptr;
+    }
+    ++hits_;
+    referenced_[entry] = 1;
+    return values_.data() + static_cast<size_t>(entry) * valueSlots_;
+}
+
+const Slot *MemoCache::peek(const Slot *key) const {
+    uint32_t entry = table_.empty() ? NONE : table_[probe(key, hash(key))];
+    return entry == NONE ? nullptr : values_.data() + static_cast<size_t>(entry) * valueSlots_;
+}
+
+void MemoCache::insert(const Slot *key, const Slot *value) {
+    if (size_ == allocated_ && allocated_ < capacity_) grow();
+    uint64_t h = hash(key);
+    uint32_t bucket = probe(key, h);
+    uint32_t entry = table_[bucket];
+    if (entry == NONE) {
+        if (size_ < capacity_) {
+            entry = size_++;
+        } else {
+            while (referenced_[hand_]) {
+                referenced_[hand_] = 0;
+                hand_ = (hand_ + 1) % capacity_;
+            }
+            entry = hand_;
+            hand_ = (hand_ + 1) % capacity_;
+            erase(entry);
+            ++evictions_;
+            bucket = probe(key, h);
+        }
+        std::memcpy(keys_.data() + static_cast<size_t>(entry) * keySlots_, key,
+                    keySlots_ * sizeof(Slot));
+        hashes_[entry] = h;
+        table_[bucket] = entry;
+    }
+    std::memcpy(values_.data() + static_cast<size_t>(entry) * valueSlots_, value,
+                valueSlots_ * sizeof(Slot));
+    referenced_[entry] = 1;
+}
+
+void MemoCache::clear() { *this = MemoCache(keySlots_, valueSlots_, capacity_); }
+
+// Doubles the entry arrays, at most to the capacity, and rebuilds the table
+// at twice as many buckets as entries.
+void MemoCache::grow() {
+    allocated_ = std::min(capacity_, std::max(kFirstEntries, allocated_ * 2));
+    keys_.resize(static_cast<size_t>(allocated_) * keySlots_);
+    values_.resize(static_cast<size_t>(allocated_) * valueSlots_);
+    hashes_.resize(allocated_);
+    referenced_.resize(allocated_);
+    uint32_t buckets = 16;
+    while (buckets < allocated_ * 2) buckets *= 2;
+    table_.assign(buckets, NONE);
+    uint32_t mask = buckets - 1;
+    for (uint32_t entry = 0; entry < size_; ++entry) {
+        uint32_t bucket = static_cast<uint32_t>(hashes_[entry]) & mask;
+        while (table_[bucket] != NONE) bucket = (bucket + 1) & mask;
+        table_[bucket] = entry;
+    }
+}
+
+uint64_t MemoCache::hash(const Slot *key) const {
+    uint64_t h = 0x9e3779b97f4a7c15ull;
+    for (uint32_t i = 0; i < keySlots_; ++i) {
+        uint64_t word;
+        std::memcpy(&word, key + i, sizeof(word));
+        h = (h ^ word) * 0xbf58476d1ce4e5b9ull;
+        h ^= h >> 31;
+    }
+    return h;
+}
+
+// Returns the bucket holding `key`, or the free bucket where it would go.
+uint32_t MemoCache::probe(const Slot *key, uint64_t hash) const {
+    uint32_t mask = static_cast<uint32_t>(table_.size() - 1);
+    for (uint32_t bucket = static_cast<uint32_t>(hash) & mask;; bucket = (bucket + 1) & mask) {
+        uint32_t entry = table_[bucket];
+        if (entry == NONE ||
+            (hashes_[entry] == hash &&
+             std::memcmp(keys_.data() + static_cast<size_t>(entry) * keySlots_, key,
+                         keySlots_ * sizeof(Slot)) == 0)) {
+            return bucket;
+        }
+    }
+}
+
+// Removes `entry` from the table, shifting later members of its probe run
+// back so lookups never stop at the hole.
+void MemoCache::erase(uint32_t entry) {
+    uint32_t mask = static_cast<uint32_t>(table_.size() - 1);
+    uint32_t hole = static_cast<uint32_t>(hashes_[entry]) & mask;
+    while (table_[hole] != entry) hole = (hole + 1) & mask;
+    table_[hole] = NONE;
+    for (uint32_t next = (hole + 1) & mask; table_[next] != NONE; next = (next + 1) & mask) {
+        uint32_t home = static_cast<uint32_t>(hashes_[table_[next]]) & mask;
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            table_[hole] = table_[next];
+            table_[next] = NONE;
+            hole = next;
+        }
+    }
+}
@@ -0,0 +1,83 @@
+#include "../include/Module.h"
+
+#include <cmath>
+#include <cstring>
+
+uint32_t elementSize(VALUE_TYPE type) {
+    switch (type) {
+        case VALUE_I8:
+        case VALUE_BOOL: return 1;
+        case VALUE_I16: return 2;
+        case VALUE_I32:
+        case VALUE_F32:
+        case VALUE_CHAR: return 4;
+        default: return 8;
+    }
+}
+
+uint32_t slotCount(const TypeRef &type) {
+    if (type.arraySize == 0) return 1;
+    return (type.arraySize * elementSize(type.element) + sizeof(Slot) - 1) / sizeof(Slot);
+}
+
+Slot loadElement(const void *base, VALUE_TYPE type, size_t index) {
+    const unsigned char *p = static_cast<const unsigned char *>(base) +
+                             index * elementSize(type);
+    Slot s{};
+    switch (type) {
+        case VALUE_I8: s.i = *reinterpret_cast<const int8_t *>(p); break;
+        case VALUE_BOOL: s.i = *reinterpret_cast<const uint8_t *>(p); break;
+        case VALUE_I16: s.i = *reinterpret_cast<const int16_t *>(p); break;
+        case VALUE_I32: s.i = *reinterpret_cast<const int32_t *>(p); break;
+        case VALUE_CHAR: s.i = *reinterpret_cast<const uint32_t *>(p); break;
+        case VALUE_F32: s.f = *reinterpret_cast<const float *>(p); break;
+        case VALUE_F64: s.f = *reinterpret_cast<const double *>(p); break;
+        default: std::memcpy(&s, p, sizeof(Slot)); break;
+    }
+    return s;
+}
+
+void storeElement(void *base, VALUE_TYPE type, size_t index, Slot value) {
+    unsigned char *p = static_cast<unsigned char *>(base) + index * elementSize(type);
+    switch (type) {
+        case VALUE_I8: *reinterpret_cast<int8_t *>(p) = static_cast<int8_t>(value.i); break;
+        case VALUE_BOOL: *reinterpret_cast<uint8_t *>(p) = value.i != 0; break;
+        case VALUE_I16: *reinterpret_cast<int16_t *>(p) = static_cast<int16_t>(value.i); break;
+        case VALUE_I32: *reinterpret_cast<int32_t *>(p) = static_cast<int32_t>(value.i); break;
+        case VALUE_CHAR: *reinterpret_cast<uint32_t *>(p) = static_cast<uint32_t>(value.i); break;
+        case VALUE_F32: *reinterpret_cast<float *>(p) = static_cast<float>(value.f); break;
+        case VALUE_F64: *reinterpret_cast<double *>(p) = value.f; break;
+        default: std::memcpy(p, &value, sizeof(Slot)); break;
+    }
+}
+
+Slot convertSlot(VALUE_TYPE from, VALUE_TYPE to, Slot value) {
+    Slot out{};
+    if (isFloating(to)) {
+        double d = isFloating(from) ? value.f : static_cast<double>(value.i);
+        out.f = to == VALUE_F32 ? static_cast<float>(d) : d;
+    } else if (to == VALUE_BOOL) {
+        out.i = isFloating(from) ? value.f != 0.0 : value.i != 0;
+    } else if (isFloating(from)) {
+        out.i = std::isfinite(value.f) ? wrapInteger(to, static_cast<int64_t>(value.f)) : 0;
+    } else {
+        out.i = wrapInteger(to, value.i);
+    }
+    return out;
+}
+
+Slot slotFromValue(const Value &value) {
+    Slot s{};
+    if (isFloating(value.type)) {
+        s.f = value.f;
+    } else {
+        s.i = value.i;
+    }
+    return s;
+}
+
+Value valueFromSlot(VALUE_TYPE type, Slot slot) {
+    if (type == VALUE_STRINGA) return makeString(std::string(stringView(slot)));
+    if (isFloating(type)) return makeFloat(type, slot.f);
+    return makeInteger(type, slot.i);
+}
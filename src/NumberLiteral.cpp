@@ -0,0 +1,65 @@
+#include "../include/NumberLiteral.h"
+
+#include <charconv>
+#include <cstring>
+#include <limits>
+
+namespace {
+bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+// Eight ASCII digits loaded little-endian: each byte is 0x30..0x39.
+bool eightDigits(uint64_t chunk) {
+    return ((chunk & 0xF0F0F0F0F0F0F0F0ull) |
+            (((chunk + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) ==
+           0x3333333333333333ull;
+}
+
+// Folds the eight digits pairwise into 2-, 4- and finally one 8-digit number.
+uint64_t parseEightDigits(uint64_t chunk) {
+    chunk -= 0x3030303030303030ull;
+    chunk = chunk * 10 + (chunk >> 8);
+    chunk = ((chunk & 0x000000FF000000FFull) * (100 + (1000000ull << 32)) +
+             ((chunk >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32))) >> 32;
+    return chunk;
+}
+#endif
+}  // namespace
+
+NumberLiteral scanNumber(std::string_view text) {
+    NumberLiteral out;
+    const uint64_t limit = std::numeric_limits<int64_t>::max();
+    uint64_t value = 0;
+    size_t i = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    while (i + 8 <= text.size()) {
+        uint64_t chunk;
+        std::memcpy(&chunk, text.data() + i, sizeof(chunk));
+        if (!eightDigits(chunk)) break;
+        uint64_t digits = parseEightDigits(chunk);
+        if (value > (limit - digits) / 100000000) out.inRange = false;
+        value = value * 100000000 + digits;
+        i += 8;
+    }
+#endif
+    for (; i < text.size() && isDigit(text[i]); ++i) {
+        uint64_t digit = static_cast<uint64_t>(text[i] - '0');
+        if (value > (limit - digit) / 10) out.inRange = false;
+        value = value * 10 + digit;
+    }
+    if (i == 0) return out;
+    out.length = i;
+    out.integer = static_cast<int64_t>(value);
+    if (i + 1 < text.size() && text[i] == '.' && isDigit(text[i + 1])) {
+        // Correct rounding needs every digit, so the fraction is decoded by
+        // from_chars from the start of the literal.
+        out.type = FLOAT_LITERAL;
+        out.inRange = true;
+        auto res = std::from_chars(text.data(), text.data() + text.size(), out.real,
+                                   std::chars_format::fixed);
+        out.length = static_cast<size_t>(res.ptr - text.data());
+        if (res.ec != std::errc()) out.inRange = false;
+        out.integer = 0;
+    }
+    return out;
+}
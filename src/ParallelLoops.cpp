@@ -0,0 +1,237 @@
+#include "../include/ParallelLoops.h"
+
+#include "../include/BinaryKernels.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+// Wrapping integer sums and products give the same result in any grouping.
+// Float ones do not, and the chunks regroup them, so a float accumulator
+// keeps its loop sequential.
+bool reducible(VALUE_TYPE type) {
+    switch (type) {
+        case VALUE_I8:
+        case VALUE_I16:
+        case VALUE_I32:
+        case VALUE_I64: return true;
+        default: return false;
+    }
+}
+
+// Frame accesses of one loop body in execution order. `must_` holds the
+// slots written on every path so far in the current iteration; a read of any
+// other slot sees a value from before the iteration.
+class BodyScan {
+ public:
+    BodyScan(const Function &fn, const Node &loop)
+        : fn_(fn),
+          loopSlot_(static_cast<uint32_t>(loop.slot)),
+          must_(fn.frameSlots, 0),
+          exposed_(fn.frameSlots, 0),
+          read_(fn.frameSlots, 0),
+          written_(fn.frameSlots, 0),
+          updated_(fn.frameSlots, 0) {
+        must_[loopSlot_] = 1;
+    }
+
+    bool scan(int32_t body, ParallelLoop &plan) {
+        statement(body);
+        if (!ok_) return false;
+        for (uint32_t slot = 0; slot < fn_.frameSlots; ++slot) {
+            if (slot >= loopSlot_) {
+                // Declared in the body: private unless one iteration reads what
+                // another wrote.
+                if (exposed_[slot] && written_[slot]) return false;
+            } else if (written_[slot]) {
+                return false;
+            } else if (updated_[slot]) {
+                if (read_[slot]) return false;
+                plan.reductions.push_back(reductions_[slot]);
+            }
+        }
+        return true;
+    }
+
+ private:
+    void read(int32_t slot) {
+        if (!must_[slot]) exposed_[slot] = 1;
+        read_[slot] = 1;
+    }
+
+    void write(int32_t slot) {
+        written_[slot] = 1;
+        must_[slot] = 1;
+    }
+
+    // Code that may not run: its reads count, its writes are not certain.
+    void maybe(int32_t index, bool isStatement) {
+        std::vector<uint8_t> saved = must_;
+        if (isStatement) {
+            statement(index);
+        } else {
+            expr(index);
+        }
+        must_ = std::move(saved);
+    }
+
+    // Operands of the tree of `op` nodes of `type` rooted at `index`.
+    void operands(int32_t index, OPERATOR op, VALUE_TYPE type, std::vector<int32_t> &out) {
+        const Node &n = fn_.nodes[index];
+        if (n.kind == NODE_BINARY && n.op == op && n.type == type && n.from == type) {
+            operands(n.a, op, type, out);
+            operands(n.b, op, type, out);
+        } else {
+            out.push_back(index);
+        }
+    }
+
+    // `slot = slot op x op y ...` on an outer scalar, with x, y, ... not
+    // reading `slot`.
+    bool update(const Node &store) {
+        if (static_cast<uint32_t>(store.slot) >= loopSlot_ || store.length) return false;
+        const Node &value = fn_.nodes[store.a];
+        if (value.kind != NODE_BINARY || (value.op != OP_ADD && value.op != OP_MUL) ||
+            value.type != store.type || value.from != store.type || !reducible(store.type)) {
+            return false;
+        }
+        std::vector<int32_t> terms;
+        operands(store.a, value.op, value.type, terms);
+        auto self = std::find_if(terms.begin(), terms.end(), [&](int32_t index) {
+            const Node &n = fn_.nodes[index];
+            return n.kind == NODE_LOAD && n.slot == store.slot;
+        });
+        if (self == terms.end()) return false;
+        terms.erase(self);
+        Reduction &reduction = reductions_[store.slot];
+        if (updated_[store.slot] && reduction.op != value.op) {
+            written_[store.slot] = 1;
+        }
+        updated_[store.slot] = 1;
+        reduction.slot = static_cast<uint32_t>(store.slot);
+        reduction.type = store.type;
+        reduction.op = value.op;
+        // value.binary may take its rhs in a narrower type, as in `acc + 1`.
+        reduction.combine = findBinaryKernel(value.op, store.type, store.type);
+        reduction.identity.i = value.op == OP_ADD ? 0 : 1;
+        for (int32_t term : terms) expr(term);
+        return true;
+    }
+
+    void expr(int32_t index) {
+        const Node &n = fn_.nodes[index];
+        switch (n.kind) {
+            case NODE_CONST: break;
+            case NODE_LOAD:
+            case NODE_ARRAY_LOAD: read(n.slot); break;
+            case NODE_CONVERT:
+            case NODE_UNARY: expr(n.a); break;
+            case NODE_BINARY:
+            case NODE_CONCAT:
+                expr(n.a);
+                expr(n.b);
+                break;
+            case NODE_AND:
+            case NODE_OR:
+                expr(n.a);
+                maybe(n.b, false);
+                break;
+            case NODE_CALL:
+                for (uint32_t i = 0; i < n.count; ++i) expr(fn_.lists[n.first + i]);
+                break;
+            case NODE_ARRAY_LITERAL:
+            case NODE_ARRAY_CALL:
+                for (uint32_t i = 0; i < n.count; ++i) expr(fn_.lists[n.first + i]);
+                write(n.slot);
+                break;
+            case NODE_ARRAY_BINARY:
+                expr(n.a);
+                expr(n.b);
+                write(n.slot);
+                break;
+            case NODE_ARRAY_CONVERT:
+                expr(n.a);
+                write(n.slot);
+                break;
+            default: ok_ = false; break;
+        }
+    }
+
+    void statement(int32_t index) {
+        const Node &n = fn_.nodes[index];
+        switch (n.kind) {
+            case NODE_STORE:
+                if (!update(n)) {
+                    expr(n.a);
+                    write(n.slot);
+                }
+                break;
+            case NODE_ARRAY_STORE:
+                expr(n.a);
+                write(n.slot);
+                break;
+            case NODE_EVAL: expr(n.a); break;
+            case NODE_IF:
+                // Only the first condition always runs.
+                for (uint32_t i = 0; i < n.count; i += 2) {
+                    if (i == 0) {
+                        expr(fn_.lists[n.first]);
+                    } else {
+                        maybe(fn_.lists[n.first + i], false);
+                    }
+                    maybe(fn_.lists[n.first + i + 1], true);
+                }
+                break;
+            case NODE_WHILE:
+                expr(n.a);
+                maybe(n.b, true);
+                break;
+            case NODE_DO_WHILE:
+                statement(n.b);
+                expr(n.a);
+                break;
+            case NODE_FOR:
+                expr(n.a);
+                if (n.b >= 0) expr(n.b);
+                expr(n.c);
+                written_[n.slot] = 1;
+                {
+                    std::vector<uint8_t> saved = must_;
+                    must_[n.slot] = 1;
+                    statement(n.d);
+                    must_ = std::move(saved);
+                }
+                break;
+            case NODE_BLOCK:
+                for (uint32_t i = 0; i < n.count; ++i) statement(fn_.lists[n.first + i]);
+                break;
+            default: ok_ = false; break;  // returns leave the loop early
+        }
+    }
+
+    const Function &fn_;
+    uint32_t loopSlot_;
+    std::vector<uint8_t> must_, exposed_, read_, written_, updated_;
+    std::unordered_map<int32_t, Reduction> reductions_;
+    bool ok_ = true;
+};
+}  // namespace
+
+void analyseParallelLoops(Module &module) {
+    for (auto &fn : module.functions) {
+        fn.parallelLoops.clear();
+        for (size_t i = 0; i < fn.nodes.size(); ++i) {
+            const Node &n = fn.nodes[i];
+            // Float counters accumulate rounding, so iteration k cannot be
+            // computed on its own.
+            if (n.kind != NODE_FOR || isFloating(n.from) || n.from == VALUE_CHAR ||
+                n.from == VALUE_BOOL) {
+                continue;
+            }
+            ParallelLoop plan;
+            plan.node = static_cast<int32_t>(i);
+            if (BodyScan(fn, n).scan(n.d, plan)) fn.parallelLoops.push_back(std::move(plan));
+        }
+    }
+}
@@ -0,0 +1,230 @@
+#include "../include/ParseFuzzer.h"
+
+#include "../include/Lexer.h"
+#include "GrammarTables.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <unordered_set>
+
+namespace {
+const char *const kSeeds[] = {
+    "repr f(x:i32) -> i32 {\n  return x;\n}\n",
+    "repr f(x:i32, y:i32) -> i32 {\n  t: i32 = (x + y) * f(x, y - 1);\n  return t;\n}\n",
+    "repr f(n:i32) -> i32 {\n  if n > 1 {\n    n = 1;\n  } elif n < 0 {\n    n = 0;\n  }\n"
+    "  while n {\n    n = n - 1;\n  }\n  return n;\n}\n",
+    "repr f(a:i32[4]) -> i32[4] {\n  for i in [0; 1; 4] {\n    a = {1, 2, 3, i};\n  }\n"
+    "  do {\n    a = a;\n  } while false;\n  return a;\n}\n",
+    "repr f(x:i32, c:char, s:stringa) -> i32 {\n  return x;\n}\n"
+    "#b {\n  start -> f;\n  f -(1, 'c', \"s\")> end;\n}\n",
+};
+
+// Pieces that open or continue the constructs the rules can backtrack over.
+const char *const kFragments[] = {
+    "(", ")", "f(", "[", "]", "{", "}", "a", "1", "1.5", "'c'", "\"s\"", "true",
+    ", ", " + ", " * ", " < ", " == ", " && ", "-", "!", " = ", ": i32", ";",
+    "if a {", "} elif a {", "while a {", "do {", "} while a;", "for i in [0; 1; a] {",
+    "return ", "x: i32 = ", "x = ", "a[", "{1, 2}", "repr f() {", "repr f(x:i32) -> i32 {",
+    "#b {", "start -> f;", "f -(1)> end;", "\n",
+};
+
+uint64_t hashText(const std::string &text) {
+    uint64_t hash = 1469598103934665603ull;
+    for (unsigned char c : text) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+class Mutator {
+ public:
+    explicit Mutator(uint64_t seed) : random_(seed) {}
+
+    size_t below(size_t n) {
+        return n ? std::uniform_int_distribution<size_t>(0, n - 1)(random_) : 0;
+    }
+
+    // `donor` supplies the text of a splice.
+    std::string mutate(std::string text, const std::string &donor) {
+        size_t at = below(text.size() + 1);
+        switch (below(7)) {
+            case 0: {
+                // A terminal of the grammar, as the table parser knows them.
+                size_t keywords = std::size(grammar::kKeywords);
+                size_t pick = below(keywords + std::size(grammar::kPunctuators));
+                std::string word = pick < keywords ? grammar::kKeywords[pick].text
+                                                   : grammar::kPunctuators[pick - keywords].text;
+                text.insert(at, " " + word + " ");
+                break;
+            }
+            case 1: text.insert(at, kFragments[below(std::size(kFragments))]); break;
+            case 2: {
+                static const char *const kPairs[][2] = {
+                    {"(", ")"}, {"f(", ")"}, {"{", "}"}, {"[", "]"}, {"if a {", "}"}};
+                const auto &pair = kPairs[below(std::size(kPairs))];
+                size_t end = at + below(text.size() - at + 1);
+                text.insert(end, pair[1]);
+                text.insert(at, pair[0]);
+                break;
+            }
+            case 3: {
+                // Repeating a piece nests whatever it opens once more.
+                size_t length = 1 + below(std::min<size_t>(16, text.size() - at + 1));
+                if (at < text.size()) text.insert(at, text.substr(at, length));
+                break;
+            }
+            case 4: {
+                size_t from = below(donor.size() + 1);
+                text.insert(at, donor.substr(from, 1 + below(32)));
+                break;
+            }
+            case 5: {
+                size_t length = 1 + below(8);
+                if (at < text.size()) text.erase(at, length);
+                break;
+            }
+            default: {
+                // Swap the piece for a run of one fragment.
+                const char *fragment = kFragments[below(std::size(kFragments))];
+                size_t repeat = 1 + below(8);
+                std::string run;
+                for (size_t i = 0; i < repeat; ++i) run += fragment;
+                text.insert(at, run);
+                break;
+            }
+        }
+        return text;
+    }
+
+ private:
+    std::mt19937_64 random_;
+};
+}  // namespace
+
+double FuzzCase::perByte() const {
+    return static_cast<double>(ruleCalls) / static_cast<double>(std::max<size_t>(text.size(), 1));
+}
+
+uint64_t measureRuleCalls(const std::string &text, uint64_t limit) {
+    Lexer lexer(text);
+    ParseOptions options;
+    options.maxRuleCalls = limit;
+    options.maxDepth = 0;  // deep nesting is work like any other
+    lexer.setOptions(options);
+    lexer.parseProgram();
+    return lexer.ruleCalls();
+}
+
+std::vector<FuzzCase> fuzzParser(const std::vector<std::string> &seeds,
+                                 const FuzzOptions &options) {
+    std::vector<FuzzCase> population;
+    std::unordered_set<std::string> seen;
+    auto consider = [&](std::string text) {
+        if (text.empty() || text.size() > options.maxBytes || !seen.insert(text).second) return;
+        FuzzCase candidate;
+        candidate.ruleCalls = measureRuleCalls(text, options.maxRuleCalls);
+        candidate.text = std::move(text);
+        if (population.size() < options.population) {
+            population.push_back(std::move(candidate));
+            return;
+        }
+        auto worst = std::min_element(
+            population.begin(), population.end(),
+            [](const FuzzCase &a, const FuzzCase &b) { return a.perByte() < b.perByte(); });
+        if (candidate.perByte() > worst->perByte()) *worst = std::move(candidate);
+    };
+    for (const auto &seed : seeds) consider(seed);
+    for (const char *seed : kSeeds) consider(seed);
+    if (population.empty()) return population;
+
+    Mutator mutator(options.seed);
+    for (uint64_t i = 0; i < options.iterations; ++i) {
+        // The better of two picks, so good inputs breed more without
+        // crowding the rest out.
+        const FuzzCase &a = population[mutator.below(population.size())];
+        const FuzzCase &b = population[mutator.below(population.size())];
+        std::string child = (a.perByte() >= b.perByte() ? a : b).text;
+        const std::string &donor = population[mutator.below(population.size())].text;
+        for (size_t steps = 1 + mutator.below(3); steps; --steps) {
+            child = mutator.mutate(std::move(child), donor);
+        }
+        consider(std::move(child));
+    }
+    std::sort(population.begin(), population.end(),
+              [](const FuzzCase &a, const FuzzCase &b) { return a.perByte() > b.perByte(); });
+    return population;
+}
+
+FuzzCase minimiseCase(const FuzzCase &input, uint64_t limit) {
+    FuzzCase best = input;
+    // Delta debugging: drop pieces of halving length while the ratio holds.
+    for (size_t length = std::max<size_t>(best.text.size() / 2, 1); length;) {
+        bool removed = false;
+        for (size_t at = 0; at < best.text.size();) {
+            FuzzCase candidate;
+            candidate.text = best.text.substr(0, at);
+            if (at + length < best.text.size()) candidate.text += best.text.substr(at + length);
+            if (candidate.text.empty()) {
+                at += length;
+                continue;
+            }
+            candidate.ruleCalls = measureRuleCalls(candidate.text, limit);
+            if (candidate.perByte() >= best.perByte()) {
+                best = std::move(candidate);
+                removed = true;
+            } else {
+                at += length;
+            }
+        }
+        if (!removed || length > 1) length /= 2;
+    }
+    return best;
+}
+
+bool readCorpus(const std::string &dir, std::vector<std::string> &paths,
+                std::vector<std::string> &texts, std::string &error) {
+    std::error_code ec;
+    paths.clear();
+    texts.clear();
+    for (std::filesystem::directory_iterator it(dir, ec), end; !ec && it != end;
+         it.increment(ec)) {
+        if (it->is_regular_file(ec) && it->path().extension() == ".pfru") {
+            paths.push_back(it->path().string());
+        }
+    }
+    if (ec) {
+        error = "cannot read " + dir + ": " + ec.message();
+        return false;
+    }
+    std::sort(paths.begin(), paths.end());
+    for (const auto &path : paths) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            error = "cannot open " + path;
+            return false;
+        }
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        texts.push_back(buffer.str());
+    }
+    return true;
+}
+
+std::string saveCorpusCase(const std::string &dir, const std::string &text) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.pfru",
+                  static_cast<unsigned long long>(hashText(text)));
+    std::string path = (std::filesystem::path(dir) / name).string();
+    std::error_code ec;
+    if (!std::filesystem::exists(path, ec)) {
+        std::ofstream file(path, std::ios::binary);
+        file << text;
+        if (!file) return std::string();
+    }
+    return path;
+}
@@ -0,0 +1,141 @@
+#include "../include/Profiler.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <string>
+
+namespace {
+double milliseconds(uint64_t ns) { return static_cast<double>(ns) / 1e6; }
+}  // namespace
+
+Profiler::Profiler(const Module &module)
+    : module_(module),
+      totals_(module.functions.size()),
+      active_(module.functions.size(), 0),
+      contexts_(1, Context{-1, 0}) {
+    for (const auto &arrow : module.arrows) edges_.emplace_back(arrow.transfers.size());
+}
+
+uint32_t Profiler::context(uint32_t parent, int32_t function) {
+    if (contexts_[parent].lastFunction == function) return contexts_[parent].lastChild;
+    uint64_t key = static_cast<uint64_t>(parent) << 32 | static_cast<uint32_t>(function);
+    auto found = children_.find(key);
+    uint32_t context;
+    if (found != children_.end()) {
+        context = found->second;
+    } else {
+        context = static_cast<uint32_t>(contexts_.size());
+        contexts_.push_back(Context{function, parent});
+        children_.emplace(key, context);
+    }
+    contexts_[parent].lastFunction = function;
+    contexts_[parent].lastChild = context;
+    return context;
+}
+
+void Profiler::enter(int32_t function) {
+    uint32_t parent = stack_.empty() ? 0 : stack_.back().context;
+    uint32_t entered = context(parent, function);
+    ++active_[function];
+    stack_.push_back(Frame{entered, now()});
+}
+
+void Profiler::leave(uint64_t calls) {
+    uint64_t elapsed = close(now(), calls);
+    stack_.pop_back();
+    if (!stack_.empty()) stack_.back().childNs += elapsed;
+}
+
+void Profiler::replace(int32_t function) {
+    uint64_t at = now();
+    uint64_t elapsed = close(at, 1);
+    Frame &frame = stack_.back();
+    frame.context = context(contexts_[frame.context].parent, function);
+    frame.childNs = 0;
+    ++active_[function];
+    // The lookup above is charged to the callee rather than the caller.
+    frame.start = at;
+    if (stack_.size() > 1) stack_[stack_.size() - 2].childNs += elapsed;
+}
+
+// Books the top frame as ending at `at`; returns its inclusive time.
+uint64_t Profiler::close(uint64_t at, uint64_t calls) {
+    const Frame &frame = stack_.back();
+    uint64_t elapsed = at - frame.start;
+    uint64_t self = elapsed > frame.childNs ? elapsed - frame.childNs : 0;
+    Context &context = contexts_[frame.context];
+    context.calls += calls;
+    context.selfNs += self;
+    Totals &totals = totals_[context.function];
+    totals.calls += calls;
+    totals.exclusiveNs += self;
+    if (--active_[context.function] == 0) totals.inclusiveNs += elapsed;
+    return elapsed;
+}
+
+void Profiler::traverse(int32_t arrow, uint32_t transfer, uint64_t moveNs, uint64_t targetNs) {
+    Edge &edge = edges_[arrow][transfer];
+    ++edge.traversals;
+    edge.moveNs += moveNs;
+    edge.targetNs += targetNs;
+}
+
+void Profiler::writeReport(std::ostream &out) const {
+    std::vector<uint32_t> order;
+    for (uint32_t f = 0; f < totals_.size(); ++f) {
+        if (totals_[f].calls) order.push_back(f);
+    }
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return totals_[a].exclusiveNs > totals_[b].exclusiveNs;
+    });
+    out << std::fixed << std::setprecision(3);
+    out << std::left << std::setw(24) << "repr" << std::right << std::setw(12) << "calls"
+        << std::setw(16) << "inclusive ms" << std::setw(16) << "exclusive ms" << std::setw(12)
+        << "avg us" << "\n";
+    for (uint32_t f : order) {
+        const Totals &t = totals_[f];
+        out << std::left << std::setw(24) << module_.functions[f].name << std::right
+            << std::setw(12) << t.calls << std::setw(16) << milliseconds(t.inclusiveNs)
+            << std::setw(16) << milliseconds(t.exclusiveNs) << std::setw(12)
+            << milliseconds(t.inclusiveNs) * 1e3 / static_cast<double>(t.calls) << "\n";
+    }
+
+    for (size_t a = 0; a < edges_.size(); ++a) {
+        const Arrow &arrow = module_.arrows[a];
+        bool used = false;
+        for (const Edge &edge : edges_[a]) used = used || edge.traversals;
+        if (!used) continue;
+        out << "\n#" << arrow.name << "\n"
+            << std::left << std::setw(32) << "edge" << std::right << std::setw(12)
+            << "traversals" << std::setw(16) << "move ns avg" << std::setw(16) << "target ms"
+            << "\n";
+        for (size_t t = 0; t < edges_[a].size(); ++t) {
+            const Edge &edge = edges_[a][t];
+            if (!edge.traversals) continue;
+            const Transfer &transfer = arrow.transfers[t];
+            std::string name = arrow.nodes[transfer.from].name + " -> " +
+                               arrow.nodes[transfer.to].name;
+            out << std::left << std::setw(32) << name << std::right << std::setw(12)
+                << edge.traversals << std::setw(16)
+                << static_cast<double>(edge.moveNs) / static_cast<double>(edge.traversals)
+                << std::setw(16) << milliseconds(edge.targetNs) << "\n";
+        }
+    }
+    out << std::defaultfloat;
+}
+
+void Profiler::writeFoldedStacks(std::ostream &out) const {
+    std::vector<int32_t> path;
+    for (uint32_t c = 1; c < contexts_.size(); ++c) {
+        uint64_t micros = contexts_[c].selfNs / 1000;
+        if (micros == 0) continue;
+        path.clear();
+        for (uint32_t at = c; at != 0; at = contexts_[at].parent) {
+            path.push_back(contexts_[at].function);
+        }
+        for (size_t i = path.size(); i-- > 0;) {
+            out << module_.functions[path[i]].name << (i ? ";" : " ");
+        }
+        out << micros << "\n";
+    }
+}
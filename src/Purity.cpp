@@ -0,0 +1,111 @@
+#include "../include/Purity.h"
+
+namespace {
+// Cached keys are raw parameter slots; larger frames are not worth hashing.
+const uint32_t kMaxKeySlots = 16;
+
+// Every node the runtime has today reads and writes only its own frame. New
+// node kinds are treated as effects until they are listed here.
+bool effectFree(const Node &node) {
+    switch (node.kind) {
+        case NODE_CONST:
+        case NODE_LOAD:
+        case NODE_CONVERT:
+        case NODE_UNARY:
+        case NODE_BINARY:
+        case NODE_AND:
+        case NODE_OR:
+        case NODE_CALL:
+        case NODE_CONCAT:
+        case NODE_ARRAY_LOAD:
+        case NODE_ARRAY_LITERAL:
+        case NODE_ARRAY_BINARY:
+        case NODE_ARRAY_CONVERT:
+        case NODE_ARRAY_CALL:
+        case NODE_STORE:
+        case NODE_ARRAY_STORE:
+        case NODE_EVAL:
+        case NODE_IF:
+        case NODE_WHILE:
+        case NODE_DO_WHILE:
+        case NODE_FOR:
+        case NODE_RETURN:
+        case NODE_BLOCK: return true;
+    }
+    return false;
+}
+
+// Straight-line bodies cost less than a cache lookup.
+bool repeatsWork(const Node &node) {
+    switch (node.kind) {
+        case NODE_CALL:
+        case NODE_ARRAY_CALL:
+        case NODE_WHILE:
+        case NODE_DO_WHILE:
+        case NODE_FOR: return true;
+        default: return false;
+    }
+}
+
+// Keys and results are compared and kept as raw slots, but a stringa slot
+// points into the heap of the run that built it.
+bool passesStrings(const Function &fn) {
+    for (const auto &type : fn.params) {
+        if (type.element == VALUE_STRINGA) return true;
+    }
+    for (const auto &type : fn.results) {
+        if (type.element == VALUE_STRINGA) return true;
+    }
+    return false;
+}
+}  // namespace
+
+void analysePurity(Module &module) {
+    uint32_t count = static_cast<uint32_t>(module.functions.size());
+    std::vector<uint32_t> offsets(count + 1, 0), callers;
+    std::vector<uint32_t> work;
+    for (uint32_t f = 0; f < count; ++f) {
+        Function &fn = module.functions[f];
+        fn.pure = true;
+        for (const auto &node : fn.nodes) {
+            if (node.callee >= 0) ++offsets[node.callee + 1];
+            if (!effectFree(node)) fn.pure = false;
+        }
+        if (!fn.pure) work.push_back(f);
+    }
+
+    // Reverse call graph in CSR form, then a worklist from the impure seeds.
+    for (uint32_t f = 0; f < count; ++f) offsets[f + 1] += offsets[f];
+    callers.resize(offsets.back());
+    std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+    for (uint32_t f = 0; f < count; ++f) {
+        for (const auto &node : module.functions[f].nodes) {
+            if (node.callee >= 0) callers[cursor[node.callee]++] = f;
+        }
+    }
+    while (!work.empty()) {
+        uint32_t f = work.back();
+        work.pop_back();
+        for (uint32_t e = offsets[f]; e < offsets[f + 1]; ++e) {
+            Function &caller = module.functions[callers[e]];
+            if (caller.pure) {
+                caller.pure = false;
+                work.push_back(callers[e]);
+            }
+        }
+    }
+
+    for (auto &fn : module.functions) {
+        fn.memoise = false;
+        if (!fn.pure || fn.params.empty() || fn.resultSize == 0 ||
+            fn.paramSize > kMaxKeySlots || passesStrings(fn)) {
+            continue;
+        }
+        for (const auto &node : fn.nodes) {
+            if (repeatsWork(node)) {
+                fn.memoise = true;
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,511 @@
+#include "../include/Server.h"
+
+#include "../include/ArrowGraph.h"
+#include "../include/Ast.h"
+#include "../include/Compiler.h"
+#include "../include/ConstantFolder.h"
+#include "../include/Interpreter.h"
+#include "../include/TableParser.h"
+#include "../include/ThreadPool.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string_view>
+#include <unordered_map>
+
+namespace {
+const uint32_t kMaxFrame = 64u << 20;
+const char kOk = 0;
+const char kFailed = 1;
+// A client has this long to finish a request once its first byte arrives,
+// and to take each part of a reply.
+const std::chrono::milliseconds kIoTimeout(5000);
+// Files kept compiled; the least recently requested one goes first.
+const size_t kMaxResident = 64;
+
+// One resident file. Only the idle interpreters and the last use change once
+// it is cached.
+struct Entry {
+    uint64_t hash = 0;
+    size_t bytes = 0;
+    std::atomic<uint64_t> used{0};  // Server::uses_ at the last load
+    std::string error;         // parse or syntax tree failure: every request fails
+    std::string compileError;  // run and flow fail, parse and check still answer
+    std::string summary;       // parse reply
+    std::string report;        // check reply
+    Module module;
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Interpreter>> idle;
+};
+
+bool readAll(int fd, char *data, size_t size) {
+    while (size) {
+        ssize_t n = ::read(fd, data, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Server connections are non-blocking: a full socket waits at most
+// kIoTimeout for the client to read.
+bool writeAll(int fd, const char *data, size_t size) {
+    while (size) {
+        ssize_t n = ::send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            pollfd ready = {fd, POLLOUT, 0};
+            if (::poll(&ready, 1, static_cast<int>(kIoTimeout.count())) <= 0) return false;
+            continue;
+        }
+        if (n <= 0) return false;
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool readFrame(int fd, std::string &payload) {
+    unsigned char header[4];
+    if (!readAll(fd, reinterpret_cast<char *>(header), sizeof(header))) return false;
+    uint32_t size = header[0] | header[1] << 8 | header[2] << 16 | static_cast<uint32_t>(header[3]) << 24;
+    if (size > kMaxFrame) return false;
+    payload.resize(size);
+    return readAll(fd, payload.data(), size);
+}
+
+// A connection between requests, with the part of its next frame that has
+// arrived. The poll loop reads it without blocking, so a client that stalls
+// mid-request holds no worker.
+struct Connection {
+    int fd = -1;
+    std::string frame;
+    std::chrono::steady_clock::time_point deadline;  // set by the first byte
+};
+
+enum RECEIVED {
+    RECEIVED_PARTIAL,
+    RECEIVED_FRAME,
+    RECEIVED_CLOSED,
+};
+
+// Reads what has arrived, never past the end of the frame so a request sent
+// behind it stays in the socket. A whole frame leaves its payload in
+// `connection.frame`.
+RECEIVED receiveFrame(Connection &connection) {
+    std::string &frame = connection.frame;
+    if (frame.empty()) connection.deadline = std::chrono::steady_clock::now() + kIoTimeout;
+    for (;;) {
+        size_t want = 4;
+        if (frame.size() >= 4) {
+            const auto *header = reinterpret_cast<const unsigned char *>(frame.data());
+            uint32_t size = header[0] | header[1] << 8 | header[2] << 16 |
+                            static_cast<uint32_t>(header[3]) << 24;
+            if (size > kMaxFrame) return RECEIVED_CLOSED;
+            want += size;
+            if (frame.size() == want) break;
+        }
+        // Grown as bytes arrive, not by what the header claims.
+        size_t have = frame.size();
+        frame.resize(have + std::min<size_t>(want - have, 1 << 16));
+        ssize_t n = ::read(connection.fd, frame.data() + have, frame.size() - have);
+        frame.resize(have + static_cast<size_t>(std::max<ssize_t>(n, 0)));
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return RECEIVED_PARTIAL;
+        if (n <= 0) return RECEIVED_CLOSED;
+    }
+    frame.erase(0, 4);
+    return RECEIVED_FRAME;
+}
+
+bool writeFrame(int fd, std::string_view payload) {
+    std::string frame(4, '\0');
+    for (int i = 0; i < 4; ++i) frame[i] = static_cast<char>(payload.size() >> (8 * i));
+    frame += payload;
+    return writeAll(fd, frame.data(), frame.size());
+}
+
+bool readSource(const std::string &path, std::string &text) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat info;
+    bool ok = ::fstat(fd, &info) == 0 && S_ISREG(info.st_mode);
+    if (ok) {
+        text.resize(static_cast<size_t>(info.st_size));
+        ok = readAll(fd, text.data(), text.size());
+    }
+    ::close(fd);
+    return ok;
+}
+
+bool socketAddress(const std::string &path, sockaddr_un &address) {
+    address = sockaddr_un();
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) return false;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+int connectTo(const sockaddr_un &address) {
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (::connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) < 0) {
+        int saved = errno;
+        ::close(fd);
+        errno = saved;
+        return -1;
+    }
+    return fd;
+}
+
+bool namesFile(const std::string &command) {
+    return command == "parse" || command == "check" || command == "run" || command == "flow";
+}
+
+class Server {
+ public:
+    explicit Server(unsigned threads) : pool_(threads) {}
+    bool run(const std::string &path);
+
+ private:
+    void serveRequest(int fd, const std::string &request);
+    bool handle(const std::vector<std::string> &words, std::string &out);
+    bool invoke(Entry &entry, const std::vector<std::string> &words, std::string &out);
+    std::shared_ptr<Entry> load(const std::string &path, std::string &error);
+    std::shared_ptr<Entry> compile(const std::string &path, const std::string &text);
+    void wake();
+
+    ThreadPool pool_;
+    int listen_ = -1;
+    int wake_[2] = {-1, -1};
+    std::atomic<bool> stopping_{false};
+    std::mutex mutex_;
+    std::vector<int> returned_;  // connections handed back after a request
+    std::mutex cacheMutex_;
+    std::unordered_map<std::string, std::shared_ptr<Entry>> cache_;
+    std::atomic<uint64_t> requests_{0}, hits_{0}, misses_{0}, evictions_{0};
+    std::atomic<uint64_t> uses_{0};  // loads so far, to order cache entries by last use
+};
+
+bool Server::run(const std::string &path) {
+    sockaddr_un address;
+    if (!socketAddress(path, address)) {
+        std::cerr << "Socket path too long: " << path << "\n";
+        return false;
+    }
+    // Take over a socket left behind by a server that is gone, but never a
+    // live one or some other file.
+    struct stat info;
+    if (::lstat(path.c_str(), &info) == 0) {
+        if (!S_ISSOCK(info.st_mode)) {
+            std::cerr << path << " exists and is not a socket\n";
+            return false;
+        }
+        int fd = connectTo(address);
+        if (fd >= 0) {
+            ::close(fd);
+            std::cerr << "A server is already listening on " << path << "\n";
+            return false;
+        }
+        ::unlink(path.c_str());
+    }
+    listen_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_ < 0 || ::bind(listen_, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 ||
+        ::listen(listen_, 128) < 0 || ::pipe2(wake_, O_CLOEXEC | O_NONBLOCK) < 0) {
+        std::cerr << "Cannot listen on " << path << ": " << std::strerror(errno) << "\n";
+        if (listen_ >= 0) ::close(listen_);
+        return false;
+    }
+    std::cerr << "Serving " << path << " on " << pool_.size() << " threads\n";
+
+    // Connections waiting for their next request. One whose request is
+    // complete leaves the set until it has been answered.
+    std::vector<Connection> idle, waiting;
+    std::vector<pollfd> fds;
+    while (!stopping_) {
+        auto now = std::chrono::steady_clock::now();
+        int timeout = -1;
+        fds.clear();
+        fds.push_back({listen_, POLLIN, 0});
+        fds.push_back({wake_[0], POLLIN, 0});
+        for (const Connection &connection : idle) {
+            fds.push_back({connection.fd, POLLIN, 0});
+            if (connection.frame.empty()) continue;
+            auto left = std::chrono::ceil<std::chrono::milliseconds>(connection.deadline - now);
+            int ms = static_cast<int>(std::max<int64_t>(left.count(), 0));
+            if (timeout < 0 || ms < timeout) timeout = ms;
+        }
+        if (::poll(fds.data(), fds.size(), timeout) < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "poll: " << std::strerror(errno) << "\n";
+            break;
+        }
+        now = std::chrono::steady_clock::now();
+        waiting.clear();
+        for (size_t i = 2; i < fds.size(); ++i) {
+            Connection &connection = idle[i - 2];
+            RECEIVED received = fds[i].revents ? receiveFrame(connection) : RECEIVED_PARTIAL;
+            if (received == RECEIVED_PARTIAL && !connection.frame.empty() &&
+                now >= connection.deadline) {
+                received = RECEIVED_CLOSED;
+            }
+            if (received == RECEIVED_FRAME) {
+                int fd = connection.fd;
+                pool_.submit([this, fd, request = std::move(connection.frame)] {
+                    serveRequest(fd, request);
+                });
+            } else if (received == RECEIVED_CLOSED) {
+                ::close(connection.fd);
+            } else {
+                waiting.push_back(std::move(connection));
+            }
+        }
+        idle.swap(waiting);
+        if (fds[1].revents) {
+            char drain[64];
+            while (::read(wake_[0], drain, sizeof(drain)) > 0) {
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (int fd : returned_) idle.push_back({fd, std::string(), {}});
+            returned_.clear();
+        }
+        if (fds[0].revents & POLLIN) {
+            int fd = ::accept4(listen_, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+            if (fd >= 0) idle.push_back({fd, std::string(), {}});
+        }
+    }
+
+    pool_.wait();
+    for (const Connection &connection : idle) ::close(connection.fd);
+    for (int fd : returned_) ::close(fd);
+    ::close(listen_);
+    ::close(wake_[0]);
+    ::close(wake_[1]);
+    ::unlink(path.c_str());
+    std::cerr << requests_ << " requests, " << hits_ << " cache hits, " << misses_
+              << " misses, " << evictions_ << " evictions\n";
+    return true;
+}
+
+void Server::serveRequest(int fd, const std::string &request) {
+    thread_local std::string reply;
+    thread_local std::vector<std::string> words;
+    ++requests_;
+    words.clear();
+    if (!request.empty()) {
+        for (size_t begin = 0;;) {
+            size_t end = request.find('\0', begin);
+            words.push_back(request.substr(begin, end - begin));
+            if (end == std::string::npos) break;
+            begin = end + 1;
+        }
+    }
+    reply.assign(1, kOk);
+    if (!handle(words, reply)) reply[0] = kFailed;
+    if (!writeFrame(fd, reply)) {
+        ::close(fd);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        returned_.push_back(fd);
+    }
+    wake();
+}
+
+void Server::wake() {
+    char byte = 0;
+    // A full pipe already holds a wake-up.
+    if (::write(wake_[1], &byte, 1) < 0) return;
+}
+
+bool Server::handle(const std::vector<std::string> &words, std::string &out) {
+    const std::string command = words.empty() ? std::string() : words[0];
+    if (command == "stats" && words.size() == 1) {
+        std::lock_guard<std::mutex> lock(cacheMutex_);
+        out += std::to_string(cache_.size()) + " files resident, " + std::to_string(requests_) +
+               " requests, " + std::to_string(hits_) + " cache hits, " + std::to_string(misses_) +
+               " misses, " + std::to_string(evictions_) + " evictions\n";
+        return true;
+    }
+    if (command == "stop" && words.size() == 1) {
+        stopping_ = true;
+        wake();
+        return true;
+    }
+    bool file = command == "parse" || command == "check" ? words.size() == 2
+                                                         : namesFile(command) && words.size() >= 3;
+    if (!file) {
+        out += "Unknown request '" + command + "'\n";
+        return false;
+    }
+    std::string error;
+    std::shared_ptr<Entry> entry = load(words[1], error);
+    if (!entry) {
+        out += error + "\n";
+        return false;
+    }
+    if (!entry->error.empty()) {
+        out += entry->error + "\n";
+        return false;
+    }
+    if (command == "parse") {
+        out += entry->summary;
+        return true;
+    }
+    if (command == "check") {
+        out += entry->report;
+        return true;
+    }
+    if (!entry->compileError.empty()) {
+        out += entry->compileError + "\n";
+        return false;
+    }
+    return invoke(*entry, words, out);
+}
+
+bool Server::invoke(Entry &entry, const std::vector<std::string> &words, std::string &out) {
+    std::vector<Value> args(words.size() - 3), results;
+    for (size_t i = 3; i < words.size(); ++i) {
+        if (!parseValue(words[i], args[i - 3])) {
+            out += "Invalid argument '" + words[i] + "'\n";
+            return false;
+        }
+    }
+    // Interpreters are built once per file and concurrent request, then
+    // reused. Their memo caches start empty on every request, so no result
+    // depends on the requests before it.
+    std::unique_ptr<Interpreter> interpreter;
+    {
+        std::lock_guard<std::mutex> lock(entry.mutex);
+        if (!entry.idle.empty()) {
+            interpreter = std::move(entry.idle.back());
+            entry.idle.pop_back();
+        }
+    }
+    if (!interpreter) interpreter = std::make_unique<Interpreter>(entry.module);
+    interpreter->clearMemo();
+    bool ok = words[0] == "flow" ? interpreter->run(words[2], args, results)
+                                 : interpreter->call(words[2], args, results);
+    if (ok) {
+        for (size_t i = 0; i < results.size(); ++i) out += (i ? " " : "") + formatValue(results[i]);
+        out += "\n";
+    } else {
+        out += "Runtime error: " + interpreter->error() + "\n";
+    }
+    std::lock_guard<std::mutex> lock(entry.mutex);
+    entry.idle.push_back(std::move(interpreter));
+    return ok;
+}
+
+std::shared_ptr<Entry> Server::load(const std::string &path, std::string &error) {
+    thread_local std::string text;
+    if (!readSource(path, text)) {
+        error = "Cannot open " + path;
+        return nullptr;
+    }
+    uint64_t hash = std::hash<std::string_view>()(text);
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex_);
+        auto it = cache_.find(path);
+        if (it != cache_.end() && it->second->hash == hash && it->second->bytes == text.size()) {
+            ++hits_;
+            it->second->used = ++uses_;
+            return it->second;
+        }
+    }
+    // Two requests racing on a changed file both compile it; the later one
+    // stays cached.
+    ++misses_;
+    std::shared_ptr<Entry> entry = compile(path, text);
+    entry->hash = hash;
+    entry->bytes = text.size();
+    entry->used = ++uses_;
+    std::lock_guard<std::mutex> lock(cacheMutex_);
+    cache_[path] = entry;
+    // Requests still running on an evicted file keep it alive until they end.
+    while (cache_.size() > kMaxResident) {
+        auto oldest = std::min_element(
+            cache_.begin(), cache_.end(),
+            [](const auto &a, const auto &b) { return a.second->used < b.second->used; });
+        cache_.erase(oldest);
+        ++evictions_;
+    }
+    return entry;
+}
+
+std::shared_ptr<Entry> Server::compile(const std::string &path, const std::string &text) {
+    thread_local TableParser parser;
+    auto entry = std::make_shared<Entry>();
+    if (!parser.parseProgram(text)) {
+        entry->error = path + ":" + parser.error();
+        return entry;
+    }
+    Program program;
+    std::string error;
+    if (!buildProgram(parser.tokens(), parser.symbols(), program, error)) {
+        entry->error = "Failed to build syntax tree: " + error;
+        return entry;
+    }
+    entry->summary = std::to_string(parser.tokens().size()) + " tokens, nesting depth " +
+                     std::to_string(parser.depthReached()) + "\n";
+    std::ostringstream report;
+    writeArrowReport(program, report);
+    entry->report = report.str();
+    ConstantFolder(program).run();
+    Compiler compiler(program);
+    if (!compiler.compile(entry->module)) entry->compileError = "Compile error: " + compiler.error();
+    return entry;
+}
+}  // namespace
+
+bool serve(const std::string &socketPath, unsigned threads) {
+    return Server(threads).run(socketPath);
+}
+
+bool sendRequest(const std::string &socketPath, const std::vector<std::string> &words) {
+    sockaddr_un address;
+    if (!socketAddress(socketPath, address)) {
+        std::cerr << "Socket path too long: " << socketPath << "\n";
+        return false;
+    }
+    std::string payload;
+    for (size_t i = 0; i < words.size(); ++i) {
+        if (i) payload += '\0';
+        std::error_code ec;
+        std::filesystem::path absolute;
+        if (i == 1 && namesFile(words[0])) absolute = std::filesystem::absolute(words[i], ec);
+        payload += absolute.empty() ? words[i] : absolute.string();
+    }
+    int fd = connectTo(address);
+    if (fd < 0) {
+        std::cerr << "Cannot connect to " << socketPath << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+    std::string reply;
+    bool answered = writeFrame(fd, payload) && readFrame(fd, reply) && !reply.empty();
+    ::close(fd);
+    if (!answered) {
+        std::cerr << "No reply from " << socketPath << "\n";
+        return false;
+    }
+    (reply[0] == kOk ? std::cout : std::cerr) << std::string_view(reply).substr(1);
+    return reply[0] == kOk;
+}
@@ -0,0 +1,561 @@
+#include "../include/Ssa.h"
+
+#include "../include/BinaryKernels.h"
+
+#include <unordered_map>
+
+namespace {
+TypeRef typeRef(VALUE_TYPE element, uint32_t length = 0) {
+    TypeRef type;
+    type.element = element;
+    type.arraySize = length;
+    return type;
+}
+
+// Braun et al., "Simple and Efficient Construction of Static Single Assignment
+// Form": slot values are looked up on demand, and blocks whose predecessors
+// are not all known yet get placeholder phis that are completed on sealing.
+class SsaBuilder {
+ public:
+    SsaBuilder(const Function &source, SsaFunction &out) : source_(source), out_(out) {}
+
+    void build() {
+        current_ = newBlock();
+        seal(current_);
+        for (uint32_t i = 0; i < source_.params.size(); ++i) {
+            SsaInst param;
+            param.kind = SSA_PARAM;
+            param.type = source_.params[i].element;
+            param.length = source_.params[i].arraySize;
+            param.index = i;
+            write(static_cast<int32_t>(source_.paramSlots[i]), current_, emit(param));
+        }
+        if (source_.body >= 0) statement(source_.body);
+        if (!terminated(current_)) {
+            SsaInst ret;
+            ret.kind = SSA_RETURN;
+            terminate(current_, ret);
+        }
+    }
+
+ private:
+    uint32_t newBlock() {
+        out_.blocks.emplace_back();
+        defs_.emplace_back();
+        sealed_.push_back(false);
+        incomplete_.emplace_back();
+        return static_cast<uint32_t>(out_.blocks.size() - 1);
+    }
+
+    void link(uint32_t from, uint32_t to) {
+        out_.blocks[from].succs.push_back(to);
+        out_.blocks[to].preds.push_back(from);
+    }
+
+    bool terminated(uint32_t block) const {
+        const auto &insts = out_.blocks[block].insts;
+        return !insts.empty() && out_.insts[insts.back()].kind >= SSA_JUMP;
+    }
+
+    uint32_t add(SsaInst inst, uint32_t block) {
+        inst.block = block;
+        out_.insts.push_back(std::move(inst));
+        return static_cast<uint32_t>(out_.insts.size() - 1);
+    }
+
+    uint32_t emit(SsaInst inst) {
+        uint32_t id = add(std::move(inst), current_);
+        out_.blocks[current_].insts.push_back(id);
+        return id;
+    }
+
+    // Phis and the values of undefined slots go in front of everything else.
+    uint32_t emitFront(SsaInst inst, uint32_t block) {
+        uint32_t id = add(std::move(inst), block);
+        auto &insts = out_.blocks[block].insts;
+        size_t at = 0;
+        while (at < insts.size() && out_.insts[insts[at]].kind == SSA_PHI) ++at;
+        insts.insert(insts.begin() + at, id);
+        return id;
+    }
+
+    void terminate(uint32_t block, SsaInst inst) {
+        inst.block = block;
+        out_.insts.push_back(std::move(inst));
+        out_.blocks[block].insts.push_back(static_cast<uint32_t>(out_.insts.size() - 1));
+    }
+
+    void jump(uint32_t from, uint32_t to) {
+        link(from, to);
+        SsaInst inst;
+        inst.kind = SSA_JUMP;
+        terminate(from, inst);
+    }
+
+    // Both edges must already be linked.
+    void branch(uint32_t block, uint32_t cond, uint32_t taken, uint32_t other) {
+        out_.blocks[block].succs = {taken, other};
+        SsaInst inst;
+        inst.kind = SSA_BRANCH;
+        inst.operands = {cond};
+        terminate(block, inst);
+    }
+
+    uint32_t phi(uint32_t block, const TypeRef &type, int32_t slot) {
+        SsaInst inst;
+        inst.kind = SSA_PHI;
+        inst.type = type.element;
+        inst.length = type.arraySize;
+        inst.slot = slot;
+        return emitFront(inst, block);
+    }
+
+    void seal(uint32_t block) {
+        for (uint32_t id : incomplete_[block]) addPhiOperands(id);
+        incomplete_[block].clear();
+        sealed_[block] = true;
+    }
+
+    void write(int32_t slot, uint32_t block, uint32_t value) { defs_[block][slot] = value; }
+
+    uint32_t read(int32_t slot, uint32_t block, const TypeRef &type) {
+        auto it = defs_[block].find(slot);
+        if (it != defs_[block].end()) return it->second;
+        const SsaBlock &b = out_.blocks[block];
+        uint32_t value;
+        if (!sealed_[block]) {
+            value = phi(block, type, slot);
+            incomplete_[block].push_back(value);
+        } else if (b.preds.size() == 1) {
+            value = read(slot, b.preds[0], type);
+        } else if (b.preds.empty()) {
+            // Only code after a return reads slots nothing has written.
+            SsaInst zero;
+            zero.kind = type.arraySize ? SSA_ARRAY : SSA_CONST;
+            zero.type = type.element;
+            zero.length = type.arraySize;
+            value = emitFront(zero, block);
+        } else {
+            value = phi(block, type, slot);
+            write(slot, block, value);
+            addPhiOperands(value);
+        }
+        write(slot, block, value);
+        return value;
+    }
+
+    void addPhiOperands(uint32_t id) {
+        uint32_t block = out_.insts[id].block;
+        TypeRef type = typeRef(out_.insts[id].type, out_.insts[id].length);
+        int32_t slot = out_.insts[id].slot;
+        std::vector<uint32_t> operands;
+        for (uint32_t pred : out_.blocks[block].preds) operands.push_back(read(slot, pred, type));
+        out_.insts[id].operands = std::move(operands);
+    }
+
+    SsaInst make(SSA_KIND kind, const Node &n) const {
+        SsaInst inst;
+        inst.kind = kind;
+        inst.type = n.type;
+        inst.from = n.from;
+        inst.op = n.op;
+        inst.length = n.length;
+        inst.broadcast = n.broadcast;
+        inst.row = n.row;
+        inst.column = n.column;
+        return inst;
+    }
+
+    uint32_t constant(VALUE_TYPE type, Slot value) {
+        SsaInst inst;
+        inst.type = type;
+        inst.constant = value;
+        return emit(inst);
+    }
+
+    uint32_t value(int32_t index) {
+        const Node &n = source_.nodes[index];
+        switch (n.kind) {
+            case NODE_CONST: {
+                SsaInst inst = make(SSA_CONST, n);
+                inst.constant = n.constant;
+                return emit(inst);
+            }
+            case NODE_LOAD:
+            case NODE_ARRAY_LOAD: return read(n.slot, current_, typeRef(n.type, n.length));
+            case NODE_CONVERT:
+            case NODE_ARRAY_CONVERT: {
+                SsaInst inst = make(SSA_CONVERT, n);
+                inst.operands = {value(n.a)};
+                return emit(inst);
+            }
+            case NODE_UNARY: {
+                SsaInst inst = make(SSA_UNARY, n);
+                inst.operands = {value(n.a)};
+                return emit(inst);
+            }
+            case NODE_BINARY:
+            case NODE_CONCAT:
+            case NODE_ARRAY_BINARY: {
+                SsaInst inst = make(n.kind == NODE_ARRAY_BINARY ? SSA_ARRAY_BINARY : SSA_BINARY, n);
+                inst.binary = n.binary;
+                inst.kernel = n.kernel;
+                uint32_t lhs = value(n.a);
+                inst.operands = {lhs, value(n.b)};
+                return emit(inst);
+            }
+            case NODE_AND:
+            case NODE_OR: return shortCircuit(n);
+            case NODE_CALL:
+            case NODE_ARRAY_CALL: {
+                SsaInst inst = make(SSA_CALL, n);
+                inst.callee = n.callee;
+                for (uint32_t i = 0; i < n.count; ++i) {
+                    inst.operands.push_back(value(source_.lists[n.first + i]));
+                }
+                return emit(inst);
+            }
+            case NODE_ARRAY_LITERAL: {
+                SsaInst inst = make(SSA_ARRAY, n);
+                for (uint32_t i = 0; i < n.count; ++i) {
+                    inst.operands.push_back(value(source_.lists[n.first + i]));
+                }
+                return emit(inst);
+            }
+            default: break;
+        }
+        return SsaInst::NONE;
+    }
+
+    // `a && b` runs b only if a holds; the join picks b or the short-circuit
+    // result.
+    uint32_t shortCircuit(const Node &n) {
+        bool isAnd = n.kind == NODE_AND;
+        uint32_t lhs = value(n.a);
+        uint32_t shortResult = constant(VALUE_BOOL, Slot{isAnd ? 0 : 1});
+        uint32_t left = current_;
+        uint32_t right = newBlock();
+        link(left, right);
+        seal(right);
+        current_ = right;
+        uint32_t rhs = value(n.b);
+        uint32_t rightEnd = current_;
+        uint32_t join = newBlock();
+        link(left, join);
+        branch(left, lhs, isAnd ? right : join, isAnd ? join : right);
+        jump(rightEnd, join);
+        seal(join);
+        current_ = join;
+        uint32_t result = phi(join, typeRef(VALUE_BOOL), -1);
+        out_.insts[result].operands = {shortResult, rhs};
+        return result;
+    }
+
+    void statement(int32_t index) {
+        const Node &n = source_.nodes[index];
+        switch (n.kind) {
+            case NODE_STORE:
+            case NODE_ARRAY_STORE: {
+                SsaInst inst = make(SSA_COPY, n);
+                inst.slot = n.slot;
+                inst.operands = {value(n.a)};
+                write(n.slot, current_, emit(inst));
+                break;
+            }
+            case NODE_EVAL: value(n.a); break;
+            case NODE_IF: {
+                std::vector<uint32_t> ends;
+                for (uint32_t i = 0; i < n.count; i += 2) {
+                    uint32_t cond = value(source_.lists[n.first + i]);
+                    uint32_t test = current_;
+                    uint32_t then = newBlock();
+                    link(test, then);
+                    seal(then);
+                    current_ = then;
+                    statement(source_.lists[n.first + i + 1]);
+                    ends.push_back(current_);
+                    uint32_t next = newBlock();
+                    link(test, next);
+                    seal(next);
+                    branch(test, cond, then, next);
+                    current_ = next;
+                }
+                uint32_t join = newBlock();
+                for (uint32_t end : ends) jump(end, join);
+                jump(current_, join);
+                seal(join);
+                current_ = join;
+                break;
+            }
+            case NODE_WHILE: {
+                uint32_t header = newBlock();
+                jump(current_, header);
+                current_ = header;
+                uint32_t cond = value(n.a);
+                uint32_t test = current_;
+                uint32_t body = newBlock();
+                link(test, body);
+                seal(body);
+                current_ = body;
+                statement(n.b);
+                jump(current_, header);
+                seal(header);
+                uint32_t exit = newBlock();
+                link(test, exit);
+                seal(exit);
+                branch(test, cond, body, exit);
+                current_ = exit;
+                break;
+            }
+            case NODE_DO_WHILE: {
+                uint32_t body = newBlock();
+                jump(current_, body);
+                current_ = body;
+                statement(n.b);
+                uint32_t cond = value(n.a);
+                uint32_t test = current_;
+                link(test, body);
+                seal(body);
+                uint32_t exit = newBlock();
+                link(test, exit);
+                seal(exit);
+                branch(test, cond, body, exit);
+                current_ = exit;
+                break;
+            }
+            case NODE_FOR: forLoop(n); break;
+            case NODE_RETURN: {
+                SsaInst inst = make(SSA_RETURN, n);
+                if (n.c >= 0) {
+                    inst.forward = true;
+                    inst.operands = {value(n.c)};
+                } else {
+                    for (uint32_t i = 0; i < n.count; ++i) {
+                        inst.operands.push_back(value(source_.lists[n.first + i]));
+                    }
+                }
+                terminate(current_, inst);
+                current_ = newBlock();
+                seal(current_);
+                break;
+            }
+            case NODE_BLOCK:
+                for (uint32_t i = 0; i < n.count; ++i) statement(source_.lists[n.first + i]);
+                break;
+            default: value(index); break;
+        }
+    }
+
+    // The bounds are evaluated once; the counter is a phi in the header and
+    // the loop variable starts each iteration as a copy of it.
+    void forLoop(const Node &n) {
+        VALUE_TYPE type = n.from;
+        uint32_t start = value(n.a);
+        uint32_t step = n.b >= 0 ? value(n.b) : constant(type, convertSlot(VALUE_I64, type, Slot{1}));
+        uint32_t end = value(n.c);
+        const SsaInst &stepInst = out_.insts[step];
+        bool positive = false, known = stepInst.kind == SSA_CONST;
+        if (known) {
+            positive = isFloating(type) ? stepInst.constant.f > 0 : stepInst.constant.i > 0;
+            known = isFloating(type) ? stepInst.constant.f != 0 : stepInst.constant.i != 0;
+        }
+        if (!known) {
+            SsaInst check = make(SSA_CHECK_STEP, n);
+            check.operands = {step};
+            emit(check);
+        }
+
+        uint32_t pre = current_;
+        uint32_t header = newBlock();
+        jump(pre, header);
+        current_ = header;
+        uint32_t counter = phi(header, typeRef(type), -1);
+        SsaInst test = make(known ? SSA_BINARY : SSA_RANGE, n);
+        test.type = VALUE_BOOL;
+        test.from = type;
+        test.op = positive ? OP_LT : OP_GT;
+        if (known) {
+            test.binary = findBinaryKernel(test.op, type, type);
+            test.operands = {counter, end};
+        } else {
+            test.operands = {counter, step, end};
+        }
+        uint32_t cond = emit(test);
+
+        uint32_t body = newBlock();
+        link(header, body);
+        seal(body);
+        current_ = body;
+        SsaInst variable = make(SSA_COPY, n);
+        variable.type = type;
+        variable.length = 0;
+        variable.slot = n.slot;
+        variable.operands = {counter};
+        write(n.slot, body, emit(variable));
+        statement(n.d);
+        SsaInst next = make(SSA_BINARY, n);
+        next.type = next.from = type;
+        next.op = OP_ADD;
+        next.binary = findBinaryKernel(OP_ADD, type, type);
+        next.operands = {counter, step};
+        uint32_t latch = current_;
+        uint32_t increment = emit(next);
+        jump(latch, header);
+        out_.insts[counter].operands = {start, increment};
+        seal(header);
+
+        uint32_t exit = newBlock();
+        link(header, exit);
+        seal(exit);
+        branch(header, cond, body, exit);
+        current_ = exit;
+    }
+
+    const Function &source_;
+    SsaFunction &out_;
+    uint32_t current_ = 0;
+    std::vector<std::unordered_map<int32_t, uint32_t>> defs_;  // per block: slot -> value
+    std::vector<bool> sealed_;
+    std::vector<std::vector<uint32_t>> incomplete_;  // placeholder phis per unsealed block
+};
+
+void writeOperands(const SsaInst &inst, size_t first, std::ostream &out) {
+    for (size_t i = first; i < inst.operands.size(); ++i) {
+        out << (i > first ? ", %" : "%") << inst.operands[i];
+    }
+}
+}  // namespace
+
+void lowerToSsa(const Module &module, int32_t function, SsaFunction &out) {
+    const Function &source = module.functions[function];
+    out = SsaFunction();
+    out.name = source.name;
+    out.function = function;
+    SsaBuilder(source, out).build();
+}
+
+void writeSsa(const Module &module, const SsaFunction &fn, std::ostream &out) {
+    out << "repr " << fn.name << "\n";
+    for (uint32_t b = 0; b < fn.blocks.size(); ++b) {
+        const SsaBlock &block = fn.blocks[b];
+        out << "b" << b << ":";
+        for (size_t i = 0; i < block.preds.size(); ++i) {
+            out << (i ? ", b" : "  ; preds b") << block.preds[i];
+        }
+        out << "\n";
+        for (uint32_t id : block.insts) {
+            const SsaInst &inst = fn.insts[id];
+            out << "    ";
+            bool results = inst.kind != SSA_CALL ||
+                           module.functions[inst.callee].results.size() == 1;
+            if (inst.kind < SSA_CHECK_STEP) {
+                out << "%" << id;
+                if (results) out << ": " << typeRefName(typeRef(inst.type, inst.length));
+                out << " = ";
+            }
+            const char *op = operatorSymbol(inst.op);
+            switch (inst.kind) {
+                case SSA_PARAM: out << "param " << inst.index; break;
+                case SSA_CONST: out << formatValue(valueFromSlot(inst.type, inst.constant)); break;
+                case SSA_PHI:
+                    out << "phi";
+                    for (size_t i = 0; i < inst.operands.size(); ++i) {
+                        out << (i ? ", [b" : " [b") << block.preds[i] << " %" << inst.operands[i]
+                            << "]";
+                    }
+                    break;
+                case SSA_COPY: out << "copy %" << inst.operands[0] << "  ; slot " << inst.slot; break;
+                case SSA_CONVERT:
+                    out << "convert " << valueTypeName(inst.from) << " %" << inst.operands[0];
+                    break;
+                case SSA_UNARY: out << op << "%" << inst.operands[0]; break;
+                case SSA_BINARY:
+                case SSA_ARRAY_BINARY:
+                    out << "%" << inst.operands[0] << " " << op << " %" << inst.operands[1];
+                    break;
+                case SSA_RANGE:
+                    out << "range %" << inst.operands[0] << " by %" << inst.operands[1] << " to %"
+                        << inst.operands[2];
+                    break;
+                case SSA_CALL:
+                    out << "call " << module.functions[inst.callee].name << "(";
+                    writeOperands(inst, 0, out);
+                    out << ")";
+                    break;
+                case SSA_ARRAY:
+                    out << "{";
+                    writeOperands(inst, 0, out);
+                    out << "}";
+                    break;
+                case SSA_CHECK_STEP: out << "check step %" << inst.operands[0]; break;
+                case SSA_JUMP: out << "jump b" << block.succs[0]; break;
+                case SSA_BRANCH:
+                    out << "branch %" << inst.operands[0] << " b" << block.succs[0] << " b"
+                        << block.succs[1];
+                    break;
+                case SSA_RETURN:
+                    out << (inst.forward ? "return call " : "return");
+                    if (!inst.forward && !inst.operands.empty()) out << " ";
+                    writeOperands(inst, 0, out);
+                    break;
+            }
+            out << "\n";
+        }
+    }
+}
+
+std::vector<uint32_t> reversePostOrder(const SsaFunction &fn) {
+    std::vector<uint32_t> order;
+    std::vector<bool> seen(fn.blocks.size(), false);
+    std::vector<std::pair<uint32_t, size_t>> stack = {{0, 0}};
+    seen[0] = true;
+    while (!stack.empty()) {
+        auto &[block, next] = stack.back();
+        const auto &succs = fn.blocks[block].succs;
+        if (next == succs.size()) {
+            order.push_back(block);
+            stack.pop_back();
+            continue;
+        }
+        uint32_t succ = succs[next++];
+        if (!seen[succ]) {
+            seen[succ] = true;
+            stack.push_back({succ, 0});
+        }
+    }
+    return std::vector<uint32_t>(order.rbegin(), order.rend());
+}
+
+// Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm".
+std::vector<uint32_t> immediateDominators(const SsaFunction &fn,
+                                          const std::vector<uint32_t> &order) {
+    std::vector<uint32_t> rank(fn.blocks.size(), SsaInst::NONE);
+    for (uint32_t i = 0; i < order.size(); ++i) rank[order[i]] = i;
+    std::vector<uint32_t> idom(fn.blocks.size(), SsaInst::NONE);
+    idom[0] = 0;
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t i = 1; i < order.size(); ++i) {
+            uint32_t block = order[i];
+            uint32_t next = SsaInst::NONE;
+            for (uint32_t pred : fn.blocks[block].preds) {
+                if (idom[pred] == SsaInst::NONE) continue;
+                if (next == SsaInst::NONE) {
+                    next = pred;
+                    continue;
+                }
+                uint32_t a = pred, b = next;
+                while (a != b) {
+                    while (rank[a] > rank[b]) a = idom[a];
+                    while (rank[b] > rank[a]) b = idom[b];
+                }
+                next = a;
+            }
+            if (idom[block] != next) {
+                idom[block] = next;
+                changed = true;
+            }
+        }
+    }
+    return idom;
+}
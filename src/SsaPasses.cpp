@@ -0,0 +1,355 @@
+#include "../include/SsaPasses.h"
+
+#include <algorithm>
+#include <numeric>
+#include <unordered_map>
+
+namespace {
+std::vector<uint32_t> identity(const SsaFunction &fn) {
+    std::vector<uint32_t> to(fn.insts.size());
+    std::iota(to.begin(), to.end(), 0);
+    return to;
+}
+
+uint32_t find(const std::vector<uint32_t> &to, uint32_t id) {
+    while (to[id] != id) id = to[id];
+    return id;
+}
+
+// Points every operand at its replacement and drops the replaced
+// instructions from their blocks.
+size_t replace(SsaFunction &fn, const std::vector<uint32_t> &to) {
+    size_t removed = 0;
+    for (auto &block : fn.blocks) {
+        size_t kept = 0;
+        for (uint32_t id : block.insts) {
+            if (to[id] != id) {
+                fn.insts[id].block = SsaInst::NONE;
+                ++removed;
+                continue;
+            }
+            for (uint32_t &operand : fn.insts[id].operands) operand = find(to, operand);
+            block.insts[kept++] = id;
+        }
+        block.insts.resize(kept);
+    }
+    return removed;
+}
+
+bool mayFail(const SsaInst &inst) {
+    switch (inst.kind) {
+        case SSA_CALL:
+        case SSA_CHECK_STEP: return true;
+        case SSA_BINARY:
+        case SSA_ARRAY_BINARY:
+            return (inst.op == OP_DIV || inst.op == OP_MOD) && !isFloating(inst.from);
+        default: return false;
+    }
+}
+
+// Operations whose result depends only on their operands.
+bool isExpression(const Module &module, const SsaInst &inst) {
+    switch (inst.kind) {
+        case SSA_CONST:
+        case SSA_CONVERT:
+        case SSA_UNARY:
+        case SSA_BINARY:
+        case SSA_RANGE:
+        case SSA_ARRAY:
+        case SSA_ARRAY_BINARY: return true;
+        case SSA_CALL: return module.functions[inst.callee].pure;
+        default: return false;
+    }
+}
+
+uint64_t mix(uint64_t hash, uint64_t value) {
+    return (hash ^ value) * 0x100000001b3ULL;
+}
+
+uint64_t expressionHash(const SsaInst &inst) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    hash = mix(hash, inst.kind);
+    hash = mix(hash, inst.op);
+    hash = mix(hash, (static_cast<uint64_t>(inst.type) << 8) | inst.from);
+    hash = mix(hash, (static_cast<uint64_t>(inst.length) << 8) | inst.broadcast);
+    hash = mix(hash, static_cast<uint64_t>(inst.callee));
+    hash = mix(hash, static_cast<uint64_t>(inst.constant.i));
+    for (uint32_t operand : inst.operands) hash = mix(hash, operand);
+    return hash;
+}
+
+bool sameExpression(const SsaInst &a, const SsaInst &b) {
+    return a.kind == b.kind && a.op == b.op && a.type == b.type && a.from == b.from &&
+           a.length == b.length && a.broadcast == b.broadcast && a.callee == b.callee &&
+           a.constant.i == b.constant.i && a.binary == b.binary && a.kernel == b.kernel &&
+           a.operands == b.operands;
+}
+
+bool dominates(const std::vector<uint32_t> &idom, uint32_t a, uint32_t b) {
+    while (b != a) {
+        if (b == 0 || idom[b] == SsaInst::NONE) return false;
+        b = idom[b];
+    }
+    return true;
+}
+
+// Drops blocks the entry cannot reach, with their phi operands in reachable
+// successors, and renumbers the rest in their original order.
+size_t removeUnreachable(SsaFunction &fn) {
+    std::vector<uint32_t> order = reversePostOrder(fn);
+    std::vector<uint32_t> renumber(fn.blocks.size(), SsaInst::NONE);
+    for (uint32_t block : order) renumber[block] = 0;
+    if (order.size() == fn.blocks.size()) return 0;
+
+    size_t removed = 0;
+    std::vector<SsaBlock> kept;
+    for (uint32_t b = 0; b < fn.blocks.size(); ++b) {
+        SsaBlock &block = fn.blocks[b];
+        if (renumber[b] == SsaInst::NONE) {
+            for (uint32_t id : block.insts) fn.insts[id].block = SsaInst::NONE;
+            removed += block.insts.size();
+            continue;
+        }
+        renumber[b] = static_cast<uint32_t>(kept.size());
+        kept.push_back(std::move(block));
+    }
+    for (uint32_t b = 0; b < kept.size(); ++b) {
+        SsaBlock &block = kept[b];
+        std::vector<uint32_t> preds;
+        for (size_t p = 0; p < block.preds.size(); ++p) {
+            if (renumber[block.preds[p]] != SsaInst::NONE) continue;
+            for (uint32_t id : block.insts) {
+                SsaInst &inst = fn.insts[id];
+                if (inst.kind == SSA_PHI) inst.operands[p] = SsaInst::NONE;
+            }
+        }
+        for (uint32_t id : block.insts) {
+            SsaInst &inst = fn.insts[id];
+            inst.block = b;
+            if (inst.kind != SSA_PHI) continue;
+            inst.operands.erase(std::remove(inst.operands.begin(), inst.operands.end(),
+                                            SsaInst::NONE),
+                                inst.operands.end());
+        }
+        for (uint32_t pred : block.preds) {
+            if (renumber[pred] != SsaInst::NONE) preds.push_back(renumber[pred]);
+        }
+        block.preds = std::move(preds);
+        for (uint32_t &succ : block.succs) succ = renumber[succ];
+    }
+    fn.blocks = std::move(kept);
+    return removed;
+}
+}  // namespace
+
+size_t propagateCopies(SsaFunction &fn) {
+    std::vector<uint32_t> to = identity(fn);
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (const auto &block : fn.blocks) {
+            for (uint32_t id : block.insts) {
+                const SsaInst &inst = fn.insts[id];
+                if (to[id] != id) continue;
+                if (inst.kind == SSA_COPY) {
+                    to[id] = find(to, inst.operands[0]);
+                    changed = true;
+                } else if (inst.kind == SSA_PHI) {
+                    // A phi is redundant if it merges one value, possibly with itself.
+                    uint32_t same = SsaInst::NONE;
+                    bool trivial = true;
+                    for (uint32_t operand : inst.operands) {
+                        uint32_t value = find(to, operand);
+                        if (value == id || value == same) continue;
+                        if (same != SsaInst::NONE) {
+                            trivial = false;
+                            break;
+                        }
+                        same = value;
+                    }
+                    if (trivial && same != SsaInst::NONE) {
+                        to[id] = same;
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+    return replace(fn, to);
+}
+
+size_t eliminateCommonSubexpressions(const Module &module, SsaFunction &fn) {
+    std::vector<uint32_t> order = reversePostOrder(fn);
+    std::vector<uint32_t> idom = immediateDominators(fn, order);
+    std::vector<std::vector<uint32_t>> children(fn.blocks.size());
+    for (size_t i = 1; i < order.size(); ++i) children[idom[order[i]]].push_back(order[i]);
+
+    // Values available in the current block are those of its dominators; the
+    // walk undoes a block's entries when it leaves the block's subtree.
+    std::vector<uint32_t> to = identity(fn);
+    std::unordered_map<uint64_t, std::vector<uint32_t>> available;
+    std::vector<uint64_t> undo;
+    struct Frame {
+        uint32_t block;
+        size_t next, mark;
+    };
+    std::vector<Frame> stack;
+    auto enter = [&](uint32_t b) {
+        stack.push_back({b, 0, undo.size()});
+        for (uint32_t id : fn.blocks[b].insts) {
+            SsaInst &inst = fn.insts[id];
+            for (uint32_t &operand : inst.operands) operand = find(to, operand);
+            if (!isExpression(module, inst)) continue;
+            uint64_t hash = expressionHash(inst);
+            auto &bucket = available[hash];
+            auto match = std::find_if(bucket.begin(), bucket.end(), [&](uint32_t other) {
+                return sameExpression(fn.insts[other], inst);
+            });
+            if (match != bucket.end()) {
+                to[id] = *match;
+                continue;
+            }
+            bucket.push_back(id);
+            undo.push_back(hash);
+        }
+    };
+    enter(0);
+    while (!stack.empty()) {
+        Frame &frame = stack.back();
+        if (frame.next < children[frame.block].size()) {
+            enter(children[frame.block][frame.next++]);
+            continue;
+        }
+        while (undo.size() > frame.mark) {
+            available[undo.back()].pop_back();
+            undo.pop_back();
+        }
+        stack.pop_back();
+    }
+    return replace(fn, to);
+}
+
+size_t hoistLoopInvariants(SsaFunction &fn) {
+    std::vector<uint32_t> order = reversePostOrder(fn);
+    std::vector<uint32_t> idom = immediateDominators(fn, order);
+
+    // Natural loops: a back edge latch -> header, where the header dominates
+    // the latch, plus every block that reaches the latch without the header.
+    struct Loop {
+        uint32_t header, preheader;
+        std::vector<bool> blocks;
+        size_t size;
+    };
+    std::vector<Loop> loops;
+    for (uint32_t header : order) {
+        Loop loop{header, SsaInst::NONE, std::vector<bool>(fn.blocks.size(), false), 1};
+        loop.blocks[header] = true;
+        std::vector<uint32_t> work;
+        for (uint32_t pred : fn.blocks[header].preds) {
+            if (dominates(idom, header, pred)) work.push_back(pred);
+        }
+        if (work.empty()) continue;
+        while (!work.empty()) {
+            uint32_t block = work.back();
+            work.pop_back();
+            if (loop.blocks[block] || idom[block] == SsaInst::NONE) continue;
+            loop.blocks[block] = true;
+            ++loop.size;
+            for (uint32_t pred : fn.blocks[block].preds) work.push_back(pred);
+        }
+        // Hoisted code needs a single block that enters the loop and does
+        // nothing else.
+        size_t entries = 0;
+        for (uint32_t pred : fn.blocks[header].preds) {
+            if (loop.blocks[pred]) continue;
+            loop.preheader = pred;
+            ++entries;
+        }
+        if (entries == 1 && fn.blocks[loop.preheader].succs.size() == 1) {
+            loops.push_back(std::move(loop));
+        }
+    }
+    // Inner loops first, so that what leaves them can leave the outer loops too.
+    std::stable_sort(loops.begin(), loops.end(),
+                     [](const Loop &a, const Loop &b) { return a.size < b.size; });
+
+    size_t moved = 0;
+    for (const Loop &loop : loops) {
+        auto &target = fn.blocks[loop.preheader].insts;
+        for (uint32_t b : order) {
+            if (!loop.blocks[b]) continue;
+            auto &insts = fn.blocks[b].insts;
+            size_t kept = 0;
+            for (uint32_t id : insts) {
+                SsaInst &inst = fn.insts[id];
+                bool invariant = inst.kind != SSA_PHI && inst.kind < SSA_CHECK_STEP &&
+                                 !mayFail(inst);
+                for (uint32_t operand : inst.operands) {
+                    invariant = invariant && !loop.blocks[fn.insts[operand].block];
+                }
+                if (!invariant) {
+                    insts[kept++] = id;
+                    continue;
+                }
+                inst.block = loop.preheader;
+                target.insert(target.end() - 1, id);
+                ++moved;
+            }
+            insts.resize(kept);
+        }
+    }
+    return moved;
+}
+
+size_t eliminateDeadCode(SsaFunction &fn) {
+    size_t removed = removeUnreachable(fn);
+    std::vector<bool> live(fn.insts.size(), false);
+    std::vector<uint32_t> work;
+    for (const auto &block : fn.blocks) {
+        for (uint32_t id : block.insts) {
+            const SsaInst &inst = fn.insts[id];
+            if (inst.kind >= SSA_CHECK_STEP || mayFail(inst)) {
+                live[id] = true;
+                work.push_back(id);
+            }
+        }
+    }
+    while (!work.empty()) {
+        uint32_t id = work.back();
+        work.pop_back();
+        for (uint32_t operand : fn.insts[id].operands) {
+            if (live[operand]) continue;
+            live[operand] = true;
+            work.push_back(operand);
+        }
+    }
+    for (auto &block : fn.blocks) {
+        size_t kept = 0;
+        for (uint32_t id : block.insts) {
+            if (live[id]) {
+                block.insts[kept++] = id;
+            } else {
+                fn.insts[id].block = SsaInst::NONE;
+                ++removed;
+            }
+        }
+        block.insts.resize(kept);
+    }
+    return removed;
+}
+
+void optimiseSsa(const Module &module, SsaFunction &fn, std::ostream *dump) {
+    if (dump) {
+        *dump << "; lowered\n";
+        writeSsa(module, fn, *dump);
+    }
+    auto after = [&](const char *pass, size_t changed) {
+        if (!dump) return;
+        *dump << "; after " << pass << ": " << changed << " changed\n";
+        writeSsa(module, fn, *dump);
+    };
+    after("copy propagation", propagateCopies(fn));
+    // Hoisted values dominate more of the function, so they are numbered after.
+    after("loop-invariant code motion", hoistLoopInvariants(fn));
+    after("common subexpression elimination", eliminateCommonSubexpressions(module, fn));
+    after("dead code elimination", eliminateDeadCode(fn));
+}
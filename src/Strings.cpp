@@ -0,0 +1,130 @@
+#include "../include/Strings.h"
+
+#include "../include/Module.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+const size_t kFirstBlock = 4096;
+const size_t kMaxBlock = 1 << 20;
+
+Slot inlineString(std::string_view text) {
+    Slot slot{};
+    char *bytes = reinterpret_cast<char *>(&slot);
+    bytes[0] = static_cast<char>((text.size() << 1) | 1);
+    std::memcpy(bytes + 1, text.data(), text.size());
+    return slot;
+}
+}  // namespace
+
+bool equalStrings(Slot lhs, Slot rhs) {
+    if (lhs.i == rhs.i) return true;
+    // Only strings longer than kMaxInlineString have buffers.
+    if (isInlineString(lhs) || isInlineString(rhs) || !lhs.i || !rhs.i) return false;
+    return stringView(lhs) == stringView(rhs);
+}
+
+int compareStrings(Slot lhs, Slot rhs) {
+    if (lhs.i == rhs.i) return 0;
+    return stringView(lhs).compare(stringView(rhs));
+}
+
+char *StringHeap::Region::allocate(size_t size, size_t align, size_t room) {
+    char *at = top ? reinterpret_cast<char *>(
+                         (reinterpret_cast<uintptr_t>(top) + align - 1) & ~(align - 1))
+                   : nullptr;
+    if (!at || size > static_cast<size_t>(limit - at)) {
+        size_t block = sizes.empty() ? kFirstBlock : std::min(kMaxBlock, sizes.back() * 2);
+        block = std::max(block, size + room);
+        blocks.push_back(std::make_unique<char[]>(block));
+        sizes.push_back(block);
+        held += block;
+        at = begin = blocks.back().get();
+        limit = begin + block;
+    }
+    top = at + size;
+    return at;
+}
+
+void StringHeap::Region::clear() {
+    if (blocks.empty()) return;
+    size_t largest = std::max_element(sizes.begin(), sizes.end()) - sizes.begin();
+    std::swap(blocks[0], blocks[largest]);
+    std::swap(sizes[0], sizes[largest]);
+    blocks.resize(1);
+    sizes.resize(1);
+    held = sizes[0];
+    begin = top = blocks[0].get();
+    limit = begin + sizes[0];
+}
+
+Slot StringHeap::buffer(const char *data, size_t size) {
+    auto *buffer = reinterpret_cast<StringBuffer *>(
+        buffers_.allocate(sizeof(StringBuffer), alignof(StringBuffer)));
+    buffer->data = data;
+    buffer->size = size;
+    Slot slot;
+    slot.i = static_cast<int64_t>(reinterpret_cast<uintptr_t>(buffer));
+    return slot;
+}
+
+Slot StringHeap::make(std::string_view text) {
+    if (text.size() <= kMaxInlineString) return inlineString(text);
+    char *data = text_.allocate(text.size(), 1);
+    std::memcpy(data, text.data(), text.size());
+    return buffer(data, text.size());
+}
+
+Slot StringHeap::concat(Slot lhs, Slot rhs) {
+    std::string_view a = stringView(lhs), b = stringView(rhs);
+    if (b.empty()) return lhs;
+    if (a.empty()) return rhs;
+    size_t size = a.size() + b.size();
+    if (size <= kMaxInlineString) {
+        Slot slot = inlineString(a);
+        char *bytes = reinterpret_cast<char *>(&slot);
+        bytes[0] = static_cast<char>((size << 1) | 1);
+        std::memcpy(bytes + 1 + a.size(), b.data(), b.size());
+        return slot;
+    }
+    // `lhs` keeps its own size, so text written after it does not change it.
+    if (!isInlineString(lhs) && a.data() >= text_.begin && a.data() + a.size() == text_.top &&
+        b.size() <= static_cast<size_t>(text_.limit - text_.top)) {
+        std::memcpy(text_.top, b.data(), b.size());
+        text_.top += b.size();
+        return buffer(a.data(), size);
+    }
+    // Room for as much again keeps a string grown by appending at amortised
+    // linear cost once it outgrows the blocks.
+    char *data = text_.allocate(size, 1, size);
+    std::memcpy(data, a.data(), a.size());
+    std::memcpy(data + a.size(), b.data(), b.size());
+    return buffer(data, size);
+}
+
+Slot StringHeap::copy(Slot slot) {
+    if (isInlineString(slot) || slot.i == 0) return slot;
+    return make(stringView(slot));
+}
+
+void StringHeap::clear() {
+    text_.clear();
+    buffers_.clear();
+}
+
+size_t StringHeap::footprint() const { return text_.held + buffers_.held; }
+
+Slot StringPool::intern(std::string_view text) {
+    if (text.size() <= kMaxInlineString) return inlineString(text);
+    auto it = index_.find(text);
+    if (it != index_.end()) return it->second;
+    Slot slot = heap_.make(text);
+    index_.emplace(stringView(slot), slot);
+    return slot;
+}
+
+Slot slotFromValue(const Value &value, StringHeap &heap) {
+    if (value.type == VALUE_STRINGA) return heap.make(value.s);
+    return slotFromValue(value);
+}
@@ -0,0 +1,366 @@
+#include "../include/TableParser.h"
+
+#include "../include/NumberLiteral.h"
+
+#include "GrammarTables.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <string_view>
+#include <unordered_map>
+
+namespace {
+const uint16_t kInvalid = grammar::kTerminalCount;  // unscannable input
+const uint32_t kClose = 0x10000;                    // Frame: emit the rule's token
+
+bool isDigitChar(char c) {
+    return std::isdigit(static_cast<unsigned char>(c)) != 0;
+}
+
+enum NESTING : uint8_t { NEST_NONE, NEST_OPEN, NEST_CLOSE, NEST_OPERATOR, NEST_SEPARATOR };
+
+const std::array<NESTING, grammar::kTerminalCount> &nesting() {
+    static const std::array<NESTING, grammar::kTerminalCount> table = [] {
+        std::array<NESTING, grammar::kTerminalCount> out{};
+        for (const auto &punctuator : grammar::kPunctuators) {
+            std::string_view text(punctuator.text);
+            NESTING &kind = out[punctuator.terminal];
+            if (text == "(" || text == "[" || text == "{") {
+                kind = NEST_OPEN;
+            } else if (text == ")" || text == "]" || text == "}") {
+                kind = NEST_CLOSE;
+            } else if (text == ";" || text == ",") {
+                kind = NEST_SEPARATOR;
+            } else if (text != "->" && text != ":" && text != "=" && text != "#") {
+                kind = NEST_OPERATOR;
+            }
+        }
+        return out;
+    }();
+    return table;
+}
+
+uint16_t keywordOf(std::string_view word) {
+    static const std::unordered_map<std::string_view, uint16_t> keywords = [] {
+        std::unordered_map<std::string_view, uint16_t> table;
+        for (const auto &keyword : grammar::kKeywords) table.emplace(keyword.text, keyword.terminal);
+        return table;
+    }();
+    auto it = keywords.find(word);
+    return it == keywords.end() ? grammar::kIdentifier : it->second;
+}
+}  // namespace
+
+TableParser::TableParser(std::pmr::memory_resource *resource)
+    : TableParser(std::string(), resource) {}
+
+TableParser::TableParser(const std::string &program, std::pmr::memory_resource *resource)
+    : program_(program, resource),
+      tokens_(resource),
+      symbols_(resource),
+      status_(PARSE_OK),
+      stack_(resource),
+      buffered_(0),
+      index_(0),
+      row_(1),
+      lastNewLineIndex_(-1),
+      lastEnd_(0),
+      ruleCalls_(0),
+      levels_(resource),
+      depth_(0),
+      depthReached_(0),
+      originRow_(1),
+      originColumn_(1) {}
+
+void TableParser::setOptions(const ParseOptions &options) { options_ = options; }
+
+void TableParser::setMaxDepth(uint32_t depth) { options_.maxDepth = depth; }
+
+void TableParser::setOrigin(uint32_t row, uint32_t column) {
+    originRow_ = row;
+    originColumn_ = column;
+}
+
+void TableParser::reset() {
+    index_ = 0;
+    row_ = originRow_;
+    lastNewLineIndex_ = -static_cast<int64_t>(originColumn_);
+    lastEnd_ = 0;
+    ruleCalls_ = 0;
+    depth_ = 0;
+    depthReached_ = 0;
+    levels_.clear();
+    buffered_ = 0;
+    tokens_.clear();
+    stack_.clear();
+    symbols_.clear();
+    status_ = PARSE_OK;
+    error_.clear();
+    scanError_.clear();
+}
+
+const std::pmr::vector<Token> &TableParser::tokens() const { return tokens_; }
+
+const Interner &TableParser::symbols() const { return symbols_; }
+
+PARSE_STATUS TableParser::status() const { return status_; }
+
+const std::string &TableParser::error() const { return error_; }
+
+uint32_t TableParser::depthReached() const { return depthReached_; }
+
+bool TableParser::parseProgram() {
+    reset();
+    const auto &kinds = nesting();
+    stack_.push_back({grammar::kRuleBit | grammar::kStartRule, 0, 0, 0});
+    while (!stack_.empty()) {
+        if (options_.maxTokens && tokens_.size() > options_.maxTokens) {
+            return fail(lookahead(0),
+                        "more than " + std::to_string(options_.maxTokens) + " tokens",
+                        PARSE_TOKEN_LIMIT);
+        }
+        Frame frame = stack_.back();
+        stack_.pop_back();
+        if (frame.symbol & kClose) {
+            uint16_t rule = frame.symbol & grammar::kSymbolMask;
+            // The program also covers trailing whitespace, as in Lexer.
+            uint32_t end = rule == grammar::kStartRule ? static_cast<uint32_t>(program_.size())
+                                                       : std::max(lastEnd_, frame.offset);
+            TOKEN_TYPE type = static_cast<TOKEN_TYPE>(grammar::kRules[rule].token);
+            emitToken(type, frame.offset, end, frame.row, frame.column);
+            if (type == ARROW_NODE) tokens_.back().symbol = symbols_.intern(tokens_.back().lexeme);
+            continue;
+        }
+
+        uint16_t symbol = frame.symbol & grammar::kSymbolMask;
+        const Lexeme &next = lookahead(0);
+        if (!(frame.symbol & grammar::kRuleBit)) {
+            if (next.terminal != symbol) {
+                return fail(next, std::string("expected ") + grammar::kTerminalNames[symbol] +
+                                      ", found " + describe(next));
+            }
+            if ((frame.symbol & grammar::kGlued) && next.offset != lastEnd_) {
+                return fail(next, std::string("expected ") + grammar::kTerminalNames[symbol] +
+                                      " directly after the previous token");
+            }
+            // Every operator adds a level to the tree built from its chain,
+            // up to the end of the bracket, statement or argument it is in.
+            switch (kinds[symbol]) {
+                case NEST_OPEN:
+                    levels_.push_back(depth_);
+                    ++depth_;
+                    break;
+                case NEST_CLOSE:
+                    depth_ = levels_.empty() ? 0 : levels_.back();
+                    if (!levels_.empty()) levels_.pop_back();
+                    break;
+                case NEST_OPERATOR: ++depth_; break;
+                case NEST_SEPARATOR: depth_ = levels_.empty() ? 0 : levels_.back() + 1; break;
+                default: break;
+            }
+            if (depth_ > depthReached_) {
+                depthReached_ = depth_;
+                if (options_.maxDepth && depth_ > options_.maxDepth) {
+                    return fail(next,
+                                "nesting deeper than " + std::to_string(options_.maxDepth) +
+                                    " levels",
+                                PARSE_DEPTH_LIMIT);
+                }
+            }
+            std::string_view text(program_.data() + next.offset, next.end - next.offset);
+            switch (symbol) {
+                case grammar::kIdentifier:
+                    emitToken(IDENTIFIER, next.offset, next.end, next.row, next.column);
+                    tokens_.back().symbol = symbols_.intern(text);
+                    break;
+                case grammar::kIntegerLiteral:
+                    emitToken(INTEGER_LITERAL, next.offset, next.end, next.row, next.column);
+                    tokens_.back().integer = next.integer;
+                    break;
+                case grammar::kFloatLiteral:
+                    emitToken(FLOAT_LITERAL, next.offset, next.end, next.row, next.column);
+                    tokens_.back().real = next.real;
+                    break;
+                case grammar::kCharLiteral:
+                    emitToken(CHAR_LITERAL, next.offset, next.end, next.row, next.column);
+                    break;
+                case grammar::kStringLiteral:
+                    emitToken(STRING_LITERAL, next.offset, next.end, next.row, next.column);
+                    break;
+                default: break;
+            }
+            lastEnd_ = next.end;
+            advance();
+            continue;
+        }
+
+        ++ruleCalls_;
+        if (options_.maxRuleCalls && ruleCalls_ > options_.maxRuleCalls) {
+            return fail(next, "more than " + std::to_string(options_.maxRuleCalls) + " rule calls",
+                        PARSE_RULE_LIMIT);
+        }
+        if (options_.cancel && ruleCalls_ % CANCEL_CHECK_INTERVAL == 0 &&
+            options_.cancel->load(std::memory_order_relaxed)) {
+            return fail(next, "parse cancelled", PARSE_CANCELLED);
+        }
+        int16_t production = next.terminal < grammar::kTerminalCount
+                                 ? grammar::kPredict[symbol][next.terminal]
+                                 : -1;
+        if (production < -1) {
+            uint16_t second = lookahead(1).terminal;
+            production = second < grammar::kTerminalCount
+                             ? grammar::kPredict2[-2 - production][second]
+                             : -1;
+        }
+        if (production < 0) {
+            if (next.terminal == kInvalid) return fail(next, scanError_);
+            return fail(next, "unexpected " + describe(next) + " in " + grammar::kRules[symbol].name +
+                                  ", expected " + expected(symbol));
+        }
+        if (grammar::kRules[symbol].token >= 0) {
+            stack_.push_back({kClose | symbol, next.offset, next.row, next.column});
+        }
+        const grammar::Production &rhs = grammar::kProductions[production];
+        for (uint16_t i = rhs.count; i-- > 0;) {
+            stack_.push_back({grammar::kRhs[rhs.first + i], 0, 0, 0});
+        }
+    }
+    return true;
+}
+
+bool TableParser::parseProgram(const std::string &program) {
+    program_.assign(program);
+    return parseProgram();
+}
+
+void TableParser::next() {
+    char c = program_[index_++];
+    if (c == '\n' || c == '\r') {
+        ++row_;
+        lastNewLineIndex_ = static_cast<int64_t>(index_) - 1;
+    }
+}
+
+void TableParser::skipWhitespace() {
+    while (index_ < program_.size()) {
+        char c = program_[index_];
+        if (c != ' ' && c != '\t' && c != '\r' && c != '\n') break;
+        next();
+    }
+}
+
+bool TableParser::isIdentifierChar(size_t index, size_t &advance) const {
+    if (index >= program_.size()) return false;
+    unsigned char c = static_cast<unsigned char>(program_[index]);
+    if (c < 0x80) {
+        advance = 1;
+        return std::isalnum(c) || c == '_';
+    }
+    // А-Я and а-я are U+0410..U+044F, two bytes each: D0 90..D0 BF, D1 80..D1 8F.
+    if (index + 1 >= program_.size()) return false;
+    unsigned char c1 = static_cast<unsigned char>(program_[index + 1]);
+    advance = 2;
+    return (c == 0xD0 && c1 >= 0x90 && c1 <= 0xBF) || (c == 0xD1 && c1 >= 0x80 && c1 <= 0x8F);
+}
+
+void TableParser::scan(Lexeme &out) {
+    skipWhitespace();
+    out.offset = static_cast<uint32_t>(index_);
+    out.row = row_;
+    out.column = static_cast<uint32_t>(static_cast<int64_t>(index_) - lastNewLineIndex_);
+    out.terminal = kInvalid;
+    size_t advance = 0;
+    if (index_ >= program_.size()) {
+        out.terminal = grammar::kEnd;
+    } else if (isDigitChar(program_[index_])) {
+        NumberLiteral number = scanNumber(std::string_view(program_).substr(index_));
+        index_ += number.length;
+        if (!number.inRange) {
+            scanError_ = "numeric literal out of range";
+        } else if (number.type == FLOAT_LITERAL) {
+            out.terminal = grammar::kFloatLiteral;
+            out.real = number.real;
+        } else {
+            out.terminal = grammar::kIntegerLiteral;
+            out.integer = number.integer;
+        }
+    } else if (isIdentifierChar(index_, advance)) {
+        do {
+            index_ += advance;
+        } while (isIdentifierChar(index_, advance));
+        out.terminal = keywordOf(std::string_view(program_).substr(out.offset, index_ - out.offset));
+    } else if (program_[index_] == '\'') {
+        size_t at = index_ + 1;
+        if (isIdentifierChar(at, advance)) at += advance;
+        if (at < program_.size() && program_[at] == '\'') {
+            index_ = at + 1;
+            out.terminal = grammar::kCharLiteral;
+        } else {
+            scanError_ = "malformed character literal";
+        }
+    } else if (program_[index_] == '"') {
+        size_t at = index_ + 1;
+        while (isIdentifierChar(at, advance)) at += advance;
+        if (at < program_.size() && program_[at] == '"') {
+            index_ = at + 1;
+            out.terminal = grammar::kStringLiteral;
+        } else {
+            scanError_ = "malformed string literal";
+        }
+    } else {
+        // Punctuators are listed longest first.
+        for (const auto &punctuator : grammar::kPunctuators) {
+            std::string_view text(punctuator.text);
+            if (program_.compare(index_, text.size(), text) == 0) {
+                index_ += text.size();
+                out.terminal = punctuator.terminal;
+                break;
+            }
+        }
+        if (out.terminal == kInvalid) scanError_ = "unexpected character";
+    }
+    out.end = static_cast<uint32_t>(index_);
+}
+
+const TableParser::Lexeme &TableParser::lookahead(size_t k) {
+    while (buffered_ <= k) scan(ahead_[buffered_++]);
+    return ahead_[k];
+}
+
+void TableParser::advance() {
+    ahead_[0] = ahead_[1];
+    --buffered_;
+}
+
+void TableParser::emitToken(TOKEN_TYPE type, uint32_t offset, uint32_t end, uint32_t row,
+                            uint32_t column) {
+    tokens_.push_back({type, row, column, offset,
+                       std::string_view(program_).substr(offset, end - offset), UINT32_MAX, {}});
+}
+
+bool TableParser::fail(const Lexeme &at, const std::string &message, PARSE_STATUS status) {
+    status_ = status;
+    error_ = std::to_string(at.row) + ":" + std::to_string(at.column) + ": " + message;
+    return false;
+}
+
+std::string TableParser::describe(const Lexeme &lexeme) const {
+    if (lexeme.terminal == grammar::kEnd) return "end of input";
+    size_t length = std::max(lexeme.end, lexeme.offset + 1) - lexeme.offset;
+    return "'" + std::string(std::string_view(program_).substr(lexeme.offset, length)) + "'";
+}
+
+std::string TableParser::expected(uint16_t rule) const {
+    std::string out;
+    int listed = 0;
+    for (uint16_t t = 0; t < grammar::kTerminalCount; ++t) {
+        if (grammar::kPredict[rule][t] == -1) continue;
+        if (listed++ == 6) {
+            out += ", ...";
+            break;
+        }
+        out += (out.empty() ? "" : ", ") + std::string(grammar::kTerminalNames[t]);
+    }
+    return out;
+}
@@ -0,0 +1,47 @@
+#include "../include/ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned threads) {
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+    workers_.reserve(threads);
+    for (unsigned i = 0; i < threads; ++i) workers_.emplace_back([this] { work(); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    ready_.notify_all();
+    for (auto &worker : workers_) worker.join();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+    }
+    ready_.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this] { return tasks_.empty() && active_ == 0; });
+}
+
+unsigned ThreadPool::size() const { return static_cast<unsigned>(workers_.size()); }
+
+void ThreadPool::work() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        ready_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+        if (tasks_.empty()) return;
+        std::function<void()> task = std::move(tasks_.front());
+        tasks_.pop_front();
+        ++active_;
+        lock.unlock();
+        task();
+        lock.lock();
+        if (--active_ == 0 && tasks_.empty()) idle_.notify_all();
+    }
+}
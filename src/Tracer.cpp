@@ -0,0 +1,133 @@
+#include "../include/Tracer.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <string>
+
+namespace {
+std::atomic<uint64_t> nextTracer{1};
+
+// The ring of the tracer this thread used last; tracer ids are never reused,
+// so a destroyed tracer's ring is not picked up by a new one.
+struct ThreadRing {
+    uint64_t tracer = 0;
+    TraceRing *ring = nullptr;
+};
+thread_local ThreadRing threadRing;
+
+size_t roundUp(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) size <<= 1;
+    return size;
+}
+
+std::string payloadText(const Arrow &arrow, const Transfer &transfer) {
+    std::string text;
+    for (uint32_t i = 0; i < transfer.count; ++i) {
+        const ArrowArg &arg = arrow.args[transfer.first + i];
+        if (arg.source >= 0) continue;
+        if (!text.empty()) text += ", ";
+        text += formatValue(arg.value);
+    }
+    return text;
+}
+
+void writeEscaped(std::ostream &out, const std::string &text) {
+    out << '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            out << ' ';
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+}  // namespace
+
+TraceRing::TraceRing(size_t capacity)
+    : events_(new TraceEvent[roundUp(capacity)]), mask_(roundUp(capacity) - 1) {}
+
+void TraceRing::snapshot(std::vector<TraceEvent> &out) const {
+    out.clear();
+    // Event `head` may be being written, into the slot of `head` - capacity,
+    // so the oldest event that can be whole is `head` + 1 - capacity.
+    uint64_t head = head_.load(std::memory_order_acquire);
+    uint64_t first = head > mask_ ? head - mask_ : 0;
+    for (uint64_t i = first; i < head; ++i) out.push_back(events_[i & mask_]);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    // Slots the owner reached again while we copied hold newer events.
+    uint64_t now = head_.load(std::memory_order_relaxed);
+    uint64_t valid = now > mask_ ? now - mask_ : 0;
+    if (valid > first) {
+        out.erase(out.begin(), out.begin() + static_cast<ptrdiff_t>(std::min(valid, head) - first));
+    }
+}
+
+Tracer::Tracer(size_t eventsPerThread)
+    : id_(nextTracer.fetch_add(1)),
+      capacity_(eventsPerThread ? eventsPerThread : 1),
+      startTicks_(TraceRing::ticks()),
+      start_(std::chrono::steady_clock::now()) {}
+
+TraceRing &Tracer::ring() {
+    if (threadRing.tracer == id_) return *threadRing.ring;
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::thread::id self = std::this_thread::get_id();
+    size_t index = std::find(owners_.begin(), owners_.end(), self) - owners_.begin();
+    if (index == rings_.size()) {
+        rings_.push_back(std::make_unique<TraceRing>(capacity_));
+        owners_.push_back(self);
+    }
+    threadRing = ThreadRing{id_, rings_[index].get()};
+    return *threadRing.ring;
+}
+
+// Ticks are converted to microseconds with the rate measured between the
+// tracer's construction and now.
+void Tracer::writeChromeTrace(const Module &module, std::ostream &out) {
+    uint64_t ticks = TraceRing::ticks();
+    double elapsedUs = std::chrono::duration<double, std::micro>(
+                           std::chrono::steady_clock::now() - start_)
+                           .count();
+    double usPerTick = ticks > startTicks_ ? elapsedUs / static_cast<double>(ticks - startTicks_)
+                                           : 1e-3;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<TraceEvent> events;
+    bool first = true;
+    out << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+    for (size_t tid = 0; tid < rings_.size(); ++tid) {
+        rings_[tid]->snapshot(events);
+        size_t depth = 0;
+        for (const TraceEvent &event : events) {
+            if (event.kind == TRACE_EXIT && depth == 0) continue;  // entry was overwritten
+            double ts = static_cast<double>(event.ticks - startTicks_) * usPerTick;
+            out << (first ? "\n" : ",\n");
+            first = false;
+            if (event.kind == TRACE_TRANSFER) {
+                const Arrow &arrow = module.arrows[event.arrow];
+                const Transfer &transfer = arrow.transfers[event.id];
+                out << "{\"name\":";
+                writeEscaped(out, arrow.nodes[transfer.from].name + " -> " +
+                                      arrow.nodes[transfer.to].name);
+                out << ",\"cat\":\"transfer\",\"ph\":\"i\",\"s\":\"t\",\"ts\":" << ts
+                    << ",\"pid\":1,\"tid\":" << tid << ",\"args\":{\"block\":";
+                writeEscaped(out, arrow.name);
+                out << ",\"transfer\":" << event.id << ",\"payload\":" << transfer.first
+                    << ",\"literals\":";
+                writeEscaped(out, payloadText(arrow, transfer));
+                out << "}}";
+                continue;
+            }
+            depth = event.kind == TRACE_ENTER ? depth + 1 : depth - 1;
+            out << "{\"name\":";
+            writeEscaped(out, module.functions[event.id].name);
+            out << ",\"cat\":\"repr\",\"ph\":\"" << (event.kind == TRACE_ENTER ? 'B' : 'E')
+                << "\",\"ts\":" << ts << ",\"pid\":1,\"tid\":" << tid << "}";
+        }
+    }
+    out << "\n]}\n" << std::defaultfloat;
+}
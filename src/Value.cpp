@@ -0,0 +1,167 @@
+#include "../include/Value.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+
+bool valueTypeFromName(const std::string &name, VALUE_TYPE &out) {
+    static const struct {
+        const char *name;
+        VALUE_TYPE type;
+    } kNames[] = {{"i8", VALUE_I8},     {"i16", VALUE_I16},
+                  {"i32", VALUE_I32},   {"i64", VALUE_I64},
+                  {"f32", VALUE_F32},   {"f64", VALUE_F64},
+                  {"char", VALUE_CHAR}, {"stringa", VALUE_STRINGA},
+                  {"bool", VALUE_BOOL}};
+    for (const auto &entry : kNames) {
+        if (name == entry.name) {
+            out = entry.type;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *valueTypeName(VALUE_TYPE type) {
+    switch (type) {
+        case VALUE_I8: return "i8";
+        case VALUE_I16: return "i16";
+        case VALUE_I32: return "i32";
+        case VALUE_I64: return "i64";
+        case VALUE_F32: return "f32";
+        case VALUE_F64: return "f64";
+        case VALUE_CHAR: return "char";
+        case VALUE_STRINGA: return "stringa";
+        case VALUE_BOOL: return "bool";
+    }
+    return "?";
+}
+
+int64_t wrapInteger(VALUE_TYPE type, int64_t value) {
+    switch (type) {
+        case VALUE_I8: return static_cast<int8_t>(value);
+        case VALUE_I16: return static_cast<int16_t>(value);
+        case VALUE_I32: return static_cast<int32_t>(value);
+        case VALUE_CHAR: return static_cast<uint32_t>(value);
+        case VALUE_BOOL: return value != 0;
+        default: return value;
+    }
+}
+
+bool constantFits(const Value &value, VALUE_TYPE target) {
+    if (isSignedInteger(value.type) && isSignedInteger(target)) {
+        return wrapInteger(target, value.i) == value.i;
+    }
+    if (isFloating(value.type) && target == VALUE_F32) {
+        return !std::isfinite(value.f) || std::fabs(value.f) <= FLT_MAX;
+    }
+    return true;
+}
+
+Value makeInteger(VALUE_TYPE type, int64_t value) {
+    Value v;
+    v.type = type;
+    v.i = wrapInteger(type, value);
+    return v;
+}
+
+Value makeFloat(VALUE_TYPE type, double value) {
+    Value v;
+    v.type = type;
+    v.f = type == VALUE_F32 ? static_cast<float>(value) : value;
+    return v;
+}
+
+Value makeBool(bool value) { return makeInteger(VALUE_BOOL, value ? 1 : 0); }
+
+Value makeString(const std::string &text) {
+    Value v;
+    v.type = VALUE_STRINGA;
+    v.s = text;
+    return v;
+}
+
+bool isTruthy(const Value &value) {
+    if (isFloating(value.type)) return value.f != 0.0;
+    if (value.type == VALUE_STRINGA) return !value.s.empty();
+    return value.i != 0;
+}
+
+bool convertValue(const Value &value, VALUE_TYPE target, Value &out) {
+    if (value.type == target) {
+        out = value;
+        return true;
+    }
+    if (value.type == VALUE_STRINGA || target == VALUE_STRINGA) return false;
+    if (isFloating(target)) {
+        double d = isFloating(value.type) ? value.f : static_cast<double>(value.i);
+        out = makeFloat(target, d);
+        return true;
+    }
+    if (target == VALUE_BOOL) {
+        out = makeBool(isTruthy(value));
+        return true;
+    }
+    if (isFloating(value.type)) {
+        if (!std::isfinite(value.f)) return false;
+        out = makeInteger(target, static_cast<int64_t>(value.f));
+        return true;
+    }
+    out = makeInteger(target, value.i);
+    return true;
+}
+
+bool sameValue(const Value &a, const Value &b) {
+    if (a.type != b.type) return false;
+    if (isFloating(a.type)) return a.f == b.f;
+    if (a.type == VALUE_STRINGA) return a.s == b.s;
+    return a.i == b.i;
+}
+
+std::string formatValue(const Value &value) {
+    switch (value.type) {
+        case VALUE_F32:
+        case VALUE_F64: {
+            char buffer[32];
+            std::snprintf(buffer, sizeof(buffer), "%g", value.f);
+            return buffer;
+        }
+        case VALUE_CHAR: {
+            std::string out = "'";
+            uint32_t cp = static_cast<uint32_t>(value.i);
+            if (cp < 0x80) {
+                if (cp) out += static_cast<char>(cp);
+            } else if (cp < 0x800) {
+                out += static_cast<char>(0xC0 | (cp >> 6));
+                out += static_cast<char>(0x80 | (cp & 0x3F));
+            } else {
+                out += static_cast<char>(0xE0 | (cp >> 12));
+                out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (cp & 0x3F));
+            }
+            return out + "'";
+        }
+        case VALUE_STRINGA: return "\"" + value.s + "\"";
+        case VALUE_BOOL: return value.i ? "true" : "false";
+        default: return std::to_string(value.i);
+    }
+}
+
+bool parseValue(const std::string &text, Value &value) {
+    if (text.size() >= 2 && text.front() == '"' && text.back() == '"') {
+        value = makeString(text.substr(1, text.size() - 2));
+        return true;
+    }
+    std::istringstream in(text);
+    if (text.find_first_of(".eE") != std::string::npos) {
+        double f;
+        if (!(in >> f) || !in.eof()) return false;
+        value = makeFloat(VALUE_F64, f);
+    } else {
+        int64_t i;
+        if (!(in >> i) || !in.eof()) return false;
+        value = makeInteger(VALUE_I64, i);
+    }
+    return true;
+}
@@ -1,14 +1,36 @@
+#include "../include/ArrowFusion.h"
+#include "../include/ArrowGraph.h"
+#include "../include/Ast.h"
+#include "../include/Build.h"
+#include "../include/Compiler.h"
+#include "../include/ExprDag.h"
+#include "../include/ConstantFolder.h"
+#include "../include/Interpreter.h"
+#include "../include/LazyProgram.h"
 #include "../include/Lexer.h"
+#include "../include/ParseFuzzer.h"
+#include "../include/Profiler.h"
+#include "../include/Server.h"
+#include "../include/SsaPasses.h"
+#include "../include/Strings.h"
+#include "../include/TableParser.h"
+#include "../include/Tracer.h"
 #include "../include/Token.h"
 
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 #include <string>
+#include <vector>
 
 std::string tokenName(TOKEN_TYPE type) {
     switch (type) {
         case LETTER: return "LETTER";
         case RU_LETTER: return "RU_LETTER";
-        case DIGIT: return "DIGIT";
         case ANY: return "ANY";
         case IDENTIFIER: return "IDENTIFIER";
         case INTEGER_LITERAL: return "INTEGER_LITERAL";
@@ -64,7 +86,485 @@ std::string tokenName(TOKEN_TYPE type) {
     return "UNKNOWN";
 }
 
-int main() {
+bool parseCount(const char *text, uint32_t &out) {
+    const char *end = text + std::strlen(text);
+    auto res = std::from_chars(text, end, out);
+    return res.ec == std::errc() && res.ptr == end;
+}
+
+bool readFile(const char *path, std::string &text) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Cannot open " << path << "\n";
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    text = buffer.str();
+    return true;
+}
+
+bool loadProgram(const char *path, Program &program) {
+    std::string text;
+    if (!readFile(path, text)) return false;
+    TableParser parser(text);
+    if (!parser.parseProgram()) {
+        std::cerr << path << ":" << parser.error() << "\n";
+        return false;
+    }
+    std::string error;
+    if (!buildProgram(parser.tokens(), parser.symbols(), program, error)) {
+        std::cerr << "Failed to build syntax tree: " << error << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Hit and miss counters of every result cache that was consulted.
+void printMemoReport(const Module &module, const Interpreter &interpreter) {
+    for (size_t i = 0; i < module.functions.size(); ++i) {
+        const MemoCache &memo = interpreter.memo(static_cast<int32_t>(i));
+        if (memo.hits() + memo.misses() == 0) continue;
+        std::cerr << "Memo " << module.functions[i].name << ": " << memo.hits() << " hits, "
+                  << memo.misses() << " misses, " << memo.evictions() << " evictions, "
+                  << memo.size() << "/" << memo.capacity() << " entries\n";
+    }
+}
+
+// Options between the command and the file of run, flow and batch:
+//   --lazy              parse only what the run can reach (run and flow)
+//   --profile[=<path>]  report to stderr, folded stacks to <path>
+//   --trace=<path>      Chrome trace of every call and transfer
+//   --edges=<path>      transfer counts, the input of a later --fuse
+//   --fuse=<path>       fuse the arrow chains those counts show as taken
+//   --threads=<n>       threads of parallel loops, 1 runs them sequentially
+//   --memo-stats        hits and misses of the result caches to stderr
+struct RunOptions {
+    bool lazy = false;
+    bool profile = false;
+    bool memoStats = false;
+    std::string folded;
+    std::string trace;
+    std::string edges;
+    std::string fuse;
+    unsigned threads = 0;  // 0: one per hardware thread
+
+    bool profiled() const { return profile || !edges.empty(); }
+};
+
+// Removes the leading options from argv, so argv[2] is the file afterwards.
+bool takeRunOptions(int &argc, char **&argv, bool allowLazy, RunOptions &options) {
+    while (argc > 2 && std::strncmp(argv[2], "--", 2) == 0) {
+        std::string option = argv[2];
+        if (allowLazy && option == "--lazy") {
+            options.lazy = true;
+        } else if (option == "--profile") {
+            options.profile = true;
+        } else if (option == "--memo-stats") {
+            options.memoStats = true;
+        } else if (option.rfind("--profile=", 0) == 0 && option.size() > 10) {
+            options.profile = true;
+            options.folded = option.substr(10);
+        } else if (option.rfind("--trace=", 0) == 0 && option.size() > 8) {
+            options.trace = option.substr(8);
+        } else if (option.rfind("--edges=", 0) == 0 && option.size() > 8) {
+            options.edges = option.substr(8);
+        } else if (option.rfind("--fuse=", 0) == 0 && option.size() > 7) {
+            options.fuse = option.substr(7);
+        } else if (option.rfind("--threads=", 0) == 0) {
+            if (!parseCount(option.c_str() + 10, options.threads) || options.threads == 0) {
+                std::cerr << "Invalid thread count '" << option.substr(10) << "'\n";
+                return false;
+            }
+        } else {
+            std::cerr << "Unknown option '" << option << "'\n";
+            return false;
+        }
+        ++argv;
+        --argc;
+    }
+    return true;
+}
+
+bool fuseChains(Module &module, const RunOptions &options) {
+    if (options.fuse.empty()) return true;
+    std::ifstream in(options.fuse);
+    EdgeCounts counts;
+    std::string error;
+    if (!in) {
+        std::cerr << "Cannot read " << options.fuse << "\n";
+        return false;
+    }
+    if (!readEdgeCounts(module, in, counts, error)) {
+        std::cerr << options.fuse << ": " << error << "\n";
+        return false;
+    }
+    std::cerr << "Fused " << fuseArrowChains(module, counts) << " arrow chains\n";
+    return true;
+}
+
+bool writeProfile(const Module &module, const Profiler &profiler, Tracer &tracer,
+                  const RunOptions &options) {
+    if (options.profile) profiler.writeReport(std::cerr);
+    if (!options.edges.empty()) {
+        EdgeCounts counts;
+        collectEdgeCounts(module, profiler, counts);
+        std::ofstream out(options.edges);
+        writeEdgeCounts(module, counts, out);
+        if (!out) {
+            std::cerr << "Cannot write " << options.edges << "\n";
+            return false;
+        }
+    }
+    if (!options.folded.empty()) {
+        std::ofstream out(options.folded);
+        profiler.writeFoldedStacks(out);
+        if (!out) {
+            std::cerr << "Cannot write " << options.folded << "\n";
+            return false;
+        }
+    }
+    if (!options.trace.empty()) {
+        std::ofstream out(options.trace);
+        tracer.writeChromeTrace(module, out);
+        if (!out) {
+            std::cerr << "Cannot write " << options.trace << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// pfru parse <file> [max depth]: syntax only, so no limit applies beyond the
+// nesting depth; 0 lifts that too.
+int parseFile(int argc, char **argv) {
+    std::string text;
+    if (!readFile(argv[2], text)) return 1;
+    TableParser parser(text);
+    if (argc == 4) {
+        uint32_t depth = 0;
+        if (!parseCount(argv[3], depth)) {
+            std::cerr << "Invalid depth '" << argv[3] << "'\n";
+            return 1;
+        }
+        parser.setMaxDepth(depth);
+    }
+    if (!parser.parseProgram()) {
+        std::cerr << argv[2] << ":" << parser.error() << "\n";
+        return 1;
+    }
+    std::cout << parser.tokens().size() << " tokens, nesting depth " << parser.depthReached()
+              << "\n";
+    return 0;
+}
+
+// pfru fuzz <corpus dir> [iterations]: searches, from the corpus, for the
+// sources on which the Lexer enters the most rules per byte and adds the worst
+// ones, minimised, to the corpus.
+int fuzzParserCorpus(int argc, char **argv) {
+    FuzzOptions options;
+    if (argc == 4) {
+        uint32_t iterations = 0;
+        if (!parseCount(argv[3], iterations)) {
+            std::cerr << "Invalid iteration count '" << argv[3] << "'\n";
+            return 1;
+        }
+        options.iterations = iterations;
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(argv[2], ec);
+    std::vector<std::string> paths, seeds;
+    std::string error;
+    if (!readCorpus(argv[2], paths, seeds, error)) {
+        std::cerr << "Cannot load corpus: " << error << "\n";
+        return 1;
+    }
+    std::vector<FuzzCase> found = fuzzParser(seeds, options);
+    std::vector<std::string> saved;
+    for (size_t i = 0; i < found.size() && saved.size() < 4; ++i) {
+        FuzzCase worst = minimiseCase(found[i], options.maxRuleCalls);
+        // Runs of one construct that differ only in length are one finding.
+        if (std::any_of(saved.begin(), saved.end(), [&](const std::string &text) {
+                return text.find(worst.text) != std::string::npos ||
+                       worst.text.find(text) != std::string::npos;
+            })) {
+            continue;
+        }
+        std::string path = saveCorpusCase(argv[2], worst.text);
+        if (path.empty()) {
+            std::cerr << "Cannot write to " << argv[2] << "\n";
+            return 1;
+        }
+        saved.push_back(worst.text);
+        std::cout << path << ": " << worst.text.size() << " bytes, " << worst.ruleCalls
+                  << " rule calls, " << worst.perByte() << " per byte\n";
+    }
+    return 0;
+}
+
+// pfru fuzz-check <corpus dir> <max calls per byte>: fails if the Lexer enters
+// more rules per byte than that on any file of the corpus.
+int checkParserCorpus(char **argv) {
+    uint32_t bound = 0;
+    if (!parseCount(argv[3], bound)) {
+        std::cerr << "Invalid bound '" << argv[3] << "'\n";
+        return 1;
+    }
+    std::vector<std::string> paths, texts;
+    std::string error;
+    if (!readCorpus(argv[2], paths, texts, error)) {
+        std::cerr << "Cannot load corpus: " << error << "\n";
+        return 1;
+    }
+    size_t over = 0;
+    for (size_t i = 0; i < texts.size(); ++i) {
+        // The limit stops a regression from running away with the check.
+        uint64_t limit = (static_cast<uint64_t>(bound) + 1) * std::max<size_t>(texts[i].size(), 1);
+        FuzzCase input{texts[i], measureRuleCalls(texts[i], limit)};
+        bool bad = input.perByte() > bound;
+        over += bad;
+        std::cout << paths[i] << ": " << input.perByte() << " rule calls per byte"
+                  << (bad ? " (over the bound)" : "") << "\n";
+    }
+    std::cout << texts.size() << " inputs, " << over << " over " << bound << " per byte\n";
+    return over ? 1 : 0;
+}
+
+// pfru build <dir> [threads]
+int buildFiles(int argc, char **argv) {
+    unsigned threads = 0;
+    if (argc == 4 && !parseCount(argv[3], threads)) {
+        std::cerr << "Invalid thread count '" << argv[3] << "'\n";
+        return 1;
+    }
+    return buildDirectory(argv[2], threads) ? 0 : 1;
+}
+
+// pfru serve <socket> [threads]
+int serveSocket(int argc, char **argv) {
+    unsigned threads = 0;
+    if (argc == 4 && !parseCount(argv[3], threads)) {
+        std::cerr << "Invalid thread count '" << argv[3] << "'\n";
+        return 1;
+    }
+    return serve(argv[2], threads) ? 0 : 1;
+}
+
+// pfru request <socket> parse|check|run|flow|stats|stop [args...]
+int requestServer(int argc, char **argv) {
+    return sendRequest(argv[2], std::vector<std::string>(argv + 3, argv + argc)) ? 0 : 1;
+}
+
+// pfru check <file>
+int checkFile(const char *path) {
+    Program program;
+    if (!loadProgram(path, program)) return 1;
+    writeArrowReport(program, std::cout);
+    return 0;
+}
+
+// pfru dag <file>: how much of the program's expressions hash-consing shares.
+int dagFile(const char *path) {
+    Program program;
+    if (!loadProgram(path, program)) return 1;
+    ExprDag dag;
+    dag.add(program);
+    size_t treeNodes = 0, treeBytes = 0, shared = 0;
+    measureExpressionTrees(program, treeNodes, treeBytes);
+    for (const auto &node : dag.nodes()) shared += node.uses > 1;
+    std::cout << "Expression trees: " << treeNodes << " nodes, " << treeBytes << " bytes\n"
+              << "Expression DAG: " << dag.nodes().size() << " nodes, " << dag.bytes()
+              << " bytes, " << shared << " shared, " << dag.literals().size()
+              << " distinct literals, " << dag.roots().size() << " roots\n";
+    return 0;
+}
+
+// pfru ssa <file> [repr]: the IR of every repr, or just `repr`, before and
+// after each optimisation pass.
+int ssaFile(int argc, char **argv) {
+    Program program;
+    if (!loadProgram(argv[2], program)) return 1;
+    ConstantFolder(program).run();
+    Module module;
+    Compiler compiler(program);
+    if (!compiler.compile(module)) {
+        std::cerr << "Compile error: " << compiler.error() << "\n";
+        return 1;
+    }
+    int32_t only = -1;
+    if (argc == 4 && (only = module.find(argv[3])) < 0) {
+        std::cerr << "Unknown repr '" << argv[3] << "'\n";
+        return 1;
+    }
+    for (int32_t f = 0; f < static_cast<int32_t>(module.functions.size()); ++f) {
+        if (only >= 0 && f != only) continue;
+        SsaFunction fn;
+        lowerToSsa(module, f, fn);
+        optimiseSsa(module, fn, &std::cout);
+    }
+    return 0;
+}
+
+// pfru batch [options] <file> <arrow block>: one input row per line on stdin,
+// column types taken from the first row.
+int batchFile(int argc, char **argv) {
+    RunOptions options;
+    if (!takeRunOptions(argc, argv, false, options)) return 1;
+    if (argc != 4) {
+        std::cerr << "Usage: pfru batch [options] <file> <arrow block>\n";
+        return 1;
+    }
+    Program program;
+    if (!loadProgram(argv[2], program)) return 1;
+    ConstantFolder(program).run();
+    Module module;
+    Compiler compiler(program);
+    if (!compiler.compile(module)) {
+        std::cerr << "Compile error: " << compiler.error() << "\n";
+        return 1;
+    }
+    if (!fuseChains(module, options)) return 1;
+
+    Batch inputs;
+    StringHeap strings;  // longer stringa inputs
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        std::istringstream fields(line);
+        std::string field;
+        size_t column = 0;
+        while (fields >> field) {
+            Value value;
+            if (!parseValue(field, value)) {
+                std::cerr << "Invalid value '" << field << "' in row " << inputs.rows + 1 << "\n";
+                return 1;
+            }
+            if (inputs.rows == 0) {
+                inputs.types.push_back(value.type);
+                inputs.columns.emplace_back();
+            }
+            if (column >= inputs.columns.size() || inputs.types[column] != value.type) {
+                std::cerr << "Row " << inputs.rows + 1 << " does not match the first row\n";
+                return 1;
+            }
+            inputs.columns[column++].push_back(slotFromValue(value, strings));
+        }
+        if (column == 0) continue;
+        if (column != inputs.columns.size()) {
+            std::cerr << "Row " << inputs.rows + 1 << " does not match the first row\n";
+            return 1;
+        }
+        ++inputs.rows;
+    }
+
+    Interpreter interpreter(module);
+    Profiler profiler(module);
+    Tracer tracer;
+    if (options.profiled()) interpreter.setProfiler(&profiler);
+    if (!options.trace.empty()) interpreter.setTracer(&tracer);
+    if (options.threads) interpreter.setLoopThreads(options.threads);
+    Batch outputs;
+    bool ok = interpreter.runBatch(argv[3], inputs, outputs);
+    if (!writeProfile(module, profiler, tracer, options)) return 1;
+    if (!ok) {
+        std::cerr << "Runtime error: " << interpreter.error() << "\n";
+        return 1;
+    }
+    if (options.memoStats) printMemoReport(module, interpreter);
+    for (size_t row = 0; row < outputs.rows; ++row) {
+        for (size_t c = 0; c < outputs.columns.size(); ++c) {
+            std::cout << (c ? " " : "")
+                      << formatValue(valueFromSlot(outputs.types[c], outputs.columns[c][row]));
+        }
+        std::cout << "\n";
+    }
+    return 0;
+}
+
+// Parses only what running `name` can reach.
+bool loadLazily(const char *path, bool flow, const std::string &name, Program &program) {
+    std::string text;
+    if (!readFile(path, text)) return false;
+    LazyProgram lazy(text);
+    if (!lazy.index()) return loadProgram(path, program);
+    if (!(flow ? lazy.load({}, {name}) : lazy.load({name}, {}))) {
+        std::cerr << path << ":" << lazy.error() << "\n";
+        return false;
+    }
+    program = std::move(lazy.program());
+    return true;
+}
+
+// pfru run [options] <file> <repr> [args...]
+// pfru flow [options] <file> <arrow block> [inputs...]
+int runFile(int argc, char **argv) {
+    bool flow = std::string(argv[1]) == "flow";
+    RunOptions options;
+    if (!takeRunOptions(argc, argv, true, options)) return 1;
+    if (argc < 4) {
+        std::cerr << "Missing " << (flow ? "arrow block" : "repr") << " name\n";
+        return 1;
+    }
+    bool lazy = options.lazy;
+    Program program;
+    if (!(lazy ? loadLazily(argv[2], flow, argv[3], program) : loadProgram(argv[2], program))) {
+        return 1;
+    }
+    ConstantFolder(program).run();
+
+    Module module;
+    Compiler compiler(program);
+    if (!compiler.compile(module)) {
+        std::cerr << "Compile error: " << compiler.error() << "\n";
+        return 1;
+    }
+    if (!fuseChains(module, options)) return 1;
+
+    std::vector<Value> args(argc - 4);
+    for (int i = 4; i < argc; ++i) {
+        if (!parseValue(argv[i], args[i - 4])) {
+            std::cerr << "Invalid argument '" << argv[i] << "'\n";
+            return 1;
+        }
+    }
+    Interpreter interpreter(module);
+    Profiler profiler(module);
+    Tracer tracer;
+    if (options.profiled()) interpreter.setProfiler(&profiler);
+    if (!options.trace.empty()) interpreter.setTracer(&tracer);
+    if (options.threads) interpreter.setLoopThreads(options.threads);
+    std::vector<Value> results;
+    bool ok = flow ? interpreter.run(argv[3], args, results)
+                   : interpreter.call(argv[3], args, results);
+    if (!writeProfile(module, profiler, tracer, options)) return 1;
+    if (!ok) {
+        std::cerr << "Runtime error: " << interpreter.error() << "\n";
+        return 1;
+    }
+    if (options.memoStats) printMemoReport(module, interpreter);
+    for (size_t i = 0; i < results.size(); ++i) {
+        std::cout << (i ? " " : "") << formatValue(results[i]);
+    }
+    std::cout << "\n";
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 4 && (std::string(argv[1]) == "run" || std::string(argv[1]) == "flow")) {
+        return runFile(argc, argv);
+    }
+    if ((argc == 3 || argc == 4) && std::string(argv[1]) == "parse") return parseFile(argc, argv);
+    if (argc == 3 && std::string(argv[1]) == "check") return checkFile(argv[2]);
+    if (argc == 3 && std::string(argv[1]) == "dag") return dagFile(argv[2]);
+    if ((argc == 3 || argc == 4) && std::string(argv[1]) == "ssa") return ssaFile(argc, argv);
+    if ((argc == 3 || argc == 4) && std::string(argv[1]) == "build") return buildFiles(argc, argv);
+    if (argc >= 4 && std::string(argv[1]) == "batch") return batchFile(argc, argv);
+    if ((argc == 3 || argc == 4) && std::string(argv[1]) == "serve") return serveSocket(argc, argv);
+    if (argc >= 4 && std::string(argv[1]) == "request") return requestServer(argc, argv);
+    if ((argc == 3 || argc == 4) && std::string(argv[1]) == "fuzz") {
+        return fuzzParserCorpus(argc, argv);
+    }
+    if (argc == 4 && std::string(argv[1]) == "fuzz-check") return checkParserCorpus(argv);
+
     const std::string sample = R"(repr sum(x:i32, y:i32) -> i32 {
   total: i32 = x + y;
   return total;
@@ -78,6 +578,19 @@ repr loop(n:i32) {
   return i;
 }
 
+repr scale(x:i32) -> i32 {
+  k: i32 = 2 * 3 + 1;
+  if false {
+    return 0;
+  } elif k > 4 {
+    return x * k;
+  }
+  while false {
+    x = x - 1;
+  }
+  return x;
+}
+
 #strelki {
   start -> sum;
   sum -(1, 2, 3)> end;
@@ -86,7 +599,7 @@ repr loop(n:i32) {
 
     Lexer lexer(sample);
     if (!lexer.parseProgram()) {
-        std::cerr << "Lexer failed to parse sample program\n";
+        std::cerr << "Lexer failed to parse sample program: " << lexer.error() << "\n";
         return 1;
     }
 
@@ -97,5 +610,20 @@ repr loop(n:i32) {
                   << " '" << t.lexeme << "'\n";
     }
 
+    Program program;
+    std::string error;
+    if (!buildProgram(tokens, lexer.symbols(), program, error)) {
+        std::cerr << "Failed to build syntax tree: " << error << "\n";
+        return 1;
+    }
+    FoldStats stats = ConstantFolder(program).run();
+    std::cout << "Constant folding: " << stats.eliminated() << " of "
+              << stats.nodesBefore << " nodes eliminated ("
+              << stats.foldedExpressions << " folded, "
+              << stats.propagatedConstants << " propagated, "
+              << stats.removedBranches << " branches, " << stats.removedLoops
+              << " loops, " << stats.removedStatements << " statements removed)\n";
+    writeArrowReport(program, std::cout);
+
     return 0;
 }